@@ -1,2 +1,2 @@
-#define MAX_RESERVATION_SIZE 256
+#define INITIAL_RESERVATION_SIZE 256 // Blocks a RESERVE buffer starts with
 #define STATE_ACCESS_DELAY_MS 10
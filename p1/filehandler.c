@@ -13,12 +13,21 @@
 #include "filehandler.h"
 #include "operations.h"
 #include "parser.h"
+#include "trace.h"
 #include "utils.h"
 
 int BARRIER = FALSE;
 int WAIT = FALSE;
 unsigned int *wait_time;
 
+/*
+  Releases the job file once the thread is done parsing a command out of it.
+*/
+static void release_job_file(struct JobFile *file, long long parse_begin) {
+  trace_end("parse", "file_mutex", parse_begin);
+  mutex_unlock(&file->file_mutex);
+}
+
 int open_file(char *directory_path, struct JobFile *file) {
   file->fd = open(directory_path, O_RDONLY);
   if (file->fd == -1) {
@@ -26,6 +35,11 @@ int open_file(char *directory_path, struct JobFile *file) {
     return 1;
   }
 
+  if (job_reader_open(&file->reader, file->fd) != 0) {
+    close(file->fd);
+    return 1;
+  }
+
   char *dot = strrchr(directory_path, '.');
   size_t length = (size_t)(dot - directory_path);
 
@@ -37,6 +51,7 @@ int open_file(char *directory_path, struct JobFile *file) {
       open(output_file_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
   if (file->fd_out == -1) {
     perror("Error opening output file");
+    job_reader_close(&file->reader);
     close(file->fd);
     return 1;
   }
@@ -91,6 +106,7 @@ int process_job_file(char *directory_path, int max_threads) {
   int exit = FALSE;
   while (TRUE) {
     void *result = malloc(sizeof(int));
+    long long join_begin = trace_begin();
     for (int i = 0; i < max_threads; i++) {
       if (pthread_join(file->threads[i], &result) != 0) {
         perror("Error joining thread");
@@ -101,6 +117,7 @@ int process_job_file(char *directory_path, int max_threads) {
       }
     }
     free(result);
+    trace_end("join threads", "barrier", join_begin);
 
     if (exit) {
       break;
@@ -108,13 +125,16 @@ int process_job_file(char *directory_path, int max_threads) {
 
     // continues because the file hasnt ended, and left because of a barrier
     BARRIER = FALSE;
+    long long create_begin = trace_begin();
     create_threads(max_threads, file);
+    trace_end("create threads", "barrier", create_begin);
   }
 
   if (close(file->fd_out) != 0) {
     perror("Could not close the output file");
   }
 
+  job_reader_close(&file->reader);
   if (close(file->fd) != 0) {
     perror("Could not close the input file");
   }
@@ -129,85 +149,103 @@ int process_job_file(char *directory_path, int max_threads) {
 void *execute_file_commands(void *file) {
   struct JobFile *thread_args = (struct JobFile *)file;
 
+  long long lock_begin = trace_begin();
   mutex_lock(&thread_args->file_mutex);
   unsigned int thread_id = thread_args->thread_id;
-  int command = get_next(thread_args->fd);
+  trace_set_thread(thread_id);
+  trace_end("wait file_mutex", "lock", lock_begin);
+  long long parse_begin = trace_begin();
+  int command = job_next(&thread_args->reader);
   int threads_that_need_wait;
   int *thread_result = malloc(sizeof(int));
 
+  // Seats of the RESERVE commands, grown to fit the largest one
+  struct SeatRange *ranges = NULL;
+  size_t ranges_capacity = 0;
+
   while (command != EOC) {
     unsigned int event_id, delay, thread_id_wait;
     size_t num_rows, num_columns, num_coords;
-    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    long long command_begin;
     int result;
 
     switch (command) {
     case CMD_CREATE:
-      result =
-          parse_create(thread_args->fd, &event_id, &num_rows, &num_columns);
-      mutex_unlock(&thread_args->file_mutex);
+      result = job_parse_create(&thread_args->reader, &event_id, &num_rows,
+                                &num_columns);
+      release_job_file(thread_args, parse_begin);
 
       if (result != 0) {
         fprintf(stderr, "Invalid create command. See HELP for usage\n");
-        continue;
+        break;
       }
 
+      command_begin = trace_begin();
       if (ems_create(event_id, num_rows, num_columns)) {
         fprintf(stderr, "Failed to create event\n");
       }
+      trace_end("CREATE", "command", command_begin);
 
       break;
 
     case CMD_RESERVE:
-      num_coords = parse_reserve(thread_args->fd, MAX_RESERVATION_SIZE,
-                                 &event_id, xs, ys);
-      mutex_unlock(&thread_args->file_mutex);
+      num_coords = job_parse_reserve(&thread_args->reader, &event_id,
+                                     &ranges, &ranges_capacity);
+      release_job_file(thread_args, parse_begin);
 
       if (num_coords == 0) {
         fprintf(stderr, "Invalid reserve command. See HELP for usage\n");
-        continue;
+        break;
       }
 
-      if (ems_reserve(event_id, num_coords, xs, ys)) {
+      command_begin = trace_begin();
+      if (ems_reserve(event_id, num_coords, ranges)) {
         fprintf(stderr, "Failed to reserve seats\n");
       }
+      trace_end("RESERVE", "command", command_begin);
 
       // mutex_unlock(&thread_args->file->file_mutex);
       break;
 
     case CMD_SHOW:
-      result = parse_show(thread_args->fd, &event_id);
-      mutex_unlock(&thread_args->file_mutex);
+      result = job_parse_show(&thread_args->reader, &event_id);
+      release_job_file(thread_args, parse_begin);
       if (result != 0) {
         fprintf(stderr, "Invalid show command. See HELP for usage\n");
-        continue;
+        break;
       }
+      command_begin = trace_begin();
       if (ems_show(event_id, thread_args->fd_out)) {
         fprintf(stderr, "Failed to show event\n");
       }
+      trace_end("SHOW", "command", command_begin);
 
       break;
 
     case CMD_LIST_EVENTS:
-      mutex_unlock(&thread_args->file_mutex);
+      release_job_file(thread_args, parse_begin);
+      command_begin = trace_begin();
       if (ems_list_events(thread_args->fd_out)) {
         fprintf(stderr, "Failed to list events\n");
       }
+      trace_end("LIST", "command", command_begin);
       break;
 
     case CMD_WAIT:
-      result = parse_wait(thread_args->fd, &delay, &thread_id_wait);
-      mutex_unlock(&thread_args->file_mutex);
+      result = job_parse_wait(&thread_args->reader, &delay, &thread_id_wait);
+      release_job_file(thread_args, parse_begin);
 
       if (result == -1) {
         fprintf(stderr, "Invalid wait command. See HELP for usage\n");
-        continue;
+        break;
       }
       if (delay == 0) {
-        continue;
+        break;
       }
 
+      lock_begin = trace_begin();
       mutex_lock(&thread_args->file_mutex);
+      trace_end("wait file_mutex", "lock", lock_begin);
       WAIT = TRUE;
       if (thread_id_wait == 0) {
         for (int i = 0; i < thread_args->max_threads; i++) {
@@ -223,15 +261,15 @@ void *execute_file_commands(void *file) {
       break;
 
     case CMD_INVALID:
-      mutex_unlock(&thread_args->file_mutex);
+      release_job_file(thread_args, parse_begin);
       fprintf(stderr, "Invalid command. See HELP for usage\n");
       break;
 
     case CMD_HELP:
-      mutex_unlock(&thread_args->file_mutex);
+      release_job_file(thread_args, parse_begin);
       printf("Available commands:\n"
              "  CREATE <event_id> <num_rows> <num_columns>\n"
-             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>)-(<x3>,<y3>) ...]\n"
              "  SHOW <event_id>\n"
              "  LIST\n"
              "  WAIT <delay_ms> [thread_id]\n" // thread_id is not implemented
@@ -241,32 +279,39 @@ void *execute_file_commands(void *file) {
 
     case CMD_BARRIER:
       BARRIER = TRUE; // Set termination cause to BARRIER
-      mutex_unlock(&thread_args->file_mutex);
+      release_job_file(thread_args, parse_begin);
       *thread_result = 0;
+      free(ranges);
       pthread_exit(thread_result);
 
     case CMD_EMPTY:
-      mutex_unlock(&thread_args->file_mutex);
+      release_job_file(thread_args, parse_begin);
       break;
 
     case EOC:
-      mutex_unlock(&thread_args->file_mutex);
+      release_job_file(thread_args, parse_begin);
 
       *thread_result = 0;
       if (command == EOC) {
         *thread_result = 1;
       }
+      free(ranges);
       pthread_exit(thread_result);
     }
 
     // lock before getting next command
+    lock_begin = trace_begin();
     mutex_lock(&thread_args->file_mutex);
+    trace_end("wait file_mutex", "lock", lock_begin);
+    parse_begin = trace_begin();
 
     // check if there needs to be wait for the thread
     if (WAIT == TRUE) {
       if ((wait_time[thread_id - 1] > 0)) {
         printf("Waiting...\n");
+        long long wait_begin = trace_begin();
         ems_wait(wait_time[thread_id - 1]);
+        trace_end("WAIT", "command", wait_begin);
         wait_time[thread_id - 1] = 0;
         threads_that_need_wait -= 1;
       }
@@ -279,14 +324,15 @@ void *execute_file_commands(void *file) {
       break;
     }
 
-    command = get_next(thread_args->fd);
+    command = job_next(&thread_args->reader);
   }
 
-  mutex_unlock(&thread_args->file_mutex);
+  release_job_file(thread_args, parse_begin);
 
   *thread_result = 0;
   if (command == EOC) {
     *thread_result = 1;
   }
+  free(ranges);
   pthread_exit(thread_result);
 }
\ No newline at end of file
@@ -1,11 +1,14 @@
 #ifndef FILE_HANDLER_H
 #define FILE_HANDLER_H
 
+#include "jobfile.h"
+
 #define TRUE 1
 #define FALSE 0
 
 struct JobFile {
   int fd;
+  struct JobReader reader; // Commands of fd, either compiled or text
   int fd_out;
   int max_threads;
   pthread_t *threads;
@@ -20,7 +23,7 @@ struct JobFile {
 int retrieve_job_files(char *directory_path, char *files[], int *num_of_files);
 
 /*
-  Opens .jobs and .out files from the directory path given.
+  Opens .jobs or compiled .jobc and .out files from the directory path given.
   @return Returns 0 if successful, 1 otherwhise.
 */
 int open_file(char *directory_path, struct JobFile *file);
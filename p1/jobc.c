@@ -0,0 +1,52 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jobfile.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr,
+            "Usage: %s <.jobs file path> <(optional) .jobc file path>\n",
+            argv[0]);
+    return 1;
+  }
+
+  // The compiled job goes next to the text one unless told otherwise
+  char *dot = strrchr(argv[1], '.');
+  if (argc == 2 && (dot == NULL || strcmp(dot, ".jobs") != 0)) {
+    fprintf(stderr, "Invalid .jobs file path: %s\n", argv[1]);
+    return 1;
+  }
+  size_t length = strlen(argv[1]);
+  char output_file_path[length + 1];
+  if (argc == 2) {
+    strcpy(output_file_path, argv[1]);
+    strcpy(output_file_path + length - 1, "c");
+  }
+  const char *out_path = argc > 2 ? argv[2] : output_file_path;
+
+  int fd = open(argv[1], O_RDONLY);
+  if (fd == -1) {
+    perror("Error opening input file");
+    return 1;
+  }
+
+  int fd_out = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd_out == -1) {
+    perror("Error opening output file");
+    close(fd);
+    return 1;
+  }
+
+  int failed = compile_job(fd, fd_out);
+  if (failed) {
+    fprintf(stderr, "Failed to compile job: %s\n", argv[1]);
+    unlink(out_path);
+  }
+  close(fd);
+  close(fd_out);
+  return failed;
+}
@@ -12,15 +12,29 @@
 #include "filehandler.h"
 #include "operations.h"
 #include "parser.h"
+#include "trace.h"
 
 int main(int argc, char *argv[]) {
   unsigned int state_access_delay_ms = STATE_ACCESS_DELAY_MS;
 
-  if (argc < 4) { // check if the input has at least 3 fields.
+  // Each job process writes its timeline to <trace path prefix>-<pid>.json
+  int option, invalid = 0;
+  while ((option = getopt(argc, argv, "t:")) != -1) {
+    if (option == 't') {
+      trace_enable(optarg);
+    } else {
+      invalid = 1;
+    }
+  }
+  char *program = argv[0];
+  argc -= optind - 1; // The fields are counted as if there were no options
+  argv += optind - 1;
+
+  if (invalid || argc < 4) { // check if the input has at least 3 fields.
     fprintf(stderr,
-            "Usage: %s <directory_path> <max processes> <max threads> "
-            "<(optional) delay>\n",
-            argv[0]);
+            "Usage: %s [-t trace path prefix] <directory_path> <max processes> "
+            "<max threads> <(optional) delay>\n",
+            program);
     return 1;
   }
 
@@ -56,7 +70,8 @@ int main(int argc, char *argv[]) {
   int active_processes = 0;
   while ((dir_entry = readdir(dir)) != NULL) {
     char *filename;
-    if (strstr(dir_entry->d_name, ".jobs") != NULL) {
+    if (strstr(dir_entry->d_name, ".jobs") != NULL ||
+        strstr(dir_entry->d_name, ".jobc") != NULL) {
       size_t filename_size =
           sizeof(directory_path) + sizeof(dir_entry->d_name) + 2;
       filename = malloc(filename_size);
@@ -66,6 +81,19 @@ int main(int argc, char *argv[]) {
       continue;
     }
 
+    // A .jobs compiled next to itself is run from its .jobc, both would write
+    // the same .out
+    char *extension = strrchr(filename, '.');
+    if (strcmp(extension, ".jobs") == 0) {
+      extension[4] = 'c';
+      int compiled = access(filename, F_OK) == 0;
+      extension[4] = 's';
+      if (compiled) {
+        free(filename);
+        continue;
+      }
+    }
+
     active_processes++;
     pid_t pid = fork();
     if (pid < 0) {
@@ -76,7 +104,9 @@ int main(int argc, char *argv[]) {
       exit(1);
     }
     if (pid == 0) {
-      exit(process_job_file(filename, max_threads) != 0);
+      int failed = process_job_file(filename, max_threads) != 0;
+      failed |= trace_write();
+      exit(failed);
       exit(0);
     }
 
@@ -9,6 +9,8 @@
 
 #include "constants.h"
 #include "eventlist.h"
+#include "operations.h"
+#include "trace.h"
 #include "utils.h"
 
 static struct EventList *event_list = NULL;
@@ -29,7 +31,9 @@ static struct timespec delay_to_timespec(unsigned int delay_ms) {
 /// @return Pointer to the event if found, NULL otherwise.
 static struct Event *get_event_with_delay(unsigned int event_id) {
   struct timespec delay = delay_to_timespec(state_access_delay_ms);
+  long long delay_begin = trace_begin();
   nanosleep(&delay, NULL); // Should not be removed
+  trace_end("state access delay", "delay", delay_begin);
 
   return get_event(event_list, event_id);
 }
@@ -42,11 +46,25 @@ static struct Event *get_event_with_delay(unsigned int event_id) {
 /// @return Pointer to the seat.
 static unsigned int *get_seat_with_delay(struct Event *event, size_t index) {
   struct timespec delay = delay_to_timespec(state_access_delay_ms);
+  long long delay_begin = trace_begin();
   nanosleep(&delay, NULL); // Should not be removed
+  trace_end("state access delay", "delay", delay_begin);
 
   return &event->data[index];
 }
 
+/// Writes part of an output, traced as a span of its own.
+/// @param fd File descriptor to write to.
+/// @param buf What to write.
+/// @param len Length to write.
+/// @return Bytes written, -1 on failure.
+static ssize_t write_output(int fd, const void *buf, size_t len) {
+  long long write_begin = trace_begin();
+  ssize_t result = write(fd, buf, len);
+  trace_end("write", "output", write_begin);
+  return result;
+}
+
 /// Gets the index of a seat.
 /// @note This function assumes that the seat exists.
 /// @param event Event to get the seat index from.
@@ -87,7 +105,9 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     return 1;
   }
 
+  long long lock_begin = trace_begin();
   rwlock_wrlock(&event_list->lock_list);
+  trace_end("wait event list lock", "lock", lock_begin);
 
   if (get_event_with_delay(event_id) != NULL) {
     fprintf(stderr, "Event already exists\n");
@@ -137,14 +157,16 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   return 0;
 }
 
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs,
-                size_t *ys) {
+int ems_reserve(unsigned int event_id, size_t num_ranges,
+                struct SeatRange *ranges) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
+  long long lock_begin = trace_begin();
   rwlock_wrlock(&event_list->lock_list);
+  trace_end("wait event list lock", "lock", lock_begin);
 
   struct Event *event = get_event_with_delay(event_id);
   if (event == NULL) {
@@ -153,7 +175,59 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs,
     return 1;
   }
 
+  lock_begin = trace_begin();
   rwlock_wrlock(&event->lock); // already have event
+  trace_end("wait event lock", "lock", lock_begin);
+
+  // Blocks are checked against the event before expanding them, so none can be
+  // larger than the venue. A seat can't be reserved twice, so neither can all
+  // of them together.
+  size_t num_seats = 0;
+  for (size_t i = 0; i < num_ranges; i++) {
+    struct SeatRange *range = &ranges[i];
+    if (range->first_row <= 0 || range->first_row > range->last_row ||
+        range->last_row > event->rows || range->first_col <= 0 ||
+        range->first_col > range->last_col || range->last_col > event->cols) {
+      fprintf(stderr, "Invalid seat\n");
+      rwlock_unlock(&event->lock);
+      rwlock_unlock(&event_list->lock_list);
+      return 1;
+    }
+    size_t range_seats = (range->last_row - range->first_row + 1) *
+                         (range->last_col - range->first_col + 1);
+    if (range_seats > event->rows * event->cols - num_seats) {
+      fprintf(stderr, "More seats than the event has\n");
+      rwlock_unlock(&event->lock);
+      rwlock_unlock(&event_list->lock_list);
+      return 1;
+    }
+    num_seats += range_seats;
+  }
+
+  size_t *xs = malloc(sizeof(size_t) * num_seats);
+  size_t *ys = malloc(sizeof(size_t) * num_seats);
+  if (num_seats > 0 && (xs == NULL || ys == NULL)) {
+    fprintf(stderr, "Failed to allocate memory for the seats\n");
+    free(xs);
+    free(ys);
+    rwlock_unlock(&event->lock);
+    rwlock_unlock(&event_list->lock_list);
+    return 1;
+  }
+
+  // Blocks are expanded in row-major order
+  size_t seat = 0;
+  for (size_t i = 0; i < num_ranges; i++) {
+    for (size_t row = ranges[i].first_row; row <= ranges[i].last_row; row++) {
+      for (size_t col = ranges[i].first_col; col <= ranges[i].last_col;
+           col++) {
+        xs[seat] = row;
+        ys[seat] = col;
+        seat++;
+      }
+    }
+  }
+
   unsigned int reservation_id = ++event->reservations;
 
   size_t i = 0;
@@ -181,11 +255,15 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs,
       *get_seat_with_delay(event, seat_index(event, xs[j], ys[j])) = 0;
     }
 
+    free(xs);
+    free(ys);
     rwlock_unlock(&event->lock);
     rwlock_unlock(&event_list->lock_list);
     return 1;
   }
 
+  free(xs);
+  free(ys);
   rwlock_unlock(&event->lock);
   rwlock_unlock(&event_list->lock_list);
   return 0;
@@ -197,7 +275,9 @@ int ems_show(unsigned int event_id, int fd) {
     return 1;
   }
 
+  long long lock_begin = trace_begin();
   rwlock_rdlock(&event_list->lock_list);
+  trace_end("wait event list lock", "lock", lock_begin);
 
   struct Event *event = get_event_with_delay(event_id);
 
@@ -207,17 +287,21 @@ int ems_show(unsigned int event_id, int fd) {
     return 1;
   }
 
+  lock_begin = trace_begin();
   rwlock_rdlock(&event->lock); // already have the event, list can be altered
+  trace_end("wait event lock", "lock", lock_begin);
 
   // Write in the file
+  lock_begin = trace_begin();
   mutex_lock(&out_file_mutex);
+  trace_end("wait out_file_mutex", "lock", lock_begin);
   for (size_t i = 1; i <= event->rows; i++) {
     for (size_t j = 1; j <= event->cols; j++) {
       unsigned int *seat = get_seat_with_delay(event, seat_index(event, i, j));
       char seat_str[12];
       int len = snprintf(seat_str, sizeof(seat_str), "%u", *seat);
 
-      if (write(fd, seat_str, (size_t)len) != len) {
+      if (write_output(fd, seat_str, (size_t)len) != len) {
         fprintf(stderr, "Error writing to the file\n");
         rwlock_unlock(&event->lock);
         rwlock_unlock(&event_list->lock_list);
@@ -226,7 +310,7 @@ int ems_show(unsigned int event_id, int fd) {
       }
 
       if (j < event->cols) {
-        if (write(fd, " ", sizeof(char)) != 1) {
+        if (write_output(fd, " ", sizeof(char)) != 1) {
           fprintf(stderr, "Error writing to the file\n");
           rwlock_unlock(&event->lock);
           rwlock_unlock(&event_list->lock_list);
@@ -236,7 +320,7 @@ int ems_show(unsigned int event_id, int fd) {
       }
     }
 
-    if (write(fd, "\n", sizeof(char)) != 1) {
+    if (write_output(fd, "\n", sizeof(char)) != 1) {
       fprintf(stderr, "Error writing to the file\n");
       rwlock_unlock(&event->lock);
       rwlock_unlock(&event_list->lock_list);
@@ -257,11 +341,15 @@ int ems_list_events(int fd) {
     return 1;
   }
 
+  long long lock_begin = trace_begin();
   rwlock_rdlock(&event_list->lock_list);
+  trace_end("wait event list lock", "lock", lock_begin);
+  lock_begin = trace_begin();
   mutex_lock(&out_file_mutex);
+  trace_end("wait out_file_mutex", "lock", lock_begin);
   if (event_list->head == NULL) {
     const char *no_events_message = "No events\n";
-    if (write(fd, no_events_message, 10) != 10) {
+    if (write_output(fd, no_events_message, 10) != 10) {
       fprintf(stderr, "Error writing to the file\n");
       rwlock_unlock(&event_list->lock_list);
       mutex_unlock(&out_file_mutex);
@@ -275,7 +363,7 @@ int ems_list_events(int fd) {
   struct ListNode *current = event_list->head;
   while (current != NULL) {
     const char *event_message = "Event: ";
-    ssize_t result = write(fd, event_message, strlen(event_message));
+    ssize_t result = write_output(fd, event_message, strlen(event_message));
     if (result < 0 || (size_t)result != strlen(event_message)) {
       fprintf(stderr, "Error writing to the file\n");
       rwlock_unlock(&event_list->lock_list);
@@ -286,7 +374,7 @@ int ems_list_events(int fd) {
     unsigned int event_id = current->event->id;
     char event_id_str[12];
     int len = snprintf(event_id_str, sizeof(event_id_str), "%u", event_id);
-    result = write(fd, event_id_str, (size_t)len);
+    result = write_output(fd, event_id_str, (size_t)len);
 
     if (result < 0 || (size_t)result != (size_t)len) {
       fprintf(stderr, "Error writing to the file\n");
@@ -295,7 +383,7 @@ int ems_list_events(int fd) {
       return 1;
     }
 
-    if (write(fd, "\n", sizeof(char)) != 1) {
+    if (write_output(fd, "\n", sizeof(char)) != 1) {
       fprintf(stderr, "Error writing to the file\n");
       rwlock_unlock(&event_list->lock_list);
       mutex_unlock(&out_file_mutex);
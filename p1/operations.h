@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "parser.h"
+
 /// Initializes the EMS state.
 /// @param delay_ms State access delay in milliseconds.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
@@ -20,12 +22,12 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 
 /// Creates a new reservation for the given event.
 /// @param event_id Id of the event to create a reservation for.
-/// @param num_seats Number of seats to reserve.
-/// @param xs Array of rows of the seats to reserve.
-/// @param ys Array of columns of the seats to reserve.
+/// @param num_ranges Number of blocks of seats to reserve.
+/// @param ranges Blocks of seats to reserve, expanded into seats once checked
+/// against the event.
 /// @return 0 if the reservation was created successfully, 1 otherwise.
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs,
-                size_t *ys);
+int ems_reserve(unsigned int event_id, size_t num_ranges,
+                struct SeatRange *ranges);
 
 /// Prints the given event.
 /// @param event_id Id of the event to print.
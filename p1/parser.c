@@ -161,8 +161,30 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows,
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs,
-                     size_t *ys) {
+/// Parses the coordinates of a seat, past its opening parenthesis.
+/// @param fd File descriptor to read from.
+/// @param x Pointer to the variable to store the row in.
+/// @param y Pointer to the variable to store the column in.
+/// @return 0 if the coordinates were parsed successfully, 1 otherwise.
+static int read_coords(int fd, size_t *x, size_t *y) {
+  char ch;
+  unsigned int value;
+
+  if (read_uint(fd, &value, &ch) != 0 || ch != ',') {
+    return 1;
+  }
+  *x = (size_t)value;
+
+  if (read_uint(fd, &value, &ch) != 0 || ch != ')') {
+    return 1;
+  }
+  *y = (size_t)value;
+
+  return 0;
+}
+
+size_t parse_reserve(int fd, unsigned int *event_id, struct SeatRange **ranges,
+                     size_t *capacity) {
   char ch;
 
   if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
@@ -176,29 +198,48 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs,
   }
 
   size_t num_coords = 0;
-  while (num_coords < max) {
+  while (1) {
     if (read(fd, &ch, 1) != 1 || ch != '(') {
       cleanup(fd);
       return 0;
     }
 
-    unsigned int x;
-    if (read_uint(fd, &x, &ch) != 0 || ch != ',') {
-      cleanup(fd);
-      return 0;
+    if (num_coords == *capacity) {
+      size_t new_capacity =
+          *capacity > 0 ? 2 * *capacity : INITIAL_RESERVATION_SIZE;
+      struct SeatRange *new_ranges =
+          realloc(*ranges, sizeof(struct SeatRange) * new_capacity);
+      if (new_ranges == NULL) {
+        cleanup(fd);
+        return 0;
+      }
+      *ranges = new_ranges;
+      *capacity = new_capacity;
     }
-    xs[num_coords] = (size_t)x;
 
-    unsigned int y;
-    if (read_uint(fd, &y, &ch) != 0 || ch != ')') {
+    struct SeatRange *range = &(*ranges)[num_coords];
+    if (read_coords(fd, &range->first_row, &range->first_col) ||
+        read(fd, &ch, 1) != 1) {
       cleanup(fd);
       return 0;
     }
-    ys[num_coords] = (size_t)y;
+
+    // A block ends at a second seat, a single seat ends where it starts
+    if (ch == '-') {
+      if (read(fd, &ch, 1) != 1 || ch != '(' ||
+          read_coords(fd, &range->last_row, &range->last_col) ||
+          read(fd, &ch, 1) != 1) {
+        cleanup(fd);
+        return 0;
+      }
+    } else {
+      range->last_row = range->first_row;
+      range->last_col = range->first_col;
+    }
 
     num_coords++;
 
-    if (read(fd, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
+    if (ch != ' ' && ch != ']') {
       cleanup(fd);
       return 0;
     }
@@ -208,11 +249,6 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs,
     }
   }
 
-  if (num_coords == max) {
-    cleanup(fd);
-    return 0;
-  }
-
   if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
     cleanup(fd);
     return 0;
@@ -0,0 +1,161 @@
+#include "trace.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define TRACE_BUFFER_INITIAL_SIZE 1024 // Spans a thread buffer starts with
+
+struct TraceSpan {
+  const char *name;
+  const char *category;
+  long long begin_ns;
+  long long end_ns;
+};
+
+// Spans of a thread, kept after it's gone until the trace is written
+struct TraceBuffer {
+  unsigned int thread_id;
+  struct TraceSpan *spans;
+  size_t len;
+  size_t capacity;
+  struct TraceBuffer *next;
+};
+
+static const char *trace_path_prefix = NULL;
+static struct TraceBuffer *buffers = NULL;
+static pthread_mutex_t buffers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct TraceBuffer *local_buffer = NULL;
+static _Thread_local unsigned int local_thread_id = 0;
+
+/// Gets the buffer of the calling thread, registering it on its first span.
+/// @return Buffer of the thread, or NULL if it couldn't be allocated.
+static struct TraceBuffer *thread_buffer(void) {
+  if (local_buffer != NULL) {
+    return local_buffer;
+  }
+
+  struct TraceBuffer *buffer = malloc(sizeof(struct TraceBuffer));
+  if (buffer == NULL) {
+    return NULL;
+  }
+  buffer->thread_id = local_thread_id;
+  buffer->spans = NULL;
+  buffer->len = 0;
+  buffer->capacity = 0;
+
+  mutex_lock(&buffers_mutex);
+  buffer->next = buffers;
+  buffers = buffer;
+  mutex_unlock(&buffers_mutex);
+
+  local_buffer = buffer;
+  return buffer;
+}
+
+void trace_enable(const char *path_prefix) { trace_path_prefix = path_prefix; }
+
+void trace_set_thread(unsigned int thread_id) { local_thread_id = thread_id; }
+
+long long trace_begin(void) {
+  return trace_path_prefix != NULL ? clock_now_ns() : 0;
+}
+
+void trace_end(const char *name, const char *category, long long begin_ns) {
+  if (begin_ns == 0) {
+    return;
+  }
+
+  long long end_ns = clock_now_ns();
+  struct TraceBuffer *buffer = thread_buffer();
+  if (buffer == NULL) {
+    return;
+  }
+
+  if (buffer->len == buffer->capacity) {
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2
+                                           : TRACE_BUFFER_INITIAL_SIZE;
+    struct TraceSpan *spans =
+        realloc(buffer->spans, sizeof(struct TraceSpan) * capacity);
+    if (spans == NULL) {
+      return; // The span is dropped, the job goes on
+    }
+    buffer->spans = spans;
+    buffer->capacity = capacity;
+  }
+  buffer->spans[buffer->len++] =
+      (struct TraceSpan){name, category, begin_ns, end_ns};
+}
+
+int trace_write(void) {
+  if (trace_path_prefix == NULL) {
+    return 0;
+  }
+
+  int pid = (int)getpid();
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s-%d.json", trace_path_prefix, pid) >=
+      (int)sizeof(path)) {
+    fprintf(stderr, "Trace path is too long\n");
+    return 1;
+  }
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    perror("Error opening trace file");
+    return 1;
+  }
+
+  // Each job thread gets a row of its own, named once whatever buffers it had
+  mutex_lock(&buffers_mutex);
+  int failed = fprintf(out, "{\"traceEvents\":[\n") < 0;
+  int first = 1;
+  for (struct TraceBuffer *buffer = buffers; buffer != NULL && !failed;
+       buffer = buffer->next) {
+    int named_later = 0;
+    for (struct TraceBuffer *other = buffer->next; other != NULL;
+         other = other->next) {
+      named_later |= other->thread_id == buffer->thread_id;
+    }
+    if (!named_later) {
+      failed = fprintf(out,
+                       "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                       "\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                       first ? "" : ",\n", pid, buffer->thread_id,
+                       buffer->thread_id == 0 ? "main" : "thread",
+                       buffer->thread_id) < 0;
+      first = 0;
+    }
+
+    for (size_t i = 0; i < buffer->len && !failed; i++) {
+      struct TraceSpan *span = &buffer->spans[i];
+      failed = fprintf(out,
+                       "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                       "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                       first ? "" : ",\n", span->name, span->category,
+                       (double)span->begin_ns / 1e3,
+                       (double)(span->end_ns - span->begin_ns) / 1e3, pid,
+                       buffer->thread_id) < 0;
+      first = 0;
+    }
+  }
+  failed = failed || fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n") < 0;
+
+  while (buffers != NULL) {
+    struct TraceBuffer *next = buffers->next;
+    free(buffers->spans);
+    free(buffers);
+    buffers = next;
+  }
+  local_buffer = NULL;
+  mutex_unlock(&buffers_mutex);
+
+  if (fclose(out) != 0 || failed) {
+    fprintf(stderr, "Error writing trace file\n");
+    return 1;
+  }
+  return 0;
+}
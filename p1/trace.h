@@ -0,0 +1,37 @@
+#ifndef EMS_TRACE_H
+#define EMS_TRACE_H
+
+// Timeline of a job run, written as a Chrome trace-event JSON file per process
+// to be opened in a trace viewer (chrome://tracing, ui.perfetto.dev). Every
+// thread records its spans in a buffer of its own, so tracing takes no lock
+// but the one taken by a thread on its first span. Spans are only recorded
+// once tracing is enabled, the rest of the time each costs a single check.
+
+/// Enables tracing for this process and the job processes forked after it.
+/// @param path_prefix Path the trace of each process is written to, followed
+/// by -<pid>.json.
+void trace_enable(const char *path_prefix);
+
+/// Names the spans of the calling thread after the job thread it runs, before
+/// its first span.
+/// @param thread_id Id of the job thread, 0 for the main thread.
+void trace_set_thread(unsigned int thread_id);
+
+/// Starts a span.
+/// @return Time the span starts at, to be given to trace_end, or 0 when not
+/// tracing.
+long long trace_begin(void);
+
+/// Records a span from its start until now, in the buffer of the calling
+/// thread.
+/// @param name Name of the span, a string literal.
+/// @param category Category of the span, a string literal.
+/// @param begin_ns Time returned by trace_begin.
+void trace_end(const char *name, const char *category, long long begin_ns);
+
+/// Writes the spans of every thread of this process to its trace file. Must
+/// be called once the other threads are done.
+/// @return 0 if successful or not tracing, 1 otherwise.
+int trace_write(void);
+
+#endif // EMS_TRACE_H
@@ -3,7 +3,163 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
+#ifdef LOCK_PROFILE
+#include <string.h>
+#include <unistd.h>
+
+// The plain functions stay for callers that can't name their site, without
+// being counted
+#undef rwlock_rdlock
+#undef rwlock_wrlock
+#undef mutex_lock
+
+#define LOCK_PROFILE_MAX_HELD 16 // Locks held at once whose hold is measured
+
+// Lock held by the calling thread
+struct HeldLock {
+  const void *lock;
+  struct LockSite *site;
+  long long since_ns;
+};
+
+// Every site that took a lock, pushed on their first acquisition
+static struct LockSite *sites = NULL;
+static pthread_once_t report_once = PTHREAD_ONCE_INIT;
+static _Thread_local struct HeldLock held_locks[LOCK_PROFILE_MAX_HELD];
+static _Thread_local int num_held_locks = 0;
+
+/*
+ * Raises a maximum shared between threads.
+ * @param max  Maximum to raise.
+ * @param value  Value to raise it to, if higher.
+ */
+static void update_max(unsigned long long *max, unsigned long long value) {
+  unsigned long long current = __atomic_load_n(max, __ATOMIC_RELAXED);
+  while (value > current &&
+         !__atomic_compare_exchange_n(max, &current, value, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/*
+ * Orders sites by how long they were waited for, then by how many times.
+ */
+static int compare_sites(const void *a, const void *b) {
+  const struct LockSite *x = *(struct LockSite *const *)a;
+  const struct LockSite *y = *(struct LockSite *const *)b;
+  if (x->wait_ns != y->wait_ns) {
+    return x->wait_ns < y->wait_ns ? 1 : -1;
+  }
+  if (x->contended != y->contended) {
+    return x->contended < y->contended ? 1 : -1;
+  }
+  return strcmp(x->name, y->name);
+}
+
+/*
+ * Prints every site to stderr, the ones waited for the longest first.
+ */
+static void report_contention(void) {
+  size_t num_sites = 0;
+  struct LockSite *first = __atomic_load_n(&sites, __ATOMIC_ACQUIRE);
+  for (struct LockSite *site = first; site != NULL; site = site->next) {
+    num_sites++;
+  }
+  struct LockSite **sorted =
+      malloc(sizeof(struct LockSite *) * (num_sites > 0 ? num_sites : 1));
+  if (sorted == NULL) {
+    fprintf(stderr, "Failed to report lock contention\n");
+    return;
+  }
+  size_t i = 0;
+  for (struct LockSite *site = first; site != NULL; site = site->next) {
+    sorted[i++] = site;
+  }
+  qsort(sorted, num_sites, sizeof(struct LockSite *), compare_sites);
+
+  fprintf(stderr, "Lock contention of process %d, longest waits first:\n",
+          (int)getpid());
+  fprintf(stderr, "site,acquisitions,contended,wait_total_us,wait_max_us,"
+                  "hold_total_us,hold_max_us\n");
+  for (i = 0; i < num_sites; i++) {
+    struct LockSite *site = sorted[i];
+    fprintf(stderr, "%s,%llu,%llu,%.1f,%.1f,%.1f,%.1f\n", site->name,
+            site->acquisitions, site->contended, (double)site->wait_ns / 1e3,
+            (double)site->max_wait_ns / 1e3, (double)site->hold_ns / 1e3,
+            (double)site->max_hold_ns / 1e3);
+  }
+  free(sorted);
+}
+
+/*
+ * Sets up the report of the sites for when the process exits.
+ */
+static void register_report(void) {
+  if (atexit(report_contention) != 0) {
+    fprintf(stderr, "Failed to set up the lock contention report\n");
+  }
+}
+
+/*
+ * Counts an acquisition for a site, registering it on its first one, and
+ * starts measuring how long it's held.
+ * @param lock  Lock taken.
+ * @param site  Where the lock was taken.
+ * @param contended  Whether the lock had to be waited for.
+ * @param wait_ns  How long the lock was waited for.
+ */
+static void lock_acquired(const void *lock, struct LockSite *site,
+                          int contended, long long wait_ns) {
+  if (!__atomic_exchange_n(&site->registered, 1, __ATOMIC_RELAXED)) {
+    pthread_once(&report_once, register_report);
+    site->next = __atomic_load_n(&sites, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&sites, &site->next, site, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+  }
+
+  __atomic_fetch_add(&site->acquisitions, 1, __ATOMIC_RELAXED);
+  if (contended) {
+    __atomic_fetch_add(&site->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->wait_ns, (unsigned long long)wait_ns,
+                       __ATOMIC_RELAXED);
+    update_max(&site->max_wait_ns, (unsigned long long)wait_ns);
+  }
+
+  if (num_held_locks < LOCK_PROFILE_MAX_HELD) {
+    held_locks[num_held_locks++] =
+        (struct HeldLock){lock, site, clock_now_ns()};
+  }
+}
+
+/*
+ * Stops measuring how long a lock is held by the calling thread, counting it
+ * for the site that took it. Locks not taken at a site, or taken while too
+ * many were held, aren't measured.
+ * @param lock  Lock about to be released.
+ */
+static void lock_released(const void *lock) {
+  for (int i = num_held_locks - 1; i >= 0; i--) {
+    if (held_locks[i].lock == lock) {
+      struct LockSite *site = held_locks[i].site;
+      unsigned long long hold_ns =
+          (unsigned long long)(clock_now_ns() - held_locks[i].since_ns);
+      __atomic_fetch_add(&site->hold_ns, hold_ns, __ATOMIC_RELAXED);
+      update_max(&site->max_hold_ns, hold_ns);
+      held_locks[i] = held_locks[--num_held_locks];
+      return;
+    }
+  }
+}
+#endif
+
+long long clock_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
 void rwlock_init(pthread_rwlock_t *lock) {
   if (pthread_rwlock_init(lock, NULL) != 0) {
@@ -13,6 +169,9 @@ void rwlock_init(pthread_rwlock_t *lock) {
 }
 
 void rwlock_destroy(pthread_rwlock_t *lock) {
+#ifdef LOCK_PROFILE
+  lock_released(lock);
+#endif
   if (pthread_rwlock_destroy(lock) != 0) {
     perror("Failed to destroy the rwlock");
     exit(EXIT_FAILURE);
@@ -34,6 +193,9 @@ void rwlock_wrlock(pthread_rwlock_t *lock) {
 }
 
 void rwlock_unlock(pthread_rwlock_t *lock) {
+#ifdef LOCK_PROFILE
+  lock_released(lock);
+#endif
   if (pthread_rwlock_unlock(lock) != 0) {
     perror("Failed to unlock the rwlock");
     exit(EXIT_FAILURE);
@@ -48,6 +210,9 @@ void mutex_init(pthread_mutex_t *mutex) {
 }
 
 void mutex_destroy(pthread_mutex_t *mutex) {
+#ifdef LOCK_PROFILE
+  lock_released(mutex);
+#endif
   if (pthread_mutex_destroy(mutex) != 0) {
     perror("Failed to destroy the mutex");
     exit(EXIT_FAILURE);
@@ -62,8 +227,46 @@ void mutex_lock(pthread_mutex_t *mutex) {
 }
 
 void mutex_unlock(pthread_mutex_t *mutex) {
+#ifdef LOCK_PROFILE
+  lock_released(mutex);
+#endif
   if (pthread_mutex_unlock(mutex) != 0) {
     perror("Failed to unlock the mutex");
     exit(EXIT_FAILURE);
   }
-}
\ No newline at end of file
+}
+
+#ifdef LOCK_PROFILE
+void rwlock_rdlock_at(pthread_rwlock_t *lock, struct LockSite *site) {
+  long long wait_ns = 0;
+  int contended = pthread_rwlock_tryrdlock(lock) != 0;
+  if (contended) {
+    long long start_ns = clock_now_ns();
+    rwlock_rdlock(lock);
+    wait_ns = clock_now_ns() - start_ns;
+  }
+  lock_acquired(lock, site, contended, wait_ns);
+}
+
+void rwlock_wrlock_at(pthread_rwlock_t *lock, struct LockSite *site) {
+  long long wait_ns = 0;
+  int contended = pthread_rwlock_trywrlock(lock) != 0;
+  if (contended) {
+    long long start_ns = clock_now_ns();
+    rwlock_wrlock(lock);
+    wait_ns = clock_now_ns() - start_ns;
+  }
+  lock_acquired(lock, site, contended, wait_ns);
+}
+
+void mutex_lock_at(pthread_mutex_t *mutex, struct LockSite *site) {
+  long long wait_ns = 0;
+  int contended = pthread_mutex_trylock(mutex) != 0;
+  if (contended) {
+    long long start_ns = clock_now_ns();
+    mutex_lock(mutex);
+    wait_ns = clock_now_ns() - start_ns;
+  }
+  lock_acquired(mutex, site, contended, wait_ns);
+}
+#endif
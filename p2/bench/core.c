@@ -0,0 +1,313 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/perf.h"
+#include "bench/util.h"
+#include "common/clock.h"
+#include "server/operations.h"
+
+#define CORE_USAGE "[-t max threads] [-n ops per thread] [-e events] [-v rows]x[cols]"
+
+#define RESERVE_EVENTS 16  // Events reservations are spread over
+#define RESERVE_COLS 64    // Columns of the events reserved in, each thread reserving in rows of its own
+
+// Operations of the core measured
+enum CoreOp { CORE_LOOKUP, CORE_RESERVE, CORE_SHOW, CORE_LIST, NUM_CORE_OPS };
+
+static const char *op_names[NUM_CORE_OPS] = {"lookup", "reserve", "show", "list"};
+
+// Seats per reservation and fraction of reservations that conflict, each pair measured at every thread count
+static const size_t reserve_seats[] = {1, 8, 64};
+static const double conflict_rates[] = {0, 0.5};
+
+// What every run shares
+struct CoreConfig {
+  size_t max_threads;
+  unsigned long ops;  // Per thread
+  unsigned int num_events;
+  size_t num_rows, num_cols;
+};
+
+// A single measurement
+struct CoreRun {
+  const struct CoreConfig *config;
+  enum CoreOp op;
+  size_t seats;
+  double conflict_rate;
+  size_t threads;
+  size_t rows_per_thread;  // Rows of each reserve event a thread has, enough for all of its reservations
+  pthread_barrier_t start;
+};
+
+// A thread of a run, and the latency of each of its ops
+struct CoreWorker {
+  struct CoreRun *run;
+  size_t index;
+  long long *latencies;
+  long long start_ns, end_ns;
+  int failed;
+};
+
+/// Reserves seats in rows of its own, either fresh ones or the last ones it took when the reservation is meant to
+/// conflict, so every reservation succeeds or conflicts as the run asks.
+/// @param worker Thread reserving.
+/// @param taken Seats the thread took in each reserve event so far.
+/// @param random State of the generator.
+/// @param xs Array of seats per reservation rows.
+/// @param ys Array of seats per reservation columns.
+/// @return 0 if the reservation went as intended, 1 otherwise.
+static int reserve_once(struct CoreWorker *worker, size_t *taken, unsigned long long *random, size_t *xs,
+                        size_t *ys) {
+  struct CoreRun *run = worker->run;
+  size_t stripe = run->rows_per_thread * RESERVE_COLS;
+  unsigned int event = (unsigned int)(next_random(random) % RESERVE_EVENTS);
+  int conflict = next_uniform(random) < run->conflict_rate && taken[event] >= run->seats;
+
+  // Rows are sized for twice the reservations a thread makes on average in an event, a full one passes it on
+  for (unsigned int i = 0; !conflict && taken[event] + run->seats > stripe; i++) {
+    if (i == RESERVE_EVENTS) {
+      return 1;
+    }
+    event = (event + 1) % RESERVE_EVENTS;
+  }
+
+  size_t first = conflict ? taken[event] - run->seats : taken[event];
+  for (size_t i = 0; i < run->seats; i++) {
+    size_t seat = worker->index * stripe + first + i;
+    xs[i] = seat / RESERVE_COLS + 1;
+    ys[i] = seat % RESERVE_COLS + 1;
+  }
+
+  int result = ems_reserve(event + 1, run->seats, xs, ys);
+  if (!conflict) {
+    taken[event] += run->seats;
+  }
+  return result != conflict;
+}
+
+/// Runs the ops of a thread once every thread of the run is ready.
+static void *run_worker(void *arg) {
+  struct CoreWorker *worker = arg;
+  struct CoreRun *run = worker->run;
+  const struct CoreConfig *config = run->config;
+  unsigned long long random = 0x9E3779B97F4A7C15ULL * (worker->index + 1);
+
+  size_t *taken = calloc(RESERVE_EVENTS, sizeof(size_t));
+  size_t *xs = malloc(sizeof(size_t) * run->seats), *ys = malloc(sizeof(size_t) * run->seats);
+  unsigned int *seats = malloc(sizeof(unsigned int) * config->num_rows * config->num_cols);
+  worker->failed = taken == NULL || xs == NULL || ys == NULL || seats == NULL;
+
+  pthread_barrier_wait(&run->start);
+  worker->start_ns = clock_now_ns();
+  for (unsigned long i = 0; i < config->ops && !worker->failed; i++) {
+    unsigned int event_id = (unsigned int)(next_random(&random) % config->num_events) + 1;
+    unsigned int version, *ids = NULL;
+    size_t rows, cols, num_events;
+
+    long long start_ns = clock_now_ns();
+    switch (run->op) {
+      case CORE_LOOKUP:
+        worker->failed = get_event_version(event_id, &version, &rows, &cols);
+        break;
+      case CORE_RESERVE:
+        worker->failed = reserve_once(worker, taken, &random, xs, ys);
+        break;
+      case CORE_SHOW:
+        worker->failed = get_event_seats(event_id, seats, &version);
+        break;
+      case CORE_LIST:
+        worker->failed = get_events(&ids, &num_events);
+        free(ids);
+        break;
+      case NUM_CORE_OPS:
+        worker->failed = 1;
+        break;
+    }
+    worker->latencies[i] = clock_now_ns() - start_ns;
+  }
+  worker->end_ns = clock_now_ns();
+
+  free(taken);
+  free(xs);
+  free(ys);
+  free(seats);
+  return NULL;
+}
+
+/// Measures an op in a fresh EMS state and prints its results.
+/// @param run What to measure.
+/// @param results_fd File descriptor to print the results to.
+/// @return 0 if successful, 1 otherwise.
+static int measure(struct CoreRun *run, int results_fd) {
+  const struct CoreConfig *config = run->config;
+  if (ems_init(0)) {
+    return 1;
+  }
+
+  int failed = 0;
+  if (run->op == CORE_RESERVE) {
+    run->rows_per_thread = 2 * config->ops * run->seats / RESERVE_EVENTS / RESERVE_COLS + 1;
+    for (unsigned int i = 1; i <= RESERVE_EVENTS && !failed; i++) {
+      failed = ems_create(i, run->rows_per_thread * run->threads, RESERVE_COLS);
+    }
+  } else {
+    for (unsigned int i = 1; i <= config->num_events && !failed; i++) {
+      failed = ems_create(i, config->num_rows, config->num_cols);
+    }
+  }
+
+  size_t total_ops = run->threads * config->ops;
+  long long *latencies = malloc(sizeof(long long) * total_ops);
+  struct CoreWorker *workers = calloc(run->threads, sizeof(struct CoreWorker));
+  pthread_t *threads = malloc(sizeof(pthread_t) * run->threads);
+  // Counters are inherited by the workers, and the main thread joins the barrier to start them along with the run
+  struct PerfCounters counters;
+  if (failed || latencies == NULL || workers == NULL || threads == NULL || perf_counters_open_self(&counters) != 0) {
+    free(latencies);
+    free(workers);
+    free(threads);
+    ems_terminate();
+    return 1;
+  }
+  if (pthread_barrier_init(&run->start, NULL, (unsigned int)run->threads + 1) != 0) {
+    perf_counters_close(&counters);
+    free(latencies);
+    free(workers);
+    free(threads);
+    ems_terminate();
+    return 1;
+  }
+
+  size_t started = 0;
+  for (; started < run->threads; started++) {
+    workers[started] = (struct CoreWorker){run, started, latencies + started * config->ops, 0, 0, 0};
+    if (pthread_create(&threads[started], NULL, run_worker, &workers[started]) != 0) {
+      break;
+    }
+  }
+  // Threads that started wait at the barrier for the ones that didn't, so the run can't go on without them
+  if (started < run->threads) {
+    fprintf(stderr, "Failed to create thread\n");
+    exit(1);
+  }
+  perf_counters_start(&counters);
+  pthread_barrier_wait(&run->start);
+
+  long long first_start_ns = 0, last_end_ns = 0;
+  for (size_t i = 0; i < run->threads; i++) {
+    pthread_join(threads[i], NULL);
+    failed |= workers[i].failed;
+    first_start_ns = i == 0 || workers[i].start_ns < first_start_ns ? workers[i].start_ns : first_start_ns;
+    last_end_ns = workers[i].end_ns > last_end_ns ? workers[i].end_ns : last_end_ns;
+  }
+  // Counts of the workers are only added to the counters once they're gone
+  struct PerfCounts counts;
+  perf_counters_stop(&counters, &counts);
+  perf_counters_close(&counters);
+  pthread_barrier_destroy(&run->start);
+  ems_terminate();
+
+  if (!failed) {
+    double sum_ns = 0;
+    for (size_t i = 0; i < total_ops; i++) {
+      sum_ns += (double)latencies[i];
+    }
+    sort_latencies(latencies, total_ops);
+    double elapsed_s = (double)(last_end_ns - first_start_ns) / 1e9;
+    dprintf(results_fd, "%s,%zu,%.2f,%zu,%zu,%.0f,%.0f,%lld,%lld,%lld,", op_names[run->op], run->seats,
+            run->conflict_rate, run->threads, total_ops, (double)total_ops / elapsed_s, sum_ns / (double)total_ops,
+            percentile_ns(latencies, total_ops, 0.5), percentile_ns(latencies, total_ops, 0.99),
+            percentile_ns(latencies, total_ops, 0.999));
+    perf_counts_print(results_fd, &counts, total_ops);
+    dprintf(results_fd, "\n");
+  }
+
+  free(latencies);
+  free(workers);
+  free(threads);
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  struct CoreConfig config = {8, 10000, 256, 100, 100};
+  unsigned long value;
+  int option, invalid = 0;
+  while ((option = getopt(argc, argv, "t:n:e:v:")) != -1) {
+    switch (option) {
+      case 't':
+        invalid |= parse_number(optarg, &value) || value == 0;
+        config.max_threads = value;
+        break;
+      case 'n':
+        invalid |= parse_number(optarg, &config.ops) || config.ops == 0;
+        break;
+      case 'e':
+        invalid |= parse_number(optarg, &value) || value == 0 || value > UINT32_MAX;
+        config.num_events = (unsigned int)value;
+        break;
+      case 'v':
+        invalid |= sscanf(optarg, "%zux%zu", &config.num_rows, &config.num_cols) != 2 || config.num_rows == 0 ||
+                   config.num_cols == 0;
+        break;
+      default:
+        invalid = 1;
+        break;
+    }
+  }
+  if (invalid || optind != argc) {
+    fprintf(stderr, "Usage: %s %s\n", argv[0], CORE_USAGE);
+    return 1;
+  }
+
+  // Refused reservations are reported on stderr, keep it for the errors of the benchmark only
+  int results_fd = dup(STDOUT_FILENO);
+  int errors_fd = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || errors_fd < 0 || null_fd < 0 || dup2(null_fd, STDERR_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  dprintf(results_fd,
+          "op,seats,conflict_rate,threads,ops,ops_per_sec,mean_ns,p50_ns,p99_ns,p999_ns," PERF_CSV_HEADER "\n");
+  for (int op = 0; op < NUM_CORE_OPS; op++) {
+    size_t num_variants = op == CORE_RESERVE ? sizeof(reserve_seats) / sizeof(reserve_seats[0]) *
+                                                   sizeof(conflict_rates) / sizeof(conflict_rates[0])
+                                             : 1;
+    for (size_t variant = 0; variant < num_variants; variant++) {
+      // Thread counts double up to the largest one
+      for (size_t threads = 1;; threads = threads * 2 < config.max_threads ? threads * 2 : config.max_threads) {
+        struct CoreRun run = {.config = &config, .op = (enum CoreOp)op, .threads = threads};
+        if (op == CORE_RESERVE) {
+          size_t num_rates = sizeof(conflict_rates) / sizeof(conflict_rates[0]);
+          run.seats = reserve_seats[variant / num_rates];
+          run.conflict_rate = conflict_rates[variant % num_rates];
+        }
+
+        // The EMS state can only be initialized once per process, so each run gets a process of its own
+        pid_t pid = fork();
+        if (pid == 0) {
+          exit(measure(&run, results_fd));
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          dprintf(errors_fd, "Failed to measure %s with %zu threads\n", op_names[op], threads);
+          return 1;
+        }
+        if (threads == config.max_threads) {
+          break;
+        }
+      }
+    }
+  }
+
+  close(null_fd);
+  close(errors_fd);
+  close(results_fd);
+  return 0;
+}
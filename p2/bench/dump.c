@@ -0,0 +1,137 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/clock.h"
+#include "server/operations.h"
+
+#define RESERVERS 4
+
+struct Stall {
+  long long max_reserve_ns;
+  unsigned long reserves;
+};
+
+static unsigned int num_events;
+static size_t num_rows, num_cols;
+
+static volatile int running = 1;
+static struct Stall stalls[RESERVERS];
+static pthread_mutex_t stalls_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int next_random(unsigned int *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/// Reserves random seats of random events, keeping the slowest reservation seen.
+static void *reserve_loop(void *arg) {
+  struct Stall *stall = arg;
+  unsigned int state = (unsigned int)(stall - stalls) * 2654435761u + 1;
+
+  while (running) {
+    unsigned int event_id = next_random(&state) % num_events + 1;
+    size_t x = next_random(&state) % num_rows + 1, y = next_random(&state) % num_cols + 1;
+
+    long long start = clock_now_ns();
+    ems_reserve(event_id, 1, &x, &y);
+    long long elapsed = clock_now_ns() - start;
+
+    pthread_mutex_lock(&stalls_lock);
+    if (elapsed > stall->max_reserve_ns) {
+      stall->max_reserve_ns = elapsed;
+    }
+    stall->reserves++;
+    pthread_mutex_unlock(&stalls_lock);
+  }
+
+  return NULL;
+}
+
+/// Takes the slowest operations seen since the last call, and resets them.
+static struct Stall take_stalls(void) {
+  struct Stall total = {0, 0};
+
+  pthread_mutex_lock(&stalls_lock);
+  for (int i = 0; i < RESERVERS; i++) {
+    if (stalls[i].max_reserve_ns > total.max_reserve_ns) {
+      total.max_reserve_ns = stalls[i].max_reserve_ns;
+    }
+    total.reserves += stalls[i].reserves;
+    stalls[i] = (struct Stall){0, 0};
+  }
+  pthread_mutex_unlock(&stalls_lock);
+
+  return total;
+}
+
+static void report(int results_fd, const char *phase, long long elapsed_ns, struct Stall stall) {
+  dprintf(results_fd, "%s,%u,%.2f,%lu,%.1f,%.3f\n", phase, num_events, (double)elapsed_ns / 1e6, stall.reserves,
+          (double)stall.reserves * 1e9 / (double)elapsed_ns, (double)stall.max_reserve_ns / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <events> <rows> <cols>\n", argv[0]);
+    return 1;
+  }
+
+  num_events = (unsigned int)strtoul(argv[1], NULL, 10);
+  num_rows = strtoul(argv[2], NULL, 10);
+  num_cols = strtoul(argv[3], NULL, 10);
+  if (num_events == 0 || num_rows == 0 || num_cols == 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // Both dumps go to /dev/null, as do the errors of conflicting reservations
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0 || dup2(null_fd, STDERR_FILENO) < 0) {
+    return 1;
+  }
+
+  if (ems_init(0)) {
+    return 1;
+  }
+  for (unsigned int id = 1; id <= num_events; id++) {
+    ems_create(id, num_rows, num_cols);
+  }
+
+  pthread_t threads[RESERVERS];
+  for (int i = 0; i < RESERVERS; i++) {
+    pthread_create(&threads[i], NULL, reserve_loop, &stalls[i]);
+  }
+
+  dprintf(results_fd, "phase,events,duration_ms,reserves,reserves_per_sec,max_reserve_ms\n");
+
+  struct timespec idle = {0, 200000000};
+  take_stalls();
+  long long start = clock_now_ns();
+  nanosleep(&idle, NULL);
+  report(results_fd, "idle", clock_now_ns() - start, take_stalls());
+
+  start = clock_now_ns();
+  ems_list_events();
+  fflush(stdout);
+  report(results_fd, "inline_dump", clock_now_ns() - start, take_stalls());
+
+  start = clock_now_ns();
+  ems_dump_events(null_fd);
+  report(results_fd, "snapshot_dump", clock_now_ns() - start, take_stalls());
+
+  running = 0;
+  for (int i = 0; i < RESERVERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  ems_terminate();
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/util.h"
+#include "common/clock.h"
+#include "common/fibers.h"
+#include "server/operations.h"
+
+#define FIBERS_USAGE \
+  "[-t threads] [-c max ops in flight] [-n ops per op in flight] [-d delay in us] [-r fraction of reservations]"
+
+#define FIBER_EVENTS 16  // Events the ops are spread over
+#define FIBER_ROWS 32
+#define FIBER_COLS 32
+
+// How the ops of a run wait for the access delay
+enum FiberMode { MODE_BLOCKING, MODE_FIBERS, NUM_FIBER_MODES };
+
+static const char *mode_names[NUM_FIBER_MODES] = {"blocking", "fibers"};
+
+// What every run shares
+struct FiberConfig {
+  size_t threads;
+  size_t max_concurrency;
+  unsigned long ops;  // Per op in flight
+  unsigned int delay_us;
+  double reserve_rate;
+};
+
+// A single measurement, with the latency of every op
+struct FiberRun {
+  const struct FiberConfig *config;
+  enum FiberMode mode;
+  size_t concurrency;  // Ops in flight, each on a thread of its own when blocking and on a fiber otherwise
+  long long *latencies;
+  int failed;
+};
+
+// A thread of a blocking run, running a single op in flight
+struct BlockingThread {
+  struct FiberRun *run;
+  size_t index;
+  pthread_t thread;
+};
+
+/// Runs the ops of a single op in flight, one after the other. Lookups and reservations both pay the access delay,
+/// and reservations may be refused as they pick their seat at random.
+/// @param arg Run the ops are part of.
+/// @param index Index of the op in flight.
+static void run_ops(void *arg, size_t index) {
+  struct FiberRun *run = arg;
+  const struct FiberConfig *config = run->config;
+  unsigned long long random = 0x9E3779B97F4A7C15ULL * (index + 1);
+  long long *latencies = run->latencies + index * config->ops;
+
+  for (unsigned long i = 0; i < config->ops; i++) {
+    unsigned int event_id = (unsigned int)(next_random(&random) % FIBER_EVENTS) + 1;
+    long long start_ns = clock_now_ns();
+    if (next_uniform(&random) < config->reserve_rate) {
+      size_t x = next_random(&random) % FIBER_ROWS + 1, y = next_random(&random) % FIBER_COLS + 1;
+      ems_reserve(event_id, 1, &x, &y);
+    } else {
+      unsigned int version;
+      size_t rows, cols;
+      if (get_event_version(event_id, &version, &rows, &cols)) {
+        __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+      }
+    }
+    latencies[i] = clock_now_ns() - start_ns;
+  }
+}
+
+/// Runs the ops in flight of a blocking run on a thread of their own.
+static void *run_blocking(void *arg) {
+  struct BlockingThread *thread = arg;
+  run_ops(thread->run, thread->index);
+  return NULL;
+}
+
+/// Measures a mode at a number of ops in flight in a fresh EMS state and prints its results.
+/// @param run What to measure.
+/// @param results_fd File descriptor to print the results to.
+/// @return 0 if successful, 1 otherwise.
+static int measure(struct FiberRun *run, int results_fd) {
+  const struct FiberConfig *config = run->config;
+  if (ems_init(config->delay_us)) {
+    return 1;
+  }
+  int failed = 0;
+  for (unsigned int i = 1; i <= FIBER_EVENTS && !failed; i++) {
+    failed = ems_create(i, FIBER_ROWS, FIBER_COLS);
+  }
+
+  size_t total_ops = run->concurrency * config->ops;
+  size_t threads = run->mode == MODE_BLOCKING || run->concurrency < config->threads ? run->concurrency
+                                                                                     : config->threads;
+  run->latencies = malloc(sizeof(long long) * total_ops);
+  struct BlockingThread *blocking_threads = malloc(sizeof(struct BlockingThread) * threads);
+  if (failed || run->latencies == NULL || blocking_threads == NULL) {
+    free(run->latencies);
+    free(blocking_threads);
+    ems_terminate();
+    return 1;
+  }
+
+  long long start_ns = clock_now_ns();
+  if (run->mode == MODE_FIBERS) {
+    failed = fiber_pool_run(threads, run->concurrency, run_ops, run);
+  } else {
+    size_t started = 0;
+    for (; started < threads; started++) {
+      blocking_threads[started] = (struct BlockingThread){.run = run, .index = started};
+      if (pthread_create(&blocking_threads[started].thread, NULL, run_blocking, &blocking_threads[started]) != 0) {
+        fprintf(stderr, "Failed to create thread\n");
+        failed = 1;
+        break;
+      }
+    }
+    for (size_t i = 0; i < started; i++) {
+      pthread_join(blocking_threads[i].thread, NULL);
+    }
+  }
+  long long elapsed_ns = clock_now_ns() - start_ns;
+  failed |= run->failed;
+  ems_terminate();
+
+  if (!failed) {
+    double sum_ns = 0;
+    for (size_t i = 0; i < total_ops; i++) {
+      sum_ns += (double)run->latencies[i];
+    }
+    sort_latencies(run->latencies, total_ops);
+    dprintf(results_fd, "%s,%zu,%zu,%zu,%.0f,%.1f,%.1f,%.1f,%.1f\n", mode_names[run->mode], threads, run->concurrency,
+            total_ops, (double)total_ops / ((double)elapsed_ns / 1e9), sum_ns / 1e3 / (double)total_ops,
+            (double)percentile_ns(run->latencies, total_ops, 0.5) / 1e3,
+            (double)percentile_ns(run->latencies, total_ops, 0.99) / 1e3,
+            (double)percentile_ns(run->latencies, total_ops, 0.999) / 1e3);
+  }
+
+  free(run->latencies);
+  free(blocking_threads);
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  struct FiberConfig config = {4, 1024, 100, 1000, 0.1};
+  unsigned long value;
+  int option, invalid = 0;
+  while ((option = getopt(argc, argv, "t:c:n:d:r:")) != -1) {
+    switch (option) {
+      case 't':
+        invalid |= parse_number(optarg, &value) || value == 0;
+        config.threads = value;
+        break;
+      case 'c':
+        invalid |= parse_number(optarg, &value) || value == 0;
+        config.max_concurrency = value;
+        break;
+      case 'n':
+        invalid |= parse_number(optarg, &config.ops) || config.ops == 0;
+        break;
+      case 'd':
+        invalid |= parse_number(optarg, &value) || value > 999999;
+        config.delay_us = (unsigned int)value;
+        break;
+      case 'r':
+        config.reserve_rate = strtod(optarg, NULL);
+        invalid |= config.reserve_rate < 0 || config.reserve_rate > 1;
+        break;
+      default:
+        invalid = 1;
+        break;
+    }
+  }
+  if (invalid || optind != argc) {
+    fprintf(stderr, "Usage: %s %s\n", argv[0], FIBERS_USAGE);
+    return 1;
+  }
+
+  // Refused reservations are reported on stderr, keep it for the errors of the benchmark only
+  int results_fd = dup(STDOUT_FILENO);
+  int errors_fd = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || errors_fd < 0 || null_fd < 0 || dup2(null_fd, STDERR_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  // Ops in flight double up to the largest number. Blocking, each needs a thread of its own, so they stop at the
+  // thread count while fibers go on with the same threads.
+  dprintf(results_fd, "mode,threads,concurrency,ops,ops_per_sec,mean_us,p50_us,p99_us,p999_us\n");
+  for (size_t concurrency = 1;;
+       concurrency = concurrency * 2 < config.max_concurrency ? concurrency * 2 : config.max_concurrency) {
+    for (int mode = 0; mode < NUM_FIBER_MODES; mode++) {
+      if (mode == MODE_BLOCKING && concurrency > config.threads) {
+        continue;
+      }
+
+      // The EMS state can only be initialized once per process, so each run gets a process of its own
+      struct FiberRun run = {.config = &config, .mode = (enum FiberMode)mode, .concurrency = concurrency};
+      pid_t pid = fork();
+      if (pid == 0) {
+        exit(measure(&run, results_fd));
+      }
+      int status;
+      if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        dprintf(errors_fd, "Failed to measure %s with %zu ops in flight\n", mode_names[mode], concurrency);
+        return 1;
+      }
+    }
+    if (concurrency == config.max_concurrency) {
+      break;
+    }
+  }
+
+  close(null_fd);
+  close(errors_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "client/jobfile.h"
+#include "common/clock.h"
+#include "common/io.h"
+
+#define NUM_EVENTS 64  // Events the generated commands go to
+
+/// Writes a text job of mostly RESERVE and SHOW commands.
+/// @param file File to write to.
+/// @param len Bytes to write, at least.
+/// @return 0 if successful, 1 otherwise.
+static int generate_job(FILE *file, size_t len) {
+  unsigned int seed = 1;
+  for (unsigned int event_id = 1; event_id <= NUM_EVENTS; event_id++) {
+    fprintf(file, "CREATE %u 100 100\n", event_id);
+  }
+
+  while ((size_t)ftell(file) < len) {
+    seed = seed * 1103515245u + 12345u;
+    unsigned int event_id = seed % NUM_EVENTS + 1, row = (seed >> 8) % 90 + 1, col = (seed >> 16) % 90 + 1;
+    switch ((seed >> 24) % 8) {
+      case 0:
+        fprintf(file, "RESERVE %u [(%u,%u)-(%u,%u)]\n", event_id, row, col, row + 5, col + 5);
+        break;
+      case 1:
+      case 2:
+      case 3:
+        fprintf(file, "RESERVE %u [(%u,%u) (%u,%u) (%u,%u)]\n", event_id, row, col, row, col + 1, row + 1, col);
+        break;
+      case 4:
+        fprintf(file, "LIST\n");
+        break;
+      case 5:
+        fprintf(file, "WAIT 0\n");
+        break;
+      default:
+        fprintf(file, "SHOW %u\n", event_id);
+        break;
+    }
+  }
+  return fflush(file) != 0;
+}
+
+/// Reads every command of a job file, compiled or text, from its start.
+/// @param fd File descriptor of the job file.
+/// @param num_commands Variable to store the number of commands in.
+/// @param checksum Variable to store a sum of every argument read in.
+/// @return 0 if successful, 1 otherwise.
+static int read_job(int fd, size_t *num_commands, unsigned long long *checksum) {
+  job_reader_t job;
+  if (lseek(fd, 0, SEEK_SET) != 0 || job_reader_open(&job, fd)) {
+    return 1;
+  }
+
+  seat_range_t *ranges = NULL;
+  size_t ranges_capacity = 0;
+  *num_commands = 0;
+  *checksum = 0;
+
+  enum Command command;
+  while ((command = job_next(&job)) != EOC) {
+    unsigned int event_id = 0, delay = 0;
+    size_t num_rows = 0, num_columns = 0, num_ranges;
+
+    (*num_commands)++;
+    switch (command) {
+      case CMD_CREATE:
+        *checksum += (unsigned int)job_parse_create(&job, &event_id, &num_rows, &num_columns);
+        *checksum += event_id + num_rows + num_columns;
+        break;
+
+      case CMD_RESERVE:
+        num_ranges = job_parse_reserve(&job, &event_id, &ranges, &ranges_capacity);
+        *checksum += event_id;
+        for (size_t i = 0; i < num_ranges; i++) {
+          *checksum += ranges[i].first_row + ranges[i].first_col + ranges[i].last_row + ranges[i].last_col;
+        }
+        break;
+
+      case CMD_SHOW:
+        *checksum += (unsigned int)job_parse_show(&job, &event_id) + event_id;
+        break;
+
+      case CMD_WAIT:
+        *checksum += (unsigned int)job_parse_wait(&job, &delay, NULL) + delay;
+        break;
+
+      case CMD_LIST_EVENTS:
+      case CMD_HELP:
+      case CMD_INVALID:
+      case CMD_EMPTY:
+      case EOC:
+        break;
+    }
+  }
+
+  job_reader_close(&job);
+  free(ranges);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s <megabytes of text job> [runs]\n", argv[0]);
+    return 1;
+  }
+
+  size_t megabytes = strtoul(argv[1], NULL, 10);
+  unsigned long runs = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  if (megabytes == 0 || runs == 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  FILE *text = tmpfile(), *compiled = tmpfile();
+  if (text == NULL || compiled == NULL || generate_job(text, megabytes << 20)) {
+    fprintf(stderr, "Failed to generate job\n");
+    return 1;
+  }
+
+  long long start = clock_now_ns();
+  if (lseek(fileno(text), 0, SEEK_SET) != 0 || compile_job(fileno(text), fileno(compiled))) {
+    fprintf(stderr, "Failed to compile job\n");
+    return 1;
+  }
+  long long compile_elapsed = clock_now_ns() - start;
+
+  // Both are read from the page cache, so the load is what each format costs, not the disk
+  int fds[] = {fileno(text), fileno(compiled)};
+  const char *names[] = {"text", "compiled"};
+  size_t num_commands[2];
+  unsigned long long checksums[2];
+  long long elapsed[2] = {0, 0};
+  for (unsigned long run = 0; run < runs; run++) {
+    for (int i = 0; i < 2; i++) {
+      start = clock_now_ns();
+      if (read_job(fds[i], &num_commands[i], &checksums[i])) {
+        fprintf(stderr, "Failed to read %s job\n", names[i]);
+        return 1;
+      }
+      elapsed[i] += clock_now_ns() - start;
+    }
+
+    // Both must read the same commands
+    if (num_commands[0] != num_commands[1] || checksums[0] != checksums[1]) {
+      fprintf(stderr, "Compiled job differs from the text one\n");
+      return 1;
+    }
+  }
+
+  printf("format,file_bytes,commands,ms,commands_per_sec\n");
+  for (int i = 0; i < 2; i++) {
+    struct stat st;
+    if (fstat(fds[i], &st) != 0) {
+      return 1;
+    }
+    printf("%s,%lld,%zu,%.1f,%.0f\n", names[i], (long long)st.st_size, num_commands[i],
+           (double)elapsed[i] / 1e6 / (double)runs, (double)num_commands[i] * (double)runs * 1e9 / (double)elapsed[i]);
+  }
+  printf("jobc,%lld,%zu,%.1f,%.0f\n", (long long)lseek(fds[1], 0, SEEK_END), num_commands[1],
+         (double)compile_elapsed / 1e6, (double)num_commands[1] * 1e9 / (double)compile_elapsed);
+
+  fclose(text);
+  fclose(compiled);
+  return 0;
+}
@@ -0,0 +1,273 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench/util.h"
+
+#define JOBGEN_USAGE                                                                                      \
+  "[-n commands] [-e events] [-v rows]x[cols][-[rows]x[cols]] [-z zipf exponent] [-k seats[-seats]] " \
+  "[-x conflict rate] [-m reserve:show:list] [-S seed] [output .jobs file path]"
+
+// Commands generated after the events are created
+enum JobOp { JOB_RESERVE, JOB_SHOW, JOB_LIST, NUM_JOB_OPS };
+
+// What the generated job looks like
+struct JobConfig {
+  unsigned long num_commands;  // After the CREATE commands
+  unsigned int num_events;
+  size_t min_rows, min_cols, max_rows, max_cols;  // Venue sizes are drawn uniformly between these
+  double zipf_exponent;                           // 0 makes every event as popular
+  size_t min_seats, max_seats;                    // Seats per reservation, drawn uniformly between these
+  double conflict_rate;  // Fraction of reservations made to overlap seats reserved before them
+  unsigned int weights[NUM_JOB_OPS];
+  unsigned long long seed;
+};
+
+// An event as the job leaves it, to know which seats are still free
+struct JobEvent {
+  unsigned int id;
+  size_t num_rows, num_cols;
+  size_t num_reserved;
+  unsigned char *reserved;  // Whether each seat is reserved, row by row
+};
+
+/// Draws a number in [min, max] from a generator.
+/// @param state State of the generator, never 0.
+/// @return Number drawn.
+static size_t next_between(unsigned long long *state, size_t min, size_t max) {
+  return min + (size_t)(next_random(state) % (max - min + 1));
+}
+
+/// Picks the seats of a reservation, marking them as reserved unless it's meant to conflict.
+/// @param event Event to reserve in.
+/// @param num_seats Seats to pick, at most the seats of the event.
+/// @param conflict Whether the reservation must overlap a reserved seat.
+/// @param random State of the generator.
+/// @param seats Array to store the index of each seat in.
+/// @return 1 if the reservation conflicts, 0 otherwise.
+static int pick_seats(struct JobEvent *event, size_t num_seats, int conflict, unsigned long long *random,
+                      size_t *seats) {
+  size_t total = event->num_rows * event->num_cols;
+  size_t start = (size_t)(next_random(random) % total);
+
+  // Seats next to each other are taken from a random one on, the way a group books
+  conflict |= event->num_reserved + num_seats > total;
+  if (conflict && event->num_reserved > 0) {
+    while (!event->reserved[start]) {
+      start = (start + 1) % total;
+    }
+    for (size_t i = 0; i < num_seats; i++) {
+      seats[i] = (start + i) % total;
+    }
+    return 1;
+  }
+
+  for (size_t i = 0, seat = start; i < num_seats; seat = (seat + 1) % total) {
+    if (!event->reserved[seat]) {
+      event->reserved[seat] = 1;
+      seats[i++] = seat;
+    }
+  }
+  event->num_reserved += num_seats;
+  return 0;
+}
+
+/// Writes a job.
+/// @param config What the job looks like.
+/// @param out File to write to.
+/// @return 0 if successful, 1 otherwise.
+static int generate_job(const struct JobConfig *config, FILE *out) {
+  unsigned long long random = config->seed != 0 ? config->seed : 1;
+  struct JobEvent *events = calloc(config->num_events, sizeof(struct JobEvent));
+  double *popularity = malloc(sizeof(double) * config->num_events);
+  size_t *seats = malloc(sizeof(size_t) * config->max_seats);
+  if (events == NULL || popularity == NULL || seats == NULL) {
+    fprintf(stderr, "Failed to allocate memory\n");
+    free(events);
+    free(popularity);
+    free(seats);
+    return 1;
+  }
+
+  // The most popular events are spread over the ids, so they aren't always the first ones created
+  for (unsigned int i = 0; i < config->num_events; i++) {
+    events[i].id = i + 1;
+  }
+  for (unsigned int i = config->num_events - 1; i > 0; i--) {
+    unsigned int j = (unsigned int)(next_random(&random) % (i + 1));
+    unsigned int id = events[i].id;
+    events[i].id = events[j].id;
+    events[j].id = id;
+  }
+
+  // Cumulative Zipf weights of the events by rank, drawn from by bisection
+  double total_popularity = 0;
+  for (unsigned int i = 0; i < config->num_events; i++) {
+    total_popularity += 1.0 / pow(i + 1, config->zipf_exponent);
+    popularity[i] = total_popularity;
+  }
+
+  int failed = 0;
+  for (unsigned int i = 0; i < config->num_events && !failed; i++) {
+    struct JobEvent *event = &events[i];
+    event->num_rows = next_between(&random, config->min_rows, config->max_rows);
+    event->num_cols = next_between(&random, config->min_cols, config->max_cols);
+    event->reserved = calloc(event->num_rows * event->num_cols, 1);
+    failed = event->reserved == NULL || fprintf(out, "CREATE %u %zu %zu\n", event->id, event->num_rows,
+                                                event->num_cols) < 0;
+  }
+
+  unsigned int total_weight = config->weights[JOB_RESERVE] + config->weights[JOB_SHOW] + config->weights[JOB_LIST];
+  unsigned long counts[NUM_JOB_OPS] = {0}, conflicts = 0, seats_reserved = 0;
+  for (unsigned long i = 0; i < config->num_commands && !failed; i++) {
+    unsigned int pick = (unsigned int)(next_random(&random) % total_weight);
+    int op = 0;
+    while (pick >= config->weights[op]) {
+      pick -= config->weights[op++];
+    }
+    counts[op]++;
+
+    double target = next_uniform(&random) * total_popularity;
+    unsigned int low = 0, high = config->num_events - 1;
+    while (low < high) {
+      unsigned int middle = (low + high) / 2;
+      if (popularity[middle] > target) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    struct JobEvent *event = &events[low];
+
+    if (op == JOB_LIST) {
+      failed = fprintf(out, "LIST\n") < 0;
+      continue;
+    }
+    if (op == JOB_SHOW) {
+      failed = fprintf(out, "SHOW %u\n", event->id) < 0;
+      continue;
+    }
+
+    size_t num_seats = next_between(&random, config->min_seats, config->max_seats);
+    num_seats = num_seats < event->num_rows * event->num_cols ? num_seats : event->num_rows * event->num_cols;
+    int conflict = pick_seats(event, num_seats, next_uniform(&random) < config->conflict_rate, &random, seats);
+    conflicts += (unsigned long)conflict;
+    seats_reserved += conflict ? 0 : num_seats;
+
+    failed = fprintf(out, "RESERVE %u [", event->id) < 0;
+    for (size_t j = 0; j < num_seats && !failed; j++) {
+      failed = fprintf(out, j == 0 ? "(%zu,%zu)" : " (%zu,%zu)", seats[j] / event->num_cols + 1,
+                       seats[j] % event->num_cols + 1) < 0;
+    }
+    failed = failed || fprintf(out, "]\n") < 0;
+  }
+
+  if (!failed) {
+    fprintf(stderr, "events=%u reserves=%lu conflicts=%lu seats_reserved=%lu shows=%lu lists=%lu\n",
+            config->num_events, counts[JOB_RESERVE], conflicts, seats_reserved, counts[JOB_SHOW], counts[JOB_LIST]);
+  }
+
+  for (unsigned int i = 0; i < config->num_events; i++) {
+    free(events[i].reserved);
+  }
+  free(events);
+  free(popularity);
+  free(seats);
+  return failed || fflush(out) != 0;
+}
+
+/// Parses a size of an option, either seats or a venue given as rows x columns.
+/// @param arg Argument of the option, from the size on.
+/// @param is_venue Whether the size is a venue.
+/// @param size Two values to store the size in, the second being 1 for seats.
+/// @return 0 if successful, 1 otherwise.
+static int parse_size(const char *arg, int is_venue, size_t *size) {
+  size[1] = 1;
+  return is_venue ? sscanf(arg, "%zux%zu", &size[0], &size[1]) != 2 : sscanf(arg, "%zu", &size[0]) != 1;
+}
+
+/// Parses a range of sizes of an option, either a single size or two joined by a dash.
+/// @param arg Argument of the option.
+/// @param is_venue Whether the sizes are venues.
+/// @param min Two values to store the start of the range in.
+/// @param max Two values to store the end of the range in.
+/// @return 0 if successful, 1 otherwise.
+static int parse_range(const char *arg, int is_venue, size_t *min, size_t *max) {
+  const char *dash = strchr(arg, '-');
+  if (parse_size(arg, is_venue, min) || parse_size(dash != NULL ? dash + 1 : arg, is_venue, max)) {
+    return 1;
+  }
+  return min[0] == 0 || min[1] == 0 || min[0] > max[0] || min[1] > max[1];
+}
+
+int main(int argc, char *argv[]) {
+  struct JobConfig config = {1000, 16, 10, 10, 40, 40, 1.0, 1, 4, 0.1, {60, 30, 10}, 1};
+  unsigned long value;
+  size_t min[2], max[2];
+  int option, invalid = 0;
+  while ((option = getopt(argc, argv, "n:e:v:z:k:x:m:S:")) != -1) {
+    switch (option) {
+      case 'n':
+        invalid |= parse_number(optarg, &config.num_commands);
+        break;
+      case 'e':
+        invalid |= parse_number(optarg, &value) || value == 0 || value > UINT32_MAX;
+        config.num_events = (unsigned int)value;
+        break;
+      case 'v':
+        invalid |= parse_range(optarg, 1, min, max);
+        config.min_rows = min[0];
+        config.min_cols = min[1];
+        config.max_rows = max[0];
+        config.max_cols = max[1];
+        break;
+      case 'z':
+        config.zipf_exponent = strtod(optarg, NULL);
+        invalid |= config.zipf_exponent < 0;
+        break;
+      case 'k':
+        invalid |= parse_range(optarg, 0, min, max);
+        config.min_seats = min[0];
+        config.max_seats = max[0];
+        break;
+      case 'x':
+        config.conflict_rate = strtod(optarg, NULL);
+        invalid |= config.conflict_rate < 0 || config.conflict_rate > 1;
+        break;
+      case 'm':
+        invalid |= sscanf(optarg, "%u:%u:%u", &config.weights[JOB_RESERVE], &config.weights[JOB_SHOW],
+                          &config.weights[JOB_LIST]) != NUM_JOB_OPS ||
+                   config.weights[JOB_RESERVE] + config.weights[JOB_SHOW] + config.weights[JOB_LIST] == 0;
+        break;
+      case 'S':
+        invalid |= parse_number(optarg, &value);
+        config.seed = value;
+        break;
+      default:
+        invalid = 1;
+        break;
+    }
+  }
+  if (invalid || optind < argc - 1) {
+    fprintf(stderr, "Usage: %s %s\n", argv[0], JOBGEN_USAGE);
+    return 1;
+  }
+
+  FILE *out = optind < argc ? fopen(argv[optind], "w") : stdout;
+  if (out == NULL) {
+    perror("Error opening output file");
+    return 1;
+  }
+
+  int failed = generate_job(&config, out);
+  if (failed) {
+    fprintf(stderr, "Failed to generate job\n");
+  }
+  if (out != stdout && fclose(out) != 0) {
+    failed = 1;
+  }
+  return failed;
+}
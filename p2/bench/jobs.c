@@ -0,0 +1,201 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "client/jobs.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+#define EVENT_ID_STRIDE 16  // Event ids a job may use, each run gets ids of its own
+
+/// Reads a whole file.
+/// @param path Path of the file.
+/// @param len Variable to store the length of the file in.
+/// @return Contents of the file, NULL on failure.
+static char *read_file(const char *path, size_t *len) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+
+  size_t capacity = 4096;
+  char *data = malloc(capacity);
+  *len = 0;
+  size_t read_len;
+  while (data != NULL && (read_len = fread(data + *len, 1, capacity - *len, file)) > 0) {
+    *len += read_len;
+    if (*len == capacity) {
+      capacity *= 2;
+      char *new_data = realloc(data, capacity);
+      if (new_data == NULL) {
+        free(data);
+      }
+      data = new_data;
+    }
+  }
+  fclose(file);
+  return data;
+}
+
+/// Writes a job into a new file, moving its events to ids of their own.
+/// @param job Job to write.
+/// @param job_len Length of the job.
+/// @param base Id added to every event id of the job.
+/// @param num_commands Variable to store the number of commands in.
+/// @return File descriptor of the job, at its start, -1 on failure.
+static int rebase_job(const char *job, size_t job_len, unsigned int base, size_t *num_commands) {
+  FILE *out = tmpfile();
+  if (out == NULL) {
+    return -1;
+  }
+
+  *num_commands = 0;
+  const char *line = job, *end = job + job_len;
+  while (line < end) {
+    const char *next = memchr(line, '\n', (size_t)(end - line));
+    next = next != NULL ? next + 1 : end;
+    *num_commands += next - line > 1;
+
+    // Every command on an event has its id right after its name
+    const char *id = NULL;
+    const char *commands[] = {"CREATE ", "RESERVE ", "SHOW "};
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+      size_t name_len = strlen(commands[i]);
+      if ((size_t)(next - line) > name_len && strncmp(line, commands[i], name_len) == 0) {
+        id = line + name_len;
+      }
+    }
+
+    if (id != NULL && isdigit((unsigned char)*id)) {
+      char *id_end;
+      unsigned long event_id = strtoul(id, &id_end, 10);
+      if (event_id >= EVENT_ID_STRIDE) {
+        fclose(out);
+        return -1;
+      }
+      fprintf(out, "%.*s%lu%.*s", (int)(id - line), line, base + event_id, (int)(next - id_end), id_end);
+    } else {
+      fwrite(line, 1, (size_t)(next - line), out);
+    }
+    line = next;
+  }
+
+  int fd = fileno(out) < 0 || fflush(out) ? -1 : dup(fileno(out));
+  fclose(out);
+  if (fd != -1 && lseek(fd, 0, SEEK_SET) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/// Checks if a job lists the events, whose output then holds the events of every run so far.
+/// @param job Job to check.
+/// @param job_len Length of the job.
+/// @return 1 if it has a LIST command, 0 otherwise.
+static int lists_events(const char *job, size_t job_len) {
+  for (const char *line = job, *end = job + job_len; line < end;) {
+    if ((size_t)(end - line) >= 4 && strncmp(line, "LIST", 4) == 0) {
+      return 1;
+    }
+    const char *next = memchr(line, '\n', (size_t)(end - line));
+    line = next != NULL ? next + 1 : end;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s <server pipe path | unix:socket path> <runs> <.jobs file path>...\n", argv[0]);
+    return 1;
+  }
+
+  unsigned long runs = strtoul(argv[2], NULL, 10);
+  if (runs == 0 || runs * (unsigned long)(argc - 3) > UINT16_MAX / 2) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout and the jobs may hold invalid commands, keep both for the results
+  int results_fd = dup(STDOUT_FILENO);
+  int errors_fd = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || errors_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0 ||
+      dup2(null_fd, STDERR_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  if (bench_setup_session(argv[1], "ems-bench")) {
+    dprintf(errors_fd, "Failed to set up session\n");
+    return 1;
+  }
+
+  // Each run of each job gets events of its own. Runs alternate between both ways of running a job, so the event
+  // lookups of both walk the same distance.
+  unsigned int base = (unsigned int)getpid() << 16;
+  dprintf(results_fd, "job,commands,runs,interactive_commands_per_sec,server_commands_per_sec\n");
+  for (int i = 3; i < argc; i++) {
+    size_t job_len, num_commands = 0;
+    char *job = read_file(argv[i], &job_len);
+    if (job == NULL) {
+      dprintf(errors_fd, "Failed to read job. Path: %s\n", argv[i]);
+      return 1;
+    }
+    int lists = lists_events(job, job_len);
+
+    long long elapsed[2] = {0, 0};
+    for (unsigned long run = 0; run < runs; run++) {
+      int out_fds[2];
+      for (int on_server = 0; on_server < 2; on_server++) {
+        int in_fd = rebase_job(job, job_len, base, &num_commands);
+        FILE *out = tmpfile();
+        out_fds[on_server] = out != NULL ? dup(fileno(out)) : -1;
+        if (out != NULL) {
+          fclose(out);
+        }
+        base += EVENT_ID_STRIDE;
+        if (in_fd == -1 || out_fds[on_server] == -1) {
+          dprintf(errors_fd, "Failed to set up job. Path: %s\n", argv[i]);
+          return 1;
+        }
+
+        long long start = clock_now_ns();
+        int failed = on_server ? ems_run_job(in_fd, out_fds[on_server]) : run_job(in_fd, out_fds[on_server]);
+        elapsed[on_server] += clock_now_ns() - start;
+        close(in_fd);
+        if (failed) {
+          dprintf(errors_fd, "Failed to run job. Path: %s\n", argv[i]);
+          return 1;
+        }
+      }
+
+      // Both ways must give the same output, unless the job lists the events, each way having events of its own
+      int differ = !lists && bench_same_output(out_fds[0], out_fds[1]);
+      close(out_fds[0]);
+      close(out_fds[1]);
+      if (differ) {
+        dprintf(errors_fd, "Job gave different outputs. Path: %s\n", argv[i]);
+        return 1;
+      }
+    }
+
+    double total_commands = (double)num_commands * (double)runs;
+    dprintf(results_fd, "%s,%zu,%lu,%.0f,%.0f\n", argv[i], num_commands, runs,
+            total_commands * 1e9 / (double)elapsed[0], total_commands * 1e9 / (double)elapsed[1]);
+    free(job);
+  }
+
+  ems_quit();
+  close(null_fd);
+  close(errors_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+#define VENUE_COLS 1000  // Columns of the venues, the rows grow with the size of the reservations
+
+/// Checks that a venue was fully reserved by a single reservation.
+/// @return 0 if it was, 1 otherwise.
+static int check_venue(unsigned int event_id, size_t num_seats) {
+  FILE *out = tmpfile();
+  if (out == NULL || ems_show(fileno(out), event_id)) {
+    return 1;
+  }
+
+  rewind(out);
+  size_t reserved = 0;
+  unsigned int id;
+  while (fscanf(out, "%u", &id) == 1) {
+    reserved += id == 1;
+  }
+  fclose(out);
+  return reserved != num_seats;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <server pipe path | unix:socket path> <seats per reservation> <reservations>\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t num_seats = strtoul(argv[2], NULL, 10);
+  unsigned long reservations = strtoul(argv[3], NULL, 10);
+  if (num_seats == 0 || num_seats % VENUE_COLS != 0 || reservations == 0 || reservations > UINT16_MAX / 2) {
+    fprintf(stderr, "Invalid arguments, the seats must be a multiple of %d\n", VENUE_COLS);
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  size_t *xs = malloc(sizeof(size_t) * num_seats), *ys = malloc(sizeof(size_t) * num_seats);
+  if (xs == NULL || ys == NULL) {
+    fprintf(stderr, "Failed to allocate memory\n");
+    return 1;
+  }
+  for (size_t i = 0; i < num_seats; i++) {
+    xs[i] = i / VENUE_COLS + 1;
+    ys[i] = i % VENUE_COLS + 1;
+  }
+
+  // Every reservation takes a whole venue of its own. The venues of both encodings alternate, so their lookups walk
+  // the same distance.
+  size_t num_rows = num_seats / VENUE_COLS;
+  unsigned int first_event_id = (unsigned int)getpid() << 16;
+  if (bench_setup_session(argv[1], "ems-bench")) {
+    fprintf(stderr, "Failed to set up session\n");
+    return 1;
+  }
+  for (unsigned int i = 0; i < 2 * reservations; i++) {
+    if (ems_create(first_event_id + i, num_rows, VENUE_COLS)) {
+      fprintf(stderr, "Failed to create event\n");
+      return 1;
+    }
+  }
+  ems_quit();
+
+  dprintf(results_fd, "wire,seats,chunks,reservations,ms_per_reservation,seats_per_sec\n");
+  const char versions[] = {WIRE_VERSION_NATIVE, WIRE_VERSION_COMPACT};
+  for (size_t v = 0; v < sizeof(versions); v++) {
+    ems_set_wire_version(versions[v]);
+    if (bench_setup_session(argv[1], "ems-bench")) {
+      fprintf(stderr, "Failed to set up session\n");
+      return 1;
+    }
+
+    long long start = clock_now_ns();
+    for (unsigned long i = 0; i < reservations; i++) {
+      if (ems_reserve(first_event_id + (unsigned int)(2 * i + v), num_seats, xs, ys)) {
+        fprintf(stderr, "Failed to reserve seats\n");
+        return 1;
+      }
+    }
+    long long elapsed = clock_now_ns() - start;
+
+    // Each reservation must have been applied as a whole
+    for (unsigned long i = 0; i < reservations; i++) {
+      if (check_venue(first_event_id + (unsigned int)(2 * i + v), num_seats)) {
+        fprintf(stderr, "Reservation was not applied as a whole\n");
+        return 1;
+      }
+    }
+    ems_quit();
+
+    size_t chunks = (num_seats + RESERVATION_CHUNK_SIZE - 1) / RESERVATION_CHUNK_SIZE;
+    dprintf(results_fd, "%s,%zu,%zu,%lu,%.2f,%.0f\n", versions[v] == WIRE_VERSION_COMPACT ? "compact" : "native",
+            num_seats, chunks, reservations, (double)elapsed / 1e6 / (double)reservations,
+            (double)num_seats * (double)reservations * 1e9 / (double)elapsed);
+  }
+
+  free(xs);
+  free(ys);
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 4 || argc > 5) {
+    fprintf(stderr, "Usage: %s <server pipe path | unix:socket path> <events> <lists per client> [clients]\n",
+            argv[0]);
+    return 1;
+  }
+
+  unsigned int num_events = (unsigned int)strtoul(argv[2], NULL, 10);
+  unsigned long lists = strtoul(argv[3], NULL, 10);
+  unsigned long clients = argc == 5 ? strtoul(argv[4], NULL, 10) : 1;
+  if (lists == 0 || clients == 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  // Events already on the server from an earlier run fail to be created and are listed all the same
+  if (bench_setup_session(argv[1], "ems-bench")) {
+    fprintf(stderr, "Failed to set up session\n");
+    return 1;
+  }
+  for (unsigned int id = 1; id <= num_events; id++) {
+    ems_create(id, 1, 1);
+  }
+  ems_quit();
+
+  long long start = clock_now_ns();
+  for (unsigned long i = 0; i < clients; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to create client process\n");
+      return 1;
+    }
+    if (pid == 0) {
+      if (bench_setup_session(argv[1], "ems-bench")) {
+        exit(1);
+      }
+      for (unsigned long j = 0; j < lists; j++) {
+        if (ems_list_events(null_fd)) {
+          exit(1);
+        }
+      }
+      exit(ems_quit());
+    }
+  }
+
+  int failed = 0, status;
+  while (wait(&status) > 0) {
+    failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  long long elapsed = clock_now_ns() - start;
+
+  if (failed > 0) {
+    fprintf(stderr, "%d of %lu clients failed\n", failed, clients);
+    return 1;
+  }
+
+  unsigned long total = clients * lists;
+  dprintf(results_fd, "transport,events,clients,lists,list_us,lists_per_sec\n");
+  dprintf(results_fd, "%s,%u,%lu,%lu,%.2f,%.1f\n", socket_address_path(argv[1]) != NULL ? "socket" : "fifo",
+          num_events, clients, total, (double)elapsed / 1e3 / (double)total, (double)total * 1e9 / (double)elapsed);
+
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
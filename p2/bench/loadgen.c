@@ -0,0 +1,337 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/perf.h"
+#include "bench/session.h"
+#include "bench/util.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+#define LOADGEN_USAGE                                                                                           \
+  "[-c sessions] [-n ops per session] [-m create:reserve:show:list] [-r ops/s per session, 0 for closed loop] " \
+  "[-e events] [-v rows]x[cols] [-k seats per reservation] [-S seed] [-s] [-p server pid] "                    \
+  "<server pipe path | unix:socket path>"
+
+// Ops a session picks from
+enum LoadOp { LOAD_CREATE, LOAD_RESERVE, LOAD_SHOW, LOAD_LIST, NUM_LOAD_OPS };
+
+static const char *op_names[NUM_LOAD_OPS] = {"create", "reserve", "show", "list"};
+
+// How the sessions load the server
+struct LoadConfig {
+  const char *address;
+  unsigned long sessions;
+  unsigned long ops;  // Per session
+  unsigned int weights[NUM_LOAD_OPS];
+  double rate;  // Arrivals per second of each session, open loop. Closed loop when 0
+  unsigned int num_events;
+  size_t num_rows, num_cols;
+  size_t seats;  // Per reservation
+  unsigned long long seed;
+  unsigned int first_event_id;
+  int server_stats;  // Whether to print the latencies measured by the server after the run
+  pid_t server_pid;  // Server whose threads are counted during the run, 0 for none
+};
+
+// Latency of a single op, from when it was due to when its response arrived
+struct LoadSample {
+  long long latency_ns;
+  int op;
+};
+
+// What a session reports, followed by the samples of its ops
+struct SessionReport {
+  long long start_ns, end_ns;
+};
+
+/// Runs the ops of a session and writes its report, at the place of the session in the results file.
+/// @param config Load to put on the server.
+/// @param session Index of the session.
+/// @param results_fd File descriptor of the results file.
+/// @param null_fd File descriptor the output of SHOW and LIST is thrown to.
+/// @return 0 if successful, 1 otherwise.
+static int run_session(const struct LoadConfig *config, unsigned long session, int results_fd, int null_fd) {
+  struct SessionReport report;
+  struct LoadSample *samples = calloc(config->ops, sizeof(struct LoadSample));
+  size_t *xs = malloc(sizeof(size_t) * config->seats), *ys = malloc(sizeof(size_t) * config->seats);
+  if (samples == NULL || xs == NULL || ys == NULL || bench_setup_session(config->address, "ems-loadgen")) {
+    return 1;
+  }
+
+  unsigned int total_weight = 0;
+  for (int op = 0; op < NUM_LOAD_OPS; op++) {
+    total_weight += config->weights[op];
+  }
+
+  // Events created by a session get ids of their own, past the ones every session shares
+  unsigned long long random = config->seed + session * 0x9E3779B97F4A7C15ULL;
+  random = random != 0 ? random : 1;
+  unsigned int next_event_id = config->first_event_id + config->num_events + (unsigned int)(session * config->ops);
+
+  report.start_ns = clock_now_ns();
+  long long due_ns = report.start_ns;
+  for (unsigned long i = 0; i < config->ops; i++) {
+    // Open loop arrivals are a Poisson process, and an op that's late still counts from when it was due
+    long long start_ns;
+    if (config->rate > 0) {
+      due_ns += (long long)(-log(1.0 - next_uniform(&random)) / config->rate * 1e9);
+      clock_sleep_until(due_ns);
+      start_ns = due_ns;
+    } else {
+      start_ns = clock_now_ns();
+    }
+
+    unsigned int pick = (unsigned int)(next_random(&random) % total_weight);
+    int op = 0;
+    while (pick >= config->weights[op]) {
+      pick -= config->weights[op++];
+    }
+    unsigned int event_id = config->first_event_id + (unsigned int)(next_random(&random) % config->num_events);
+
+    int failed = 0;
+    switch (op) {
+      case LOAD_CREATE:
+        failed = ems_create(next_event_id++, config->num_rows, config->num_cols);
+        break;
+      case LOAD_RESERVE:
+        for (size_t seat = 0; seat < config->seats; seat++) {
+          xs[seat] = next_random(&random) % config->num_rows + 1;
+          ys[seat] = next_random(&random) % config->num_cols + 1;
+        }
+        failed = ems_reserve(event_id, config->seats, xs, ys);
+        break;
+      case LOAD_SHOW:
+        failed = ems_show(null_fd, event_id);
+        break;
+      default:
+        failed = ems_list_events(null_fd);
+        break;
+    }
+
+    // Refused ops are answered like any other, only a broken session fails one
+    if (failed) {
+      return 1;
+    }
+    samples[i].latency_ns = clock_now_ns() - start_ns;
+    samples[i].op = op;
+  }
+  report.end_ns = clock_now_ns();
+
+  // Every session has a place of its own in the results file, so they never write over each other
+  size_t samples_len = sizeof(struct LoadSample) * config->ops;
+  off_t offset = (off_t)(session * (sizeof(struct SessionReport) + samples_len));
+  int result = pwrite(results_fd, &report, sizeof(report), offset) != (ssize_t)sizeof(report) ||
+               pwrite(results_fd, samples, samples_len, offset + (off_t)sizeof(report)) != (ssize_t)samples_len;
+
+  free(samples);
+  free(xs);
+  free(ys);
+  return result || ems_quit();
+}
+
+int main(int argc, char *argv[]) {
+  struct LoadConfig config = {NULL, 4, 1000, {5, 45, 40, 10}, 0, 16, 20, 20, 2, 1, 0, 0, 0};
+  unsigned long value;
+  int option, invalid = 0;
+  while ((option = getopt(argc, argv, "c:n:m:r:e:v:k:S:sp:")) != -1) {
+    switch (option) {
+      case 'c':
+        invalid |= parse_number(optarg, &config.sessions) || config.sessions == 0;
+        break;
+      case 'n':
+        invalid |= parse_number(optarg, &config.ops) || config.ops == 0;
+        break;
+      case 'm':
+        invalid |= sscanf(optarg, "%u:%u:%u:%u", &config.weights[LOAD_CREATE], &config.weights[LOAD_RESERVE],
+                          &config.weights[LOAD_SHOW], &config.weights[LOAD_LIST]) != NUM_LOAD_OPS;
+        break;
+      case 'r':
+        config.rate = strtod(optarg, NULL);
+        invalid |= config.rate < 0;
+        break;
+      case 'e':
+        invalid |= parse_number(optarg, &value) || value == 0 || value > UINT16_MAX;
+        config.num_events = (unsigned int)value;
+        break;
+      case 'v':
+        invalid |= sscanf(optarg, "%zux%zu", &config.num_rows, &config.num_cols) != 2 || config.num_rows == 0 ||
+                   config.num_cols == 0;
+        break;
+      case 'k':
+        invalid |= parse_number(optarg, &value) || value == 0;
+        config.seats = value;
+        break;
+      case 'S':
+        invalid |= parse_number(optarg, &value);
+        config.seed = value;
+        break;
+      case 's':
+        config.server_stats = 1;
+        break;
+      case 'p':
+        invalid |= parse_number(optarg, &value) || value == 0;
+        config.server_pid = (pid_t)value;
+        break;
+      default:
+        invalid = 1;
+        break;
+    }
+  }
+  if (invalid || optind != argc - 1) {
+    fprintf(stderr, "Usage: %s %s\n", argv[0], LOADGEN_USAGE);
+    return 1;
+  }
+  config.address = argv[optind];
+
+  unsigned int total_weight = 0;
+  for (int op = 0; op < NUM_LOAD_OPS; op++) {
+    total_weight += config.weights[op];
+  }
+  if (total_weight == 0 || (config.weights[LOAD_CREATE] > 0 &&
+                            config.sessions * config.ops > UINT16_MAX - config.num_events)) {
+    fprintf(stderr, "Invalid op mix, or too many ops to give each created event an id of its own\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  FILE *reports = tmpfile();
+  if (results_fd < 0 || null_fd < 0 || reports == NULL || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the load generator\n");
+    return 1;
+  }
+
+  // The events the sessions share are created up front
+  config.first_event_id = (unsigned int)getpid() << 16;
+  if (bench_setup_session(config.address, "ems-loadgen")) {
+    fprintf(stderr, "Failed to set up session\n");
+    return 1;
+  }
+  for (unsigned int i = 0; i < config.num_events; i++) {
+    if (ems_create(config.first_event_id + i, config.num_rows, config.num_cols)) {
+      fprintf(stderr, "Failed to create event\n");
+      return 1;
+    }
+  }
+  ems_quit();
+
+  // Server threads are counted from the first session to the last, so the counts include setting the sessions up
+  struct PerfCounters counters = {NULL, 0};
+  if (config.server_pid != 0 && perf_counters_open_process(&counters, config.server_pid) != 0) {
+    fprintf(stderr, "Failed to count the server threads\n");
+    return 1;
+  }
+  perf_counters_start(&counters);
+
+  // Every session is a process of its own, as the client API holds a single session per process
+  for (unsigned long i = 0; i < config.sessions; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to create session process\n");
+      return 1;
+    }
+    if (pid == 0) {
+      exit(run_session(&config, i, fileno(reports), null_fd));
+    }
+  }
+
+  int failed = 0, status;
+  while (wait(&status) > 0) {
+    failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  struct PerfCounts server_counts;
+  perf_counters_stop(&counters, &server_counts);
+  perf_counters_close(&counters);
+  if (failed > 0) {
+    fprintf(stderr, "%d of %lu sessions failed\n", failed, config.sessions);
+    return 1;
+  }
+
+  // Latencies of every op type, across sessions
+  size_t total_ops = config.sessions * config.ops;
+  struct LoadSample *samples = malloc(sizeof(struct LoadSample) * config.ops);
+  long long *latencies[NUM_LOAD_OPS + 1];
+  size_t counts[NUM_LOAD_OPS + 1] = {0};
+  double sums_us[NUM_LOAD_OPS + 1] = {0};
+  for (int op = 0; op <= NUM_LOAD_OPS; op++) {
+    latencies[op] = malloc(sizeof(long long) * total_ops);
+    if (latencies[op] == NULL) {
+      fprintf(stderr, "Failed to allocate memory\n");
+      return 1;
+    }
+  }
+  if (samples == NULL) {
+    fprintf(stderr, "Failed to allocate memory\n");
+    return 1;
+  }
+
+  long long first_start_ns = LLONG_MAX, last_end_ns = 0;
+  size_t samples_len = sizeof(struct LoadSample) * config.ops;
+  for (unsigned long i = 0; i < config.sessions; i++) {
+    struct SessionReport report;
+    off_t offset = (off_t)(i * (sizeof(struct SessionReport) + samples_len));
+    if (pread(fileno(reports), &report, sizeof(report), offset) != (ssize_t)sizeof(report) ||
+        pread(fileno(reports), samples, samples_len, offset + (off_t)sizeof(report)) != (ssize_t)samples_len) {
+      fprintf(stderr, "Failed to read the report of session %lu\n", i);
+      return 1;
+    }
+    first_start_ns = report.start_ns < first_start_ns ? report.start_ns : first_start_ns;
+    last_end_ns = report.end_ns > last_end_ns ? report.end_ns : last_end_ns;
+
+    for (unsigned long j = 0; j < config.ops; j++) {
+      int types[] = {samples[j].op, NUM_LOAD_OPS};
+      for (int t = 0; t < 2; t++) {
+        latencies[types[t]][counts[types[t]]++] = samples[j].latency_ns;
+        sums_us[types[t]] += (double)samples[j].latency_ns / 1e3;
+      }
+    }
+  }
+
+  // Throughput is taken over the time any session was running
+  double elapsed_s = (double)(last_end_ns - first_start_ns) / 1e9;
+  // Counters are those of the server threads, which can't be told apart by op type, so only the row of all ops has them
+  dprintf(results_fd,
+          "op,sessions,arrival,rate_per_session,ops,ops_per_sec,mean_us,p50_us,p99_us,p999_us," PERF_CSV_HEADER "\n");
+  for (int op = 0; op <= NUM_LOAD_OPS; op++) {
+    if (counts[op] == 0) {
+      continue;
+    }
+    sort_latencies(latencies[op], counts[op]);
+    dprintf(results_fd, "%s,%lu,%s,%.0f,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,",
+            op < NUM_LOAD_OPS ? op_names[op] : "all", config.sessions, config.rate > 0 ? "open" : "closed",
+            config.rate, counts[op], (double)counts[op] / elapsed_s, sums_us[op] / (double)counts[op],
+            (double)percentile_ns(latencies[op], counts[op], 0.5) / 1e3,
+            (double)percentile_ns(latencies[op], counts[op], 0.99) / 1e3,
+            (double)percentile_ns(latencies[op], counts[op], 0.999) / 1e3);
+    perf_counts_print(results_fd, op == NUM_LOAD_OPS ? &server_counts : NULL, counts[op]);
+    dprintf(results_fd, "\n");
+  }
+
+  // The server counts from when it started, so its latencies only match the run on a fresh server
+  if (config.server_stats) {
+    dprintf(results_fd, "\n");
+    if (bench_setup_session(config.address, "ems-loadgen") || ems_stats(results_fd) || ems_quit()) {
+      fprintf(stderr, "Failed to get the server stats\n");
+      return 1;
+    }
+  }
+
+  for (int op = 0; op <= NUM_LOAD_OPS; op++) {
+    free(latencies[op]);
+  }
+  free(samples);
+  fclose(reports);
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
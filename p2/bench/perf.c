@@ -0,0 +1,167 @@
+#define _GNU_SOURCE  // syscall
+#include "perf.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} perf_events[NUM_PERF_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},     {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},   {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+/// Opens a stopped counter of an event.
+/// @param event Event to count.
+/// @param tid Thread to count, 0 for the calling one.
+/// @return File descriptor of the counter, -1 if the event can't be counted.
+static int open_counter(enum PerfEvent event, pid_t tid) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = perf_events[event].type;
+  attr.config = perf_events[event].config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // The kernel is left out when perf_event_paranoid only allows counting user space
+  int fd = (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+  if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+    attr.exclude_kernel = 1;
+    fd = (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+  }
+  return fd;
+}
+
+/// Opens the counters of a thread.
+/// @param counters Counters to add the thread to, with room for it.
+/// @param tid Thread to count, 0 for the calling one.
+static void add_thread(struct PerfCounters *counters, pid_t tid) {
+  int *fds = &counters->fds[counters->num_threads * NUM_PERF_EVENTS];
+  for (int event = 0; event < NUM_PERF_EVENTS; event++) {
+    fds[event] = open_counter((enum PerfEvent)event, tid);
+  }
+  counters->num_threads++;
+}
+
+int perf_counters_open_self(struct PerfCounters *counters) {
+  counters->num_threads = 0;
+  counters->fds = malloc(sizeof(int) * NUM_PERF_EVENTS);
+  if (counters->fds == NULL) {
+    return 1;
+  }
+  add_thread(counters, 0);
+  return 0;
+}
+
+int perf_counters_open_process(struct PerfCounters *counters, pid_t pid) {
+  counters->num_threads = 0;
+  counters->fds = NULL;
+
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+  DIR *tasks = opendir(path);
+  if (tasks == NULL) {
+    perror("Failed to list the threads to count");
+    return 1;
+  }
+
+  // Threads started after this aren't counted, unless created by a counted one
+  size_t capacity = 0;
+  struct dirent *task;
+  while ((task = readdir(tasks)) != NULL) {
+    pid_t tid = (pid_t)strtol(task->d_name, NULL, 10);
+    if (tid <= 0) {
+      continue;
+    }
+    if (counters->num_threads == capacity) {
+      capacity = capacity > 0 ? capacity * 2 : 16;
+      int *fds = realloc(counters->fds, sizeof(int) * NUM_PERF_EVENTS * capacity);
+      if (fds == NULL) {
+        closedir(tasks);
+        perf_counters_close(counters);
+        return 1;
+      }
+      counters->fds = fds;
+    }
+    add_thread(counters, tid);
+  }
+  closedir(tasks);
+  return 0;
+}
+
+void perf_counters_start(struct PerfCounters *counters) {
+  for (size_t i = 0; i < counters->num_threads * NUM_PERF_EVENTS; i++) {
+    if (counters->fds[i] != -1) {
+      ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_counters_stop(struct PerfCounters *counters, struct PerfCounts *counts) {
+  for (size_t i = 0; i < counters->num_threads * NUM_PERF_EVENTS; i++) {
+    if (counters->fds[i] != -1) {
+      ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  memset(counts, 0, sizeof(struct PerfCounts));
+  for (size_t i = 0; i < counters->num_threads * NUM_PERF_EVENTS; i++) {
+    // [ value ] | [ time enabled ] | [ time running ], the value being scaled up to the time enabled
+    uint64_t read_values[3];
+    if (counters->fds[i] == -1 || read(counters->fds[i], read_values, sizeof(read_values)) != sizeof(read_values) ||
+        read_values[2] == 0) {
+      continue;
+    }
+    int event = (int)(i % NUM_PERF_EVENTS);
+    counts->values[event] += (double)read_values[0] * ((double)read_values[1] / (double)read_values[2]);
+    counts->counted[event] = 1;
+  }
+}
+
+void perf_counters_close(struct PerfCounters *counters) {
+  for (size_t i = 0; i < counters->num_threads * NUM_PERF_EVENTS; i++) {
+    if (counters->fds[i] != -1) {
+      close(counters->fds[i]);
+    }
+  }
+  free(counters->fds);
+  counters->fds = NULL;
+  counters->num_threads = 0;
+}
+
+void perf_counts_print(int fd, const struct PerfCounts *counts, size_t ops) {
+  // Events per op, then instructions per cycle, then context switches in all
+  int per_op[] = {PERF_CYCLES, PERF_INSTRUCTIONS, -1, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, PERF_CONTEXT_SWITCHES};
+  for (size_t i = 0; i < sizeof(per_op) / sizeof(per_op[0]); i++) {
+    const char *separator = i > 0 ? "," : "";
+    int event = per_op[i];
+    if (event == -1) {
+      if (counts != NULL && counts->counted[PERF_CYCLES] && counts->counted[PERF_INSTRUCTIONS] &&
+          counts->values[PERF_CYCLES] > 0) {
+        dprintf(fd, "%s%.2f", separator, counts->values[PERF_INSTRUCTIONS] / counts->values[PERF_CYCLES]);
+      } else {
+        dprintf(fd, "%s", separator);
+      }
+    } else if (counts == NULL || !counts->counted[event]) {
+      dprintf(fd, "%s", separator);
+    } else if (event == PERF_CONTEXT_SWITCHES) {
+      dprintf(fd, "%s%.0f", separator, counts->values[event]);
+    } else {
+      dprintf(fd, "%s%.1f", separator, ops > 0 ? counts->values[event] / (double)ops : 0);
+    }
+  }
+}
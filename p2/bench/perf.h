@@ -0,0 +1,64 @@
+#ifndef BENCH_PERF_H
+#define BENCH_PERF_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Events counted around a phase of a benchmark
+enum PerfEvent {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_CONTEXT_SWITCHES,
+  NUM_PERF_EVENTS
+};
+
+// CSV fields printed by perf_counts_print, empty for the events that couldn't be counted
+#define PERF_CSV_HEADER \
+  "cycles_per_op,instructions_per_op,ipc,cache_misses_per_op,branch_misses_per_op,context_switches"
+
+// Counters of the threads of a process. Every event is opened on its own, so the ones the kernel or the machine
+// won't count (no PMU in a VM, perf_event_paranoid) are left out while the others still are.
+struct PerfCounters {
+  int *fds;  // NUM_PERF_EVENTS per thread, -1 for the events left out
+  size_t num_threads;
+};
+
+// Counts of a phase, scaled up when the kernel multiplexed the counters
+struct PerfCounts {
+  double values[NUM_PERF_EVENTS];
+  int counted[NUM_PERF_EVENTS];  // Whether the event was counted at all
+};
+
+/// Opens stopped counters for the calling thread and every thread it creates from then on.
+/// @param counters Counters to open.
+/// @return 0 if successful, even when no event can be counted, 1 otherwise.
+int perf_counters_open_self(struct PerfCounters *counters);
+
+/// Opens stopped counters for every thread a process has.
+/// @param counters Counters to open.
+/// @param pid Process to count.
+/// @return 0 if successful, even when no event can be counted, 1 otherwise.
+int perf_counters_open_process(struct PerfCounters *counters, pid_t pid);
+
+/// Resets the counters and starts counting.
+/// @param counters Counters to start.
+void perf_counters_start(struct PerfCounters *counters);
+
+/// Stops counting and reads the counts since the counters were started, summed over the threads.
+/// @param counters Counters to stop.
+/// @param counts Variable to store the counts in.
+void perf_counters_stop(struct PerfCounters *counters, struct PerfCounts *counts);
+
+/// Closes the counters.
+/// @param counters Counters to close.
+void perf_counters_close(struct PerfCounters *counters);
+
+/// Prints counts per op as the CSV fields of PERF_CSV_HEADER, without a leading or trailing separator.
+/// @param fd File descriptor to print to.
+/// @param counts Counts of the phase, NULL to print empty fields.
+/// @param ops Ops done in the phase.
+void perf_counts_print(int fd, const struct PerfCounts *counts, size_t ops);
+
+#endif  // BENCH_PERF_H
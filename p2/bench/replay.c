@@ -0,0 +1,500 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/perf.h"
+#include "bench/util.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "server/recorder.h"
+
+#define REPLAY_USAGE \
+  "[-t] [-c concurrent sessions] [-p server pid] <trace path> <server pipe path | unix:socket path>"
+
+// Requests replayed, in the order their results are printed
+enum ReplayOp {
+  REPLAY_SETUP,
+  REPLAY_CREATE,
+  REPLAY_RESERVE,
+  REPLAY_RESERVE_RANGES,
+  REPLAY_SHOW,
+  REPLAY_SHOW_SINCE,
+  REPLAY_LIST,
+  REPLAY_RUN_JOB,
+  NUM_REPLAY_OPS
+};
+
+static const char op_codes[NUM_REPLAY_OPS] = {
+    OP_CODE_SETUP_REQUEST,     OP_CODE_CREATE_REQUEST,     OP_CODE_RESERVE_REQUEST, OP_CODE_RESERVE_RANGES_REQUEST,
+    OP_CODE_SHOW_REQUEST,      OP_CODE_SHOW_SINCE_REQUEST, OP_CODE_LIST_REQUEST,    OP_CODE_RUN_JOB_REQUEST};
+
+static const char *op_names[NUM_REPLAY_OPS] = {"setup", "create",     "reserve", "reserve_ranges",
+                                               "show",  "show_since", "list",    "run_job"};
+
+// A request of the trace
+struct TraceRecord {
+  int op;
+  unsigned int connection;
+  long long time_ns;
+  const char *payload;  // Within the mapped trace, not aligned
+  size_t payload_len;
+};
+
+// A recorded session, whose records are replayed in order through a session of its own
+struct TraceSession {
+  size_t first;  // Position of its first record in the records of every session
+  size_t num_records;
+};
+
+// The trace being replayed
+struct Replay {
+  const char *address;
+  int timed;  // Whether requests keep their original times, instead of following each other as fast as possible
+  struct TraceRecord *records;  // Grouped by session, each in the order it was recorded
+  size_t num_records;
+  struct TraceSession *sessions;  // By order of connection
+  size_t num_sessions;
+  long long first_time_ns;  // Time of the earliest record
+  long long start_ns;       // When the replay started, standing for the earliest record
+};
+
+// Latency of a single request, from when it was due to when its response arrived
+struct ReplaySample {
+  long long latency_ns;
+  int op;
+  int failed;  // Whether the request failed or the server refused it
+};
+
+// What a session reports, its samples being kept apart
+struct SessionReport {
+  long long start_ns, end_ns;
+};
+
+/// Reads the records of a trace, grouping them by session. A record cut short at the end of the trace ends it.
+/// @param trace Mapped trace.
+/// @param trace_len Length of the trace.
+/// @param replay Replay to store the records and sessions in.
+/// @return 0 if successful, 1 otherwise.
+static int read_trace(const char *trace, size_t trace_len, struct Replay *replay) {
+  if (trace_len < TRACE_MAGIC_LEN || memcmp(trace, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0) {
+    fprintf(stderr, "Not a trace\n");
+    return 1;
+  }
+
+  // Records in the order they were recorded, and how many each connection has
+  size_t capacity = 1024, num_records = 0;
+  unsigned int max_connection = 0;
+  struct TraceRecord *recorded = malloc(sizeof(struct TraceRecord) * capacity);
+  if (recorded == NULL) {
+    return 1;
+  }
+  for (size_t offset = TRACE_MAGIC_LEN; offset + TRACE_HEADER_LEN <= trace_len;) {
+    char op_code;
+    uint32_t connection, payload_len;
+    uint64_t time_ns;
+    memcpy(&op_code, trace + offset, sizeof(char));
+    memcpy(&connection, trace + offset + sizeof(char), sizeof(uint32_t));
+    memcpy(&time_ns, trace + offset + sizeof(char) + sizeof(uint32_t), sizeof(uint64_t));
+    memcpy(&payload_len, trace + offset + sizeof(char) + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint32_t));
+    if (payload_len > trace_len - offset - TRACE_HEADER_LEN) {
+      break;  // Cut short
+    }
+
+    int op = 0;
+    while (op < NUM_REPLAY_OPS && op_codes[op] != op_code) {
+      op++;
+    }
+    if (op < NUM_REPLAY_OPS && connection > 0) {
+      if (num_records == capacity) {
+        capacity *= 2;
+        struct TraceRecord *temp = realloc(recorded, sizeof(struct TraceRecord) * capacity);
+        if (temp == NULL) {
+          free(recorded);
+          return 1;
+        }
+        recorded = temp;
+      }
+      recorded[num_records++] = (struct TraceRecord){op, connection, (long long)time_ns,
+                                                     trace + offset + TRACE_HEADER_LEN, payload_len};
+      max_connection = connection > max_connection ? connection : max_connection;
+    }
+    offset += TRACE_HEADER_LEN + payload_len;
+  }
+
+  // Connections are numbered from 1 as sessions are set up, so they index the sessions directly
+  replay->records = malloc(sizeof(struct TraceRecord) * (num_records > 0 ? num_records : 1));
+  replay->sessions = calloc(max_connection > 0 ? max_connection : 1, sizeof(struct TraceSession));
+  if (replay->records == NULL || replay->sessions == NULL) {
+    free(recorded);
+    return 1;
+  }
+  for (size_t i = 0; i < num_records; i++) {
+    replay->sessions[recorded[i].connection - 1].num_records++;
+  }
+  for (unsigned int i = 1; i < max_connection; i++) {
+    replay->sessions[i].first = replay->sessions[i - 1].first + replay->sessions[i - 1].num_records;
+  }
+  size_t *filled = calloc(max_connection > 0 ? max_connection : 1, sizeof(size_t));
+  if (filled == NULL) {
+    free(recorded);
+    return 1;
+  }
+  for (size_t i = 0; i < num_records; i++) {
+    struct TraceSession *session = &replay->sessions[recorded[i].connection - 1];
+    replay->records[session->first + filled[recorded[i].connection - 1]++] = recorded[i];
+  }
+
+  replay->num_records = num_records;
+  replay->num_sessions = max_connection;
+  replay->first_time_ns = num_records > 0 ? recorded[0].time_ns : 0;
+  free(filled);
+  free(recorded);
+  return 0;
+}
+
+/// Grows a buffer to a length.
+/// @param buffer Buffer to grow.
+/// @param capacity Bytes the buffer has room for.
+/// @param len Bytes it must have room for.
+/// @return 0 if successful, 1 otherwise.
+static int grow_buffer(void **buffer, size_t *capacity, size_t len) {
+  if (len <= *capacity) {
+    return 0;
+  }
+  void *temp = realloc(*buffer, len);
+  if (temp == NULL) {
+    return 1;
+  }
+  *buffer = temp;
+  *capacity = len;
+  return 0;
+}
+
+/// Sends a recorded request, other than a setup, through the session.
+/// @param record Request to send.
+/// @param null_fd File descriptor the output of SHOW, LIST and jobs is thrown to.
+/// @param job_fd File to write job scripts to.
+/// @param buffer Buffer for the arguments of the request, grown to fit them.
+/// @param capacity Bytes the buffer has room for.
+/// @return 0 if successful, 1 otherwise.
+static int send_record(const struct TraceRecord *record, int null_fd, int job_fd, void **buffer, size_t *capacity) {
+  unsigned int event_id = 0;
+  if (record->payload_len >= sizeof(unsigned int)) {
+    memcpy(&event_id, record->payload, sizeof(unsigned int));
+  }
+  const char *args = record->payload + sizeof(unsigned int);
+  size_t count = 0;
+  if (record->payload_len >= sizeof(unsigned int) + sizeof(size_t)) {
+    memcpy(&count, args, sizeof(size_t));
+  }
+
+  // The payload is checked against its length before anything past the event id is used
+  switch (record->op) {
+    case REPLAY_CREATE: {
+      size_t dims[2];
+      if (record->payload_len != sizeof(unsigned int) + sizeof(dims)) {
+        return 1;
+      }
+      memcpy(dims, args, sizeof(dims));
+      return ems_create(event_id, dims[0], dims[1]);
+    }
+    case REPLAY_RESERVE: {
+      if (count > SIZE_MAX / (2 * sizeof(size_t)) - 1 ||
+          record->payload_len != sizeof(unsigned int) + sizeof(size_t) * (1 + 2 * count) ||
+          grow_buffer(buffer, capacity, 2 * sizeof(size_t) * count + 1)) {
+        return 1;
+      }
+      size_t *seats = *buffer;
+      memcpy(seats, args + sizeof(size_t), 2 * sizeof(size_t) * count);
+      return ems_reserve(event_id, count, seats, seats + count);
+    }
+    case REPLAY_RESERVE_RANGES:
+      if (count > SIZE_MAX / sizeof(seat_range_t) - 1 ||
+          record->payload_len != sizeof(unsigned int) + sizeof(size_t) + sizeof(seat_range_t) * count ||
+          grow_buffer(buffer, capacity, sizeof(seat_range_t) * count + 1)) {
+        return 1;
+      }
+      memcpy(*buffer, args + sizeof(size_t), sizeof(seat_range_t) * count);
+      return ems_reserve_ranges(event_id, count, *buffer);
+    case REPLAY_SHOW_SINCE:
+      // The session keeps its own copy of the seats, so it asks for the changes since the version it has, which
+      // is the one recorded as long as the sessions are replayed in the same order
+      if (record->payload_len != 2 * sizeof(unsigned int) + sizeof(char)) {
+        return 1;
+      }
+      ems_set_show_encodings(record->payload[2 * sizeof(unsigned int)]);
+      return ems_show(null_fd, event_id);
+    case REPLAY_SHOW:
+      return record->payload_len != sizeof(unsigned int) || ems_show(null_fd, event_id);
+    case REPLAY_LIST:
+      return ems_list_events(null_fd);
+    case REPLAY_RUN_JOB:
+      if (ftruncate(job_fd, 0) || lseek(job_fd, 0, SEEK_SET) != 0 ||
+          pwrite(job_fd, record->payload, record->payload_len, 0) != (ssize_t)record->payload_len) {
+        return 1;
+      }
+      return ems_run_job(job_fd, null_fd);
+    default:
+      return 1;
+  }
+}
+
+/// Replays the records of a session and writes its report and samples at their places in the results file.
+/// @param replay Trace being replayed.
+/// @param index Index of the session.
+/// @param results_fd File descriptor of the results file.
+/// @param null_fd File descriptor the output of SHOW, LIST and jobs is thrown to.
+/// @return 0 if successful, 1 otherwise.
+static int replay_session(const struct Replay *replay, size_t index, int results_fd, int null_fd) {
+  const struct TraceSession *session = &replay->sessions[index];
+  const struct TraceRecord *records = replay->records + session->first;
+
+  struct SessionReport report;
+  struct ReplaySample *samples = calloc(session->num_records, sizeof(struct ReplaySample));
+  FILE *job = tmpfile();
+  void *buffer = NULL;
+  size_t capacity = 0;
+  if (samples == NULL || job == NULL) {
+    return 1;
+  }
+
+  char req_pipe_path[CLIENT_PIPE_MAX_LEN], resp_pipe_path[CLIENT_PIPE_MAX_LEN];
+  snprintf(req_pipe_path, CLIENT_PIPE_MAX_LEN, "/tmp/ems-replay-req-%d", getpid());
+  snprintf(resp_pipe_path, CLIENT_PIPE_MAX_LEN, "/tmp/ems-replay-resp-%d", getpid());
+
+  report.start_ns = clock_now_ns();
+  // A refused request may well have been refused when it was recorded too, only a session that fails to be set up
+  // stops short
+  int failed = 0, set_up = 0;
+  for (size_t i = 0; i < session->num_records && !failed; i++) {
+    const struct TraceRecord *record = &records[i];
+
+    // With the original timing a request is due when it was recorded, and one that's late still counts from then
+    long long start_ns = clock_now_ns();
+    if (replay->timed) {
+      start_ns = replay->start_ns + record->time_ns - replay->first_time_ns;
+      clock_sleep_until(start_ns);
+    }
+
+    if (record->op == REPLAY_SETUP) {
+      if (set_up || record->payload_len != sizeof(char)) {
+        failed = 1;
+        break;
+      }
+      ems_set_wire_version(record->payload[0]);
+      failed = ems_setup(req_pipe_path, resp_pipe_path, replay->address);
+      set_up = !failed;
+    } else if (!set_up) {
+      failed = 1;
+      break;
+    } else {
+      samples[i].failed = send_record(record, null_fd, fileno(job), &buffer, &capacity);
+    }
+
+    samples[i].latency_ns = clock_now_ns() - start_ns;
+    samples[i].op = record->op;
+  }
+  report.end_ns = clock_now_ns();
+
+  // Reports come first in the results file, followed by the samples of every session in the order of the records
+  size_t samples_len = sizeof(struct ReplaySample) * session->num_records;
+  off_t samples_offset = (off_t)(sizeof(struct SessionReport) * replay->num_sessions +
+                                 sizeof(struct ReplaySample) * session->first);
+  failed = failed || pwrite(results_fd, &report, sizeof(report), (off_t)(sizeof(report) * index)) != sizeof(report) ||
+           pwrite(results_fd, samples, samples_len, samples_offset) != (ssize_t)samples_len;
+
+  free(samples);
+  free(buffer);
+  fclose(job);
+  return (set_up && ems_quit()) || failed;
+}
+
+int main(int argc, char *argv[]) {
+  struct Replay replay = {0};
+  unsigned long max_concurrent = MAX_SESSION_COUNT, server_pid = 0;
+  int option, invalid = 0;
+  while ((option = getopt(argc, argv, "tc:p:")) != -1) {
+    switch (option) {
+      case 't':
+        replay.timed = 1;
+        break;
+      case 'c': {
+        char *end;
+        max_concurrent = strtoul(optarg, &end, 10);
+        invalid |= *end != '\0' || end == optarg || max_concurrent == 0;
+        break;
+      }
+      case 'p': {
+        char *end;
+        server_pid = strtoul(optarg, &end, 10);
+        invalid |= *end != '\0' || end == optarg || server_pid == 0;
+        break;
+      }
+      default:
+        invalid = 1;
+        break;
+    }
+  }
+  if (invalid || optind != argc - 2) {
+    fprintf(stderr, "Usage: %s %s\n", argv[0], REPLAY_USAGE);
+    return 1;
+  }
+  replay.address = argv[optind + 1];
+
+  int trace_fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  if (trace_fd < 0 || fstat(trace_fd, &st) < 0 || st.st_size == 0) {
+    fprintf(stderr, "Failed to open the trace: %s\n", argv[optind]);
+    return 1;
+  }
+  size_t trace_len = (size_t)st.st_size;
+  char *trace = mmap(NULL, trace_len, PROT_READ, MAP_PRIVATE, trace_fd, 0);
+  if (trace == MAP_FAILED || read_trace(trace, trace_len, &replay)) {
+    fprintf(stderr, "Failed to read the trace: %s\n", argv[optind]);
+    return 1;
+  }
+  if (replay.num_records == 0) {
+    fprintf(stderr, "The trace has no requests\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  FILE *reports = tmpfile();
+  if (results_fd < 0 || null_fd < 0 || reports == NULL || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the replay\n");
+    return 1;
+  }
+
+  // Server threads are counted from the first session to the last
+  struct PerfCounters counters = {NULL, 0};
+  if (server_pid != 0 && perf_counters_open_process(&counters, (pid_t)server_pid) != 0) {
+    fprintf(stderr, "Failed to count the server threads\n");
+    return 1;
+  }
+  perf_counters_start(&counters);
+
+  // Sessions start in the order they were set up, at their original time when timed, and no more than the given
+  // number of them at once
+  replay.start_ns = clock_now_ns();
+  unsigned long running = 0;
+  int failed = 0, status;
+  for (size_t i = 0; i < replay.num_sessions; i++) {
+    const struct TraceSession *session = &replay.sessions[i];
+    if (session->num_records == 0) {
+      continue;
+    }
+    if (replay.timed) {
+      clock_sleep_until(replay.start_ns + replay.records[session->first].time_ns - replay.first_time_ns);
+    }
+    if (running == max_concurrent && wait(&status) > 0) {
+      failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+      running--;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to create session process\n");
+      return 1;
+    }
+    if (pid == 0) {
+      exit(replay_session(&replay, i, fileno(reports), null_fd));
+    }
+    running++;
+  }
+  while (wait(&status) > 0) {
+    failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  struct PerfCounts server_counts;
+  perf_counters_stop(&counters, &server_counts);
+  perf_counters_close(&counters);
+  if (failed > 0) {
+    fprintf(stderr, "%d of %zu sessions failed\n", failed, replay.num_sessions);
+    return 1;
+  }
+
+  // Latencies of every request type, across sessions
+  struct ReplaySample *samples = malloc(sizeof(struct ReplaySample) * replay.num_records);
+  long long *latencies[NUM_REPLAY_OPS + 1];
+  size_t counts[NUM_REPLAY_OPS + 1] = {0}, failures[NUM_REPLAY_OPS + 1] = {0};
+  double sums_us[NUM_REPLAY_OPS + 1] = {0};
+  for (int op = 0; op <= NUM_REPLAY_OPS; op++) {
+    latencies[op] = malloc(sizeof(long long) * replay.num_records);
+    if (latencies[op] == NULL) {
+      fprintf(stderr, "Failed to allocate memory\n");
+      return 1;
+    }
+  }
+  size_t samples_len = sizeof(struct ReplaySample) * replay.num_records;
+  off_t samples_offset = (off_t)(sizeof(struct SessionReport) * replay.num_sessions);
+  if (samples == NULL || pread(fileno(reports), samples, samples_len, samples_offset) != (ssize_t)samples_len) {
+    fprintf(stderr, "Failed to read the reports of the sessions\n");
+    return 1;
+  }
+
+  long long first_start_ns = LLONG_MAX, last_end_ns = 0;
+  size_t num_sessions = 0;
+  for (size_t i = 0; i < replay.num_sessions; i++) {
+    struct SessionReport report;
+    if (replay.sessions[i].num_records == 0) {
+      continue;
+    }
+    if (pread(fileno(reports), &report, sizeof(report), (off_t)(sizeof(report) * i)) != (ssize_t)sizeof(report)) {
+      fprintf(stderr, "Failed to read the report of session %zu\n", i);
+      return 1;
+    }
+    first_start_ns = report.start_ns < first_start_ns ? report.start_ns : first_start_ns;
+    last_end_ns = report.end_ns > last_end_ns ? report.end_ns : last_end_ns;
+    num_sessions++;
+  }
+  for (size_t i = 0; i < replay.num_records; i++) {
+    int types[] = {samples[i].op, NUM_REPLAY_OPS};
+    for (int t = 0; t < 2; t++) {
+      latencies[types[t]][counts[types[t]]++] = samples[i].latency_ns;
+      failures[types[t]] += (size_t)samples[i].failed;
+      sums_us[types[t]] += (double)samples[i].latency_ns / 1e3;
+    }
+  }
+
+  // Throughput is taken over the time any session was running
+  double elapsed_s = (double)(last_end_ns - first_start_ns) / 1e9;
+  // Counters are those of the server threads, which can't be told apart by request type, so only the row of all
+  // requests has them
+  dprintf(results_fd, "op,timing,sessions,ops,failed,ops_per_sec,mean_us,p50_us,p99_us,p999_us," PERF_CSV_HEADER "\n");
+  for (int op = 0; op <= NUM_REPLAY_OPS; op++) {
+    if (counts[op] == 0) {
+      continue;
+    }
+    sort_latencies(latencies[op], counts[op]);
+    dprintf(results_fd, "%s,%s,%zu,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,", op < NUM_REPLAY_OPS ? op_names[op] : "all",
+            replay.timed ? "original" : "fast", num_sessions, counts[op], failures[op], (double)counts[op] / elapsed_s,
+            sums_us[op] / (double)counts[op], (double)percentile_ns(latencies[op], counts[op], 0.5) / 1e3,
+            (double)percentile_ns(latencies[op], counts[op], 0.99) / 1e3,
+            (double)percentile_ns(latencies[op], counts[op], 0.999) / 1e3);
+    perf_counts_print(results_fd, op == NUM_REPLAY_OPS ? &server_counts : NULL, counts[op]);
+    dprintf(results_fd, "\n");
+  }
+
+  for (int op = 0; op <= NUM_REPLAY_OPS; op++) {
+    free(latencies[op]);
+  }
+  free(samples);
+  free(replay.records);
+  free(replay.sessions);
+  munmap(trace, trace_len);
+  close(trace_fd);
+  fclose(reports);
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#include "session.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "client/api.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+int bench_setup_session(const char *address, const char *pipe_prefix) {
+  char req_pipe_path[CLIENT_PIPE_MAX_LEN], resp_pipe_path[CLIENT_PIPE_MAX_LEN];
+  snprintf(req_pipe_path, CLIENT_PIPE_MAX_LEN, "/tmp/%s-req-%d", pipe_prefix, getpid());
+  snprintf(resp_pipe_path, CLIENT_PIPE_MAX_LEN, "/tmp/%s-resp-%d", pipe_prefix, getpid());
+
+  return ems_setup(req_pipe_path, resp_pipe_path, address);
+}
+
+int bench_same_output(int fd, int other_fd) {
+  char buf[4096], other[4096];
+  if (lseek(fd, 0, SEEK_SET) < 0 || lseek(other_fd, 0, SEEK_SET) < 0) {
+    return 1;
+  }
+  for (;;) {
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len < 0 || pipe_parse(other_fd, other, (size_t)len) || memcmp(buf, other, (size_t)len) != 0) {
+      return 1;
+    }
+    if (len == 0) {
+      return read(other_fd, other, 1) != 0;
+    }
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef BENCH_SESSION_H
+#define BENCH_SESSION_H
+
+/// Opens a session with pipes of its own, named after the process.
+/// @param address Server address.
+/// @param pipe_prefix Prefix of the names of the pipes, in /tmp.
+/// @return 0 if successful, 1 otherwise.
+int bench_setup_session(const char *address, const char *pipe_prefix);
+
+/// Checks that two files hold the same output, reading both from their start.
+/// @param fd File descriptor of a file.
+/// @param other_fd File descriptor of the other file.
+/// @return 0 if they match, 1 otherwise.
+int bench_same_output(int fd, int other_fd);
+
+#endif  // BENCH_SESSION_H
@@ -0,0 +1,128 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+/// Reserves the seats of the event one by one, until killed.
+static void reserve_loop(const char *address, unsigned int event_id, size_t num_rows, size_t num_cols,
+                         unsigned long rate) {
+  if (bench_setup_session(address, "ems-bench")) {
+    exit(1);
+  }
+
+  struct timespec interval = {(time_t)(1 / rate), (long)(1000000000UL / rate % 1000000000UL)};
+  for (size_t i = 0; i < num_rows * num_cols; i++) {
+    size_t x = i / num_cols + 1, y = i % num_cols + 1;
+    ems_reserve(event_id, 1, &x, &y);
+    nanosleep(&interval, NULL);
+  }
+  exit(ems_quit());
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5 || argc > 7) {
+    fprintf(stderr,
+            "Usage: %s <server pipe path | unix:socket path> <rows> <cols> <shows per client> [clients] "
+            "[reservations per second]\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t num_rows = strtoul(argv[2], NULL, 10);
+  size_t num_cols = strtoul(argv[3], NULL, 10);
+  unsigned long shows = strtoul(argv[4], NULL, 10);
+  unsigned long clients = argc > 5 ? strtoul(argv[5], NULL, 10) : 1;
+  unsigned long rate = argc > 6 ? strtoul(argv[6], NULL, 10) : 0;
+  if (num_rows == 0 || num_cols == 0 || shows == 0 || clients == 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  if (bench_setup_session(argv[1], "ems-bench")) {
+    fprintf(stderr, "Failed to set up session\n");
+    return 1;
+  }
+
+  // Every run gets its own venue
+  unsigned int event_id = (unsigned int)getpid();
+  if (ems_create(event_id, num_rows, num_cols)) {
+    fprintf(stderr, "Failed to create event\n");
+    return 1;
+  }
+  ems_quit();
+
+  // Reservations trickle in while the clients show the event
+  pid_t reserver = -1;
+  if (rate > 0) {
+    reserver = fork();
+    if (reserver == 0) {
+      reserve_loop(argv[1], event_id, num_rows, num_cols, rate);
+    }
+  }
+
+  long long start = clock_now_ns();
+  for (unsigned long i = 0; i < clients; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to create client process\n");
+      return 1;
+    }
+    if (pid == 0) {
+      if (bench_setup_session(argv[1], "ems-bench")) {
+        exit(1);
+      }
+      for (unsigned long j = 0; j < shows; j++) {
+        if (ems_show(null_fd, event_id)) {
+          exit(1);
+        }
+      }
+      exit(ems_quit());
+    }
+  }
+
+  int failed = 0, status;
+  pid_t pid;
+  for (unsigned long i = 0; i < clients; i++) {
+    while ((pid = wait(&status)) > 0 && pid == reserver) {
+    }
+    failed += pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  long long elapsed = clock_now_ns() - start;
+
+  if (reserver > 0) {
+    kill(reserver, SIGKILL);
+    waitpid(reserver, NULL, 0);
+  }
+
+  if (failed > 0) {
+    fprintf(stderr, "%d of %lu clients failed\n", failed, clients);
+    return 1;
+  }
+
+  unsigned long total = clients * shows;
+  double seats = (double)(num_rows * num_cols) * (double)total;
+  dprintf(results_fd, "transport,rows,cols,clients,shows,shows_per_sec,seats_per_sec\n");
+  dprintf(results_fd, "%s,%zu,%zu,%lu,%lu,%.1f,%.0f\n", socket_address_path(argv[1]) != NULL ? "socket" : "fifo",
+          num_rows, num_cols, clients, total, (double)total * 1e9 / (double)elapsed, seats * 1e9 / (double)elapsed);
+
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
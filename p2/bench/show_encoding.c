@@ -0,0 +1,152 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+#define MAX_GROUP_SIZE 6  // Largest party booking seats together
+
+/// Books the event the way a venue fills up: parties of up to MAX_GROUP_SIZE seats side by side, with empty seats
+/// left between them. The seats are mirrored locally, reservation ids being handed out in order.
+/// @return 0 if successful, 1 otherwise.
+static int book_venue(unsigned int event_id, size_t num_rows, size_t num_cols, unsigned int occupancy,
+                      unsigned int *seats) {
+  size_t xs[MAX_GROUP_SIZE], ys[MAX_GROUP_SIZE];
+  unsigned int reservation_id = 0;
+  for (size_t row = 1; row <= num_rows; row++) {
+    size_t col = 1;
+    while (col <= num_cols) {
+      if ((unsigned int)rand() % 100 >= occupancy) {
+        col++;
+        continue;
+      }
+      size_t group = (size_t)rand() % MAX_GROUP_SIZE + 1;
+      if (group > num_cols - col + 1) {
+        group = num_cols - col + 1;
+      }
+      for (size_t i = 0; i < group; i++) {
+        xs[i] = row;
+        ys[i] = col + i;
+      }
+      if (ems_reserve(event_id, group, xs, ys)) {
+        return 1;
+      }
+      reservation_id++;
+      for (size_t i = 0; i < group; i++) {
+        seats[(row - 1) * num_cols + col - 1 + i] = reservation_id;
+      }
+      col += group;
+    }
+  }
+  return 0;
+}
+
+/// Shows the event in a session of its own each time, so every SHOW sends the whole grid.
+/// @param out_fd File descriptor to show the event to.
+/// @return Average latency of a SHOW in microseconds, negative if one failed.
+static double time_shows(const char *address, unsigned int event_id, unsigned long shows, int out_fd) {
+  long long total = 0;
+  for (unsigned long i = 0; i < shows; i++) {
+    if (bench_setup_session(address, "ems-bench")) {
+      return -1;
+    }
+    long long start = clock_now_ns();
+    int failed = ems_show(out_fd, event_id);
+    total += clock_now_ns() - start;
+    if (ems_quit() || failed) {
+      return -1;
+    }
+  }
+  return (double)total / 1e3 / (double)shows;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5 || argc > 6) {
+    fprintf(stderr, "Usage: %s <server pipe path | unix:socket path> <rows> <cols> <shows> [occupancy %%]\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t num_rows = strtoul(argv[2], NULL, 10);
+  size_t num_cols = strtoul(argv[3], NULL, 10);
+  unsigned long shows = strtoul(argv[4], NULL, 10);
+  unsigned long occupancy = argc > 5 ? strtoul(argv[5], NULL, 10) : 70;
+  if (num_rows == 0 || num_cols == 0 || shows == 0 || occupancy > 100) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  size_t num_seats = num_rows * num_cols;
+  unsigned int *seats = calloc(num_seats, sizeof(unsigned int));
+  char *runs = malloc(num_seats * sizeof(unsigned int));
+  if (seats == NULL || runs == NULL) {
+    fprintf(stderr, "Failed to allocate memory\n");
+    return 1;
+  }
+
+  // Every run gets its own venue
+  srand((unsigned int)getpid());
+  unsigned int event_id = (unsigned int)getpid();
+  if (bench_setup_session(argv[1], "ems-bench") || ems_create(event_id, num_rows, num_cols) ||
+      book_venue(event_id, num_rows, num_cols, (unsigned int)occupancy, seats)) {
+    fprintf(stderr, "Failed to book event\n");
+    return 1;
+  }
+  ems_quit();
+
+  // Both encodings must show the same seats
+  FILE *raw_file = tmpfile(), *rle_file = tmpfile();
+  if (raw_file == NULL || rle_file == NULL) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+  ems_set_show_encodings(0);
+  double raw_us = time_shows(argv[1], event_id, 1, fileno(raw_file));
+  ems_set_show_encodings(SHOW_ENCODING_RLE);
+  double rle_us = time_shows(argv[1], event_id, 1, fileno(rle_file));
+  if (raw_us < 0 || rle_us < 0 || bench_same_output(fileno(raw_file), fileno(rle_file))) {
+    fprintf(stderr, "Encodings showed different seats\n");
+    return 1;
+  }
+  fclose(raw_file);
+  fclose(rle_file);
+
+  ems_set_show_encodings(0);
+  raw_us = time_shows(argv[1], event_id, shows, null_fd);
+  ems_set_show_encodings(SHOW_ENCODING_RLE);
+  rle_us = time_shows(argv[1], event_id, shows, null_fd);
+  if (raw_us < 0 || rle_us < 0) {
+    fprintf(stderr, "Failed to show event\n");
+    return 1;
+  }
+
+  // Response: [ result ] | [ version ] | [ rows ] | [ cols ] | [ format ], followed by the seats or the runs
+  size_t header_len = sizeof(int) + sizeof(unsigned int) + 2 * sizeof(size_t) + sizeof(char);
+  size_t raw_len = num_seats * sizeof(unsigned int);
+  size_t runs_len = rle_encode_seats(seats, num_seats, runs, raw_len);
+  size_t rle_len = runs_len > 0 ? sizeof(size_t) + runs_len : raw_len;
+
+  dprintf(results_fd, "encoding,rows,cols,occupancy,bytes,show_us\n");
+  dprintf(results_fd, "raw,%zu,%zu,%lu,%zu,%.1f\n", num_rows, num_cols, occupancy, header_len + raw_len, raw_us);
+  dprintf(results_fd, "rle,%zu,%zu,%lu,%zu,%.1f\n", num_rows, num_cols, occupancy, header_len + rle_len, rle_us);
+
+  free(seats);
+  free(runs);
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common/clock.h"
+#include "server/operations.h"
+#include "server/wal.h"
+
+#define EVENT_ROWS 10
+
+static unsigned int num_events;
+static unsigned long num_reservations;
+static char log_path[4096], snapshot_path[4096];
+
+static long long file_size(const char *path) {
+  struct stat st;
+  return stat(path, &st) < 0 ? 0 : (long long)st.st_size;
+}
+
+/// Builds the log, snapshotting after 90% of the reservations so the remaining 10% are the tail.
+/// @return Duration of the snapshot in nanoseconds, negative on failure.
+static long long build(size_t num_cols) {
+  unlink(log_path);
+  unlink(snapshot_path);
+  if (ems_init(0) || ems_enable_log(log_path, NULL, WAL_NONE)) {
+    return -1;
+  }
+
+  for (unsigned int id = 1; id <= num_events; id++) {
+    ems_create(id, EVENT_ROWS, num_cols);
+  }
+
+  long long snapshot_ns = -1;
+  unsigned long snapshot_at = num_reservations / 10 * 9;
+  for (unsigned long i = 0; i < num_reservations; i++) {
+    if (i == snapshot_at) {
+      long long start = clock_now_ns();
+      if (ems_save_snapshot(snapshot_path) == 0) {
+        snapshot_ns = clock_now_ns() - start;
+      }
+    }
+
+    // Consecutive reservations go to different events, filling each one seat by seat
+    unsigned int event_id = (unsigned int)(i % num_events) + 1;
+    size_t seat = i / num_events;
+    size_t x = seat / num_cols + 1, y = seat % num_cols + 1;
+    ems_reserve(event_id, 1, &x, &y);
+  }
+
+  ems_terminate();
+  return snapshot_ns;
+}
+
+/// Rebuilds the state, from the whole log or from the snapshot and the log tail.
+/// @return Time until the state is ready in nanoseconds, negative on failure.
+static long long restart(int use_snapshot) {
+  long long start = clock_now_ns();
+  if (ems_init(0) || ems_enable_log(log_path, use_snapshot ? snapshot_path : NULL, WAL_NONE)) {
+    return -1;
+  }
+  long long elapsed = clock_now_ns() - start;
+
+  ems_terminate();
+  return elapsed;
+}
+
+/// Runs a phase in its own process, the EMS state being global.
+/// @return Result of the phase, negative on failure.
+static long long run(int phase, size_t num_cols) {
+  int result_pipe[2];
+  if (pipe(result_pipe) < 0) {
+    return -1;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    return -1;
+  }
+  if (pid == 0) {
+    long long result = phase == 0 ? build(num_cols) : restart(phase == 2);
+    exit(write(result_pipe[1], &result, sizeof(result)) != sizeof(result));
+  }
+
+  long long result = -1;
+  close(result_pipe[1]);
+  if (read(result_pipe[0], &result, sizeof(result)) != sizeof(result)) {
+    result = -1;
+  }
+  close(result_pipe[0]);
+  waitpid(pid, NULL, 0);
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <directory> <events> <reservations>\n", argv[0]);
+    return 1;
+  }
+
+  num_events = (unsigned int)strtoul(argv[2], NULL, 10);
+  num_reservations = strtoul(argv[3], NULL, 10);
+  if (num_events == 0 || num_reservations < num_events) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+  snprintf(log_path, sizeof(log_path), "%s/startup.log", argv[1]);
+  snprintf(snapshot_path, sizeof(snapshot_path), "%s/startup.log.snap", argv[1]);
+
+  // Enough seats for every reservation
+  size_t seats_per_event = (num_reservations + num_events - 1) / num_events;
+  size_t num_cols = (seats_per_event + EVENT_ROWS - 1) / EVENT_ROWS;
+
+  // Replay messages go to /dev/null
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    return 1;
+  }
+
+  long long snapshot_ns = run(0, num_cols);
+  if (snapshot_ns < 0) {
+    fprintf(stderr, "Failed to build the log\n");
+    return 1;
+  }
+  dprintf(results_fd, "log: %lld bytes, snapshot: %lld bytes written in %.2f ms\n", file_size(log_path),
+          file_size(snapshot_path), (double)snapshot_ns / 1e6);
+
+  dprintf(results_fd, "startup,events,reservations,time_to_ready_ms\n");
+  const char *names[] = {"full_log", "snapshot_and_tail"};
+  for (int i = 0; i < 2; i++) {
+    long long elapsed = run(i + 1, num_cols);
+    if (elapsed < 0) {
+      fprintf(stderr, "Benchmark failed for %s\n", names[i]);
+      continue;
+    }
+    dprintf(results_fd, "%s,%u,%lu,%.2f\n", names[i], num_events, num_reservations, (double)elapsed / 1e6);
+  }
+
+  unlink(log_path);
+  unlink(snapshot_path);
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
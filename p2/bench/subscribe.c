@@ -0,0 +1,186 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+// What a client reports back to the benchmark
+struct ClientResult {
+  unsigned long updates;  // Notifications received, or events shown
+  unsigned long resyncs;  // Resyncs received, or polls that found no free session
+};
+
+/// Follows the event through notifications until the last reservation.
+static int follow(const char *address, unsigned int event_id, unsigned long reservations, int ready_fd,
+                  struct ClientResult *result) {
+  if (ems_subscribe(address, event_id)) {
+    return 1;
+  }
+  char ready = 1;
+  if (write(ready_fd, &ready, sizeof(ready)) != sizeof(ready)) {
+    return 1;
+  }
+
+  ems_notification_t notification;
+  while (ems_next_notification(&notification) == 0) {
+    if (notification.type == NOTIFICATION_RESYNC) {
+      result->resyncs++;
+      continue;
+    }
+    result->updates++;
+    if (notification.reservation_id == reservations) {
+      ems_close_subscriptions();
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/// Follows the event by showing it every interval, in a session of its own each time, until the deadline.
+static int poll_event(const char *address, unsigned int event_id, long long deadline, long interval_ms, int ready_fd,
+                      int null_fd, struct ClientResult *result) {
+  char ready = 1;
+  if (write(ready_fd, &ready, sizeof(ready)) != sizeof(ready)) {
+    return 1;
+  }
+
+  // Clients are spread over the interval instead of polling all at once
+  struct timespec interval = {interval_ms / 1000, interval_ms % 1000 * 1000000L};
+  long offset_us = rand() % (interval_ms * 1000);
+  struct timespec offset = {offset_us / 1000000, offset_us % 1000000 * 1000};
+  nanosleep(&offset, NULL);
+
+  while (clock_now_ns() < deadline) {
+    if (bench_setup_session(address, "ems-bench")) {
+      result->resyncs++;
+    } else {
+      result->updates += ems_show(null_fd, event_id) == 0;
+      ems_quit();
+    }
+    nanosleep(&interval, NULL);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 6 || argc > 7) {
+    fprintf(stderr,
+            "Usage: %s <unix:socket path> <subscribe | poll> <clients> <reservations> <reservations per second> "
+            "[poll interval ms]\n",
+            argv[0]);
+    return 1;
+  }
+
+  int polling = strcmp(argv[2], "poll") == 0;
+  unsigned long clients = strtoul(argv[3], NULL, 10);
+  unsigned long reservations = strtoul(argv[4], NULL, 10);
+  unsigned long rate = strtoul(argv[5], NULL, 10);
+  long interval_ms = argc > 6 ? strtol(argv[6], NULL, 10) : 100;
+  if ((!polling && strcmp(argv[2], "subscribe") != 0) || clients == 0 || reservations == 0 || rate == 0 ||
+      interval_ms <= 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  // Every run gets its own venue, a single row with a seat per reservation
+  unsigned int event_id = (unsigned int)getpid();
+  if (bench_setup_session(argv[1], "ems-bench") || ems_create(event_id, 1, reservations)) {
+    fprintf(stderr, "Failed to create event\n");
+    return 1;
+  }
+  ems_quit();
+
+  int ready_pipe[2], result_pipe[2];
+  if (pipe(ready_pipe) < 0 || pipe(result_pipe) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  long long duration = (long long)reservations * 1000000000LL / (long long)rate;
+  long long deadline = clock_now_ns() + duration;
+  for (unsigned long i = 0; i < clients; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to create client process\n");
+      return 1;
+    }
+    if (pid == 0) {
+      srand((unsigned int)getpid());
+      struct ClientResult result = {0, 0};
+      int failed = polling ? poll_event(argv[1], event_id, deadline, interval_ms, ready_pipe[1], null_fd, &result)
+                           : follow(argv[1], event_id, reservations, ready_pipe[1], &result);
+      if (write(result_pipe[1], &result, sizeof(result)) != sizeof(result)) {
+        failed = 1;
+      }
+      exit(failed);
+    }
+  }
+
+  // Reservations only start once every subscriber is listening
+  for (unsigned long i = 0; i < clients; i++) {
+    char ready;
+    if (read(ready_pipe[0], &ready, sizeof(ready)) != sizeof(ready)) {
+      fprintf(stderr, "Failed to wait for the clients\n");
+      return 1;
+    }
+  }
+
+  long long start = clock_now_ns();
+  if (bench_setup_session(argv[1], "ems-bench")) {
+    fprintf(stderr, "Failed to set up session\n");
+    return 1;
+  }
+  struct timespec interval = {(time_t)(1 / rate), (long)(1000000000UL / rate % 1000000000UL)};
+  for (size_t seat = 1; seat <= reservations; seat++) {
+    size_t row = 1;
+    if (ems_reserve(event_id, 1, &row, &seat)) {
+      fprintf(stderr, "Failed to reserve seat\n");
+    }
+    nanosleep(&interval, NULL);
+  }
+  ems_quit();
+
+  int failed = 0, status;
+  while (wait(&status) > 0) {
+    failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  long long elapsed = clock_now_ns() - start;
+
+  struct ClientResult total = {0, 0};
+  for (unsigned long i = 0; i < clients; i++) {
+    struct ClientResult result;
+    if (read(result_pipe[0], &result, sizeof(result)) == sizeof(result)) {
+      total.updates += result.updates;
+      total.resyncs += result.resyncs;
+    }
+  }
+
+  if (failed > 0) {
+    fprintf(stderr, "%d of %lu clients failed\n", failed, clients);
+    return 1;
+  }
+
+  dprintf(results_fd, "mode,clients,reservations,seconds,updates,%s\n", polling ? "refused" : "resyncs");
+  dprintf(results_fd, "%s,%lu,%lu,%.2f,%lu,%lu\n", polling ? "poll" : "subscribe", clients, reservations,
+          (double)elapsed / 1e9, total.updates, total.resyncs);
+
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
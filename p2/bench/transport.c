@@ -0,0 +1,134 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+/// Runs sessions one after the other, each doing a number of LIST requests.
+/// @param address Server address.
+/// @param sessions Number of sessions.
+/// @param ops Number of requests per session.
+/// @param times Variable to store the time spent connecting and doing requests, in nanoseconds.
+/// @return 0 if successful, 1 otherwise.
+static int run_sessions(const char *address, unsigned long sessions, unsigned long ops, long long times[2]) {
+  char req_pipe_path[CLIENT_PIPE_MAX_LEN], resp_pipe_path[CLIENT_PIPE_MAX_LEN];
+  snprintf(req_pipe_path, CLIENT_PIPE_MAX_LEN, "/tmp/ems-bench-req-%d", getpid());
+  snprintf(resp_pipe_path, CLIENT_PIPE_MAX_LEN, "/tmp/ems-bench-resp-%d", getpid());
+
+  times[0] = times[1] = 0;
+  for (unsigned long i = 0; i < sessions; i++) {
+    long long start = clock_now_ns();
+    if (ems_setup(req_pipe_path, resp_pipe_path, address)) {
+      fprintf(stderr, "Failed to set up session %lu\n", i);
+      return 1;
+    }
+    times[0] += clock_now_ns() - start;
+
+    start = clock_now_ns();
+    for (unsigned long j = 0; j < ops; j++) {
+      if (ems_list_events(STDOUT_FILENO)) {
+        fprintf(stderr, "Failed to list events\n");
+        return 1;
+      }
+    }
+    times[1] += clock_now_ns() - start;
+
+    if (ems_quit()) {
+      fprintf(stderr, "Failed to quit session %lu\n", i);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4 || argc > 5) {
+    fprintf(stderr, "Usage: %s <server pipe path | unix:socket path> <sessions> <ops per session> [clients]\n",
+            argv[0]);
+    return 1;
+  }
+
+  char *endptr;
+  unsigned long sessions = strtoul(argv[2], &endptr, 10);
+  if (*endptr != '\0' || sessions == 0) {
+    fprintf(stderr, "Invalid number of sessions\n");
+    return 1;
+  }
+  unsigned long ops = strtoul(argv[3], &endptr, 10);
+  if (*endptr != '\0') {
+    fprintf(stderr, "Invalid number of ops\n");
+    return 1;
+  }
+  unsigned long clients = 1;
+  if (argc == 5) {
+    clients = strtoul(argv[4], &endptr, 10);
+    if (*endptr != '\0' || clients == 0) {
+      fprintf(stderr, "Invalid number of clients\n");
+      return 1;
+    }
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  int times_pipe[2];
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0 || pipe(times_pipe) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  // Every client is its own process, with its own session at a time
+  long long start = clock_now_ns();
+  for (unsigned long i = 0; i < clients; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to create client process\n");
+      return 1;
+    }
+    if (pid == 0) {
+      long long times[2];
+      int result = run_sessions(argv[1], sessions, ops, times);
+      if (result == 0 && pipe_print(times_pipe[1], times, sizeof(times))) {
+        result = 1;
+      }
+      exit(result);
+    }
+  }
+  close(times_pipe[1]);
+
+  long long connect_ns = 0, ops_ns = 0;
+  unsigned long finished = 0;
+  long long times[2];
+  while (pipe_parse(times_pipe[0], times, sizeof(times)) == 0) {
+    connect_ns += times[0];
+    ops_ns += times[1];
+    finished++;
+  }
+  while (wait(NULL) > 0) {
+  }
+  long long elapsed_ns = clock_now_ns() - start;
+
+  if (finished != clients) {
+    fprintf(stderr, "%lu of %lu clients failed\n", clients - finished, clients);
+    return 1;
+  }
+
+  unsigned long total_ops = clients * sessions * ops;
+  dprintf(results_fd, "transport,clients,sessions,connect_us,ops,op_latency_us,ops_per_sec\n");
+  dprintf(results_fd, "%s,%lu,%lu,%.2f,%lu,%.2f,%.1f\n", socket_address_path(argv[1]) != NULL ? "socket" : "fifo",
+          clients, clients * sessions, (double)connect_ns / 1e3 / (double)(clients * sessions), total_ops,
+          total_ops == 0 ? 0.0 : (double)ops_ns / 1e3 / (double)total_ops,
+          (double)total_ops * 1e9 / (double)elapsed_ns);
+
+  close(times_pipe[0]);
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
@@ -0,0 +1,32 @@
+#include "util.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+unsigned long long next_random(unsigned long long *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+double next_uniform(unsigned long long *state) { return (double)(next_random(state) >> 11) / 9007199254740992.0; }
+
+/// Orders latencies for qsort.
+static int compare_latency(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+void sort_latencies(long long *latencies, size_t count) { qsort(latencies, count, sizeof(long long), compare_latency); }
+
+long long percentile_ns(const long long *latencies, size_t count, double fraction) {
+  size_t rank = (size_t)ceil(fraction * (double)count);
+  return latencies[rank > 0 ? rank - 1 : 0];
+}
+
+int parse_number(const char *arg, unsigned long *value) {
+  char *end;
+  *value = strtoul(arg, &end, 10);
+  return *end != '\0' || end == arg;
+}
@@ -0,0 +1,34 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stddef.h>
+
+/// Draws the next number of a xorshift64* generator.
+/// @param state State of the generator, never 0.
+/// @return Number drawn.
+unsigned long long next_random(unsigned long long *state);
+
+/// Draws a number in [0, 1) from a generator.
+/// @param state State of the generator, never 0.
+/// @return Number drawn.
+double next_uniform(unsigned long long *state);
+
+/// Sorts latencies in increasing order, for percentile_ns.
+/// @param latencies Latencies to sort.
+/// @param count Number of latencies.
+void sort_latencies(long long *latencies, size_t count);
+
+/// Gets a percentile of sorted latencies.
+/// @param latencies Sorted latencies.
+/// @param count Number of latencies.
+/// @param fraction Fraction of the latencies that are at most the percentile.
+/// @return The percentile, in the unit of the latencies.
+long long percentile_ns(const long long *latencies, size_t count, double fraction);
+
+/// Parses a number of an option.
+/// @param arg Argument of the option.
+/// @param value Variable to store the number in.
+/// @return 0 if successful, 1 otherwise.
+int parse_number(const char *arg, unsigned long *value);
+
+#endif  // BENCH_UTIL_H
@@ -0,0 +1,105 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common/clock.h"
+#include "server/operations.h"
+#include "server/wal.h"
+
+#define EVENT_ID 1
+
+static unsigned long reservations;
+
+/// Reserves the seats of its own row, one by one, so reservations never conflict.
+static void *reserve_row(void *arg) {
+  size_t row = (size_t)(uintptr_t)arg;
+
+  for (size_t col = 1; col <= reservations; col++) {
+    size_t x = row, y = col;
+    if (ems_reserve(EVENT_ID, 1, &x, &y)) {
+      fprintf(stderr, "Failed to reserve seat\n");
+    }
+  }
+
+  return NULL;
+}
+
+/// Runs the benchmark in a fresh EMS state, logging with the given mode.
+/// @return Reservations per second, negative on failure.
+static double run(const char *log_path, enum WalMode mode, int use_log, size_t threads) {
+  unlink(log_path);
+  if (ems_init(0) || ems_create(EVENT_ID, threads, reservations)) {
+    return -1;
+  }
+  if (use_log && wal_open(log_path, mode, 0)) {
+    return -1;
+  }
+
+  pthread_t workers[threads];
+  long long start = clock_now_ns();
+  for (size_t i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, reserve_row, (void *)(uintptr_t)(i + 1));
+  }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  long long elapsed = clock_now_ns() - start;
+
+  ems_terminate();
+  unlink(log_path);
+  return (double)(threads * reservations) * 1e9 / (double)elapsed;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <log path> <threads> <reservations per thread>\n", argv[0]);
+    return 1;
+  }
+
+  size_t threads = strtoul(argv[2], NULL, 10);
+  reservations = strtoul(argv[3], NULL, 10);
+  if (threads == 0 || reservations == 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  const char *names[] = {"no-log", "none", "batched", "per-op"};
+  const enum WalMode modes[] = {WAL_NONE, WAL_NONE, WAL_BATCHED, WAL_PER_OP};
+
+  printf("mode,threads,reservations,reservations_per_sec\n");
+  fflush(stdout);
+
+  // The EMS state is global, so every mode runs in its own process
+  for (int i = 0; i < 4; i++) {
+    int result_pipe[2];
+    if (pipe(result_pipe) < 0) {
+      return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      return 1;
+    }
+    if (pid == 0) {
+      double rate = run(argv[1], modes[i], i > 0, threads);
+      exit(write(result_pipe[1], &rate, sizeof(rate)) != sizeof(rate));
+    }
+
+    double rate = -1;
+    close(result_pipe[1]);
+    if (read(result_pipe[0], &rate, sizeof(rate)) != sizeof(rate) || rate < 0) {
+      fprintf(stderr, "Benchmark failed for mode %s\n", names[i]);
+    } else {
+      printf("%s,%zu,%zu,%.1f\n", names[i], threads, threads * reservations, rate);
+      fflush(stdout);
+    }
+    close(result_pipe[0]);
+    waitpid(pid, NULL, 0);
+  }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/session.h"
+#include "client/api.h"
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+// Way of sending the seats of a reservation
+struct Variant {
+  const char *name;
+  char wire_version;
+  int block;  // Whether the seats go as a single block instead of a list of coordinates
+};
+
+static const struct Variant variants[] = {
+    {"native", WIRE_VERSION_NATIVE, 0},
+    {"compact", WIRE_VERSION_COMPACT, 0},
+    {"native-block", WIRE_VERSION_NATIVE, 1},
+    {"compact-block", WIRE_VERSION_COMPACT, 1},
+};
+
+#define NUM_VARIANTS (sizeof(variants) / sizeof(variants[0]))
+
+/// Reserves whole venues, one reservation per venue, every NUM_VARIANTS venues from the first one.
+/// @return 0 if successful, 1 otherwise.
+static int reserve_venues(const char *address, const struct Variant *variant, unsigned int first_event_id,
+                          size_t num_events, size_t num_cols) {
+  size_t *xs = malloc(sizeof(size_t) * num_cols), *ys = malloc(sizeof(size_t) * num_cols);
+  if (xs == NULL || ys == NULL || bench_setup_session(address, "ems-bench")) {
+    return 1;
+  }
+
+  for (size_t col = 0; col < num_cols; col++) {
+    xs[col] = 1;
+    ys[col] = col + 1;
+  }
+  seat_range_t row = {1, 1, 1, num_cols};
+  for (size_t i = 0; i < num_events; i++) {
+    unsigned int event_id = first_event_id + (unsigned int)(NUM_VARIANTS * i);
+    if (variant->block ? ems_reserve_ranges(event_id, 1, &row) : ems_reserve(event_id, num_cols, xs, ys)) {
+      return 1;
+    }
+  }
+
+  free(xs);
+  free(ys);
+  return ems_quit();
+}
+
+/// Gets the length of the RESERVE requests sent by reserve_venues.
+/// @return Length in bytes.
+static size_t reserve_request_len(const struct Variant *variant, size_t num_cols) {
+  if (variant->wire_version != WIRE_VERSION_COMPACT) {
+    size_t seats_len = variant->block ? sizeof(seat_range_t) : 2 * sizeof(size_t) * num_cols;
+    return sizeof(char) + sizeof(unsigned int) + sizeof(size_t) + seats_len;
+  }
+
+  size_t len = sizeof(char) + sizeof(unsigned int) + 2 * sizeof(uint32_t);
+  char varint[VARINT_MAX_LEN];
+  if (variant->block) {
+    return len + 3 * varint_encode(varint, 1) + varint_encode(varint, num_cols);
+  }
+  for (size_t col = 0; col < num_cols; col++) {
+    len += varint_encode(varint, 1) + varint_encode(varint, col + 1);
+  }
+  return len;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4 || argc > 5) {
+    fprintf(stderr,
+            "Usage: %s <server pipe path | unix:socket path> <seats per reservation> <reservations> [clients]\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t num_cols = strtoul(argv[2], NULL, 10);
+  size_t reservations = strtoul(argv[3], NULL, 10);
+  unsigned long clients = argc > 4 ? strtoul(argv[4], NULL, 10) : 1;
+  if (num_cols == 0 || reservations == 0 || clients == 0 || reservations * clients > UINT16_MAX / NUM_VARIANTS) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // The API reports every operation on stdout, keep it for the results only
+  int results_fd = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Failed to set up the benchmark\n");
+    return 1;
+  }
+
+  // Every reservation gets a single row venue of its own, so the wire dominates instead of the seat checks. The
+  // venues of every variant alternate, so their lookups walk the same distance.
+  size_t num_events = reservations * clients;
+  unsigned int first_event_id = (unsigned int)getpid() << 16;
+  if (bench_setup_session(argv[1], "ems-bench")) {
+    fprintf(stderr, "Failed to set up session\n");
+    return 1;
+  }
+  for (size_t i = 0; i < NUM_VARIANTS * num_events; i++) {
+    if (ems_create(first_event_id + (unsigned int)i, 1, num_cols)) {
+      fprintf(stderr, "Failed to create event\n");
+      return 1;
+    }
+  }
+  ems_quit();
+
+  dprintf(results_fd, "request,seats,clients,reservations,request_bytes,reservations_per_sec\n");
+  for (size_t v = 0; v < NUM_VARIANTS; v++) {
+    ems_set_wire_version(variants[v].wire_version);
+
+    long long start = clock_now_ns();
+    for (unsigned long i = 0; i < clients; i++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        fprintf(stderr, "Failed to create client process\n");
+        return 1;
+      }
+      if (pid == 0) {
+        unsigned int client_event_id = first_event_id + (unsigned int)(NUM_VARIANTS * i * reservations + v);
+        exit(reserve_venues(argv[1], &variants[v], client_event_id, reservations, num_cols));
+      }
+    }
+
+    int failed = 0, status;
+    while (wait(&status) > 0) {
+      failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    long long elapsed = clock_now_ns() - start;
+    if (failed > 0) {
+      fprintf(stderr, "%d of %lu clients failed\n", failed, clients);
+      return 1;
+    }
+
+    dprintf(results_fd, "%s,%zu,%lu,%zu,%zu,%.0f\n", variants[v].name, num_cols, clients, num_events,
+            reserve_request_len(&variants[v], num_cols), (double)num_events * 1e9 / (double)elapsed);
+  }
+
+  close(null_fd);
+  close(results_fd);
+  return 0;
+}
@@ -2,10 +2,14 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include "common/constants.h"
@@ -14,7 +18,361 @@
 char client_req_pipe_path[CLIENT_PIPE_MAX_LEN] = {0};
 char client_resp_pipe_path[CLIENT_PIPE_MAX_LEN] = {0};
 
+// Socket session, used instead of the pipes when the server address is a socket
+static int session_socket_fd = -1;
+static packet_reader_t session_reader;
+
+// Request pipe held open while a request is streamed in parts, -1 otherwise
+static int request_fd = -1;
+
+// Response pipe of the response being received, and its first byte while it's yet to be handed out
+static int response_fd = -1;
+static char response_first_byte;
+static int response_first_byte_pending = 0;
+
+// Payloads of SHOW and LIST responses, kept across requests so large venues aren't reallocated each time
+static void* payload_buffer = NULL;
+static size_t payload_capacity = 0;
+
+// Formats SHOW and LIST output before it's written out
+static write_buffer_t output;
+
+// Seats of an event as last shown in this session, so showing it again only brings the seats reserved since
+struct CachedEvent {
+  unsigned int event_id;
+  unsigned int version;
+  size_t num_rows;
+  size_t num_cols;
+  unsigned int* seats;
+  struct CachedEvent* next;
+};
+
+static struct CachedEvent* cached_events = NULL;
+
+// Wire encoding asked for at setup, and the one the server agreed on for the session
+static char requested_wire_version = WIRE_VERSION_LATEST;
+static char wire_version = WIRE_VERSION_NATIVE;
+
+// Encodings SHOW accepts for whole seat grids, none by default: over local transports the raw grid is cheaper to
+// move than to encode and decode
+static char show_encodings = 0;
+
+// Subscription connection, apart from the session so notifications never get in the way of responses
+static int subscription_fd = -1;
+static packet_reader_t subscription_reader;
+
+// Notification as read from the subscription connection, with its seats
+struct ReadNotification {
+  ems_notification_t notification;
+  struct ReadNotification* next;
+  size_t seats[];
+};
+
+// Notifications read while waiting for the answer to a subscription request, oldest first
+static struct ReadNotification *queued_notifications = NULL, *last_queued_notification = NULL;
+
+// Notification last handed out, kept until the next one is read
+static struct ReadNotification* current_notification = NULL;
+
+/// Sends a whole request to the server.
+/// @param request Content of the request.
+/// @param request_len Length of the request.
+/// @return 0 if successful, 1 otherwise.
+static int send_request(const void* request, size_t request_len) {
+  if (session_socket_fd != -1) {
+    if (packet_print(session_socket_fd, request, request_len)) {
+      fprintf(stderr, "Failed to send request to server socket.\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  if (request_fd != -1) {
+    if (pipe_print(request_fd, request, request_len)) {
+      fprintf(stderr, "Failed to send request to server pipe.\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  // Open request pipe and send request.
+  int client_req_fd = open(client_req_pipe_path, O_WRONLY);
+  if (client_req_fd < 0) {
+    fprintf(stderr, "Failed to open client request pipe.\n");
+    return 1;
+  }
+  if (pipe_print(client_req_fd, request, request_len)) {
+    fprintf(stderr, "Failed to send setup request to server pipe.\n");
+    close(client_req_fd);
+    return 1;
+  }
+  close(client_req_fd);
+
+  return 0;
+}
+
+/// Starts streaming a request in parts, holding the request pipe open so the server reads them as one request after
+/// the other.
+/// @return 0 if successful, 1 otherwise.
+static int begin_stream(void) {
+  if (session_socket_fd != -1) {
+    return 0;
+  }
+
+  request_fd = open(client_req_pipe_path, O_WRONLY);
+  if (request_fd == -1) {
+    fprintf(stderr, "Failed to open client request pipe.\n");
+    return 1;
+  }
+  return 0;
+}
+
+/// Finishes streaming a request, releasing the request pipe.
+static void end_stream(void) {
+  if (request_fd != -1) {
+    close(request_fd);
+    request_fd = -1;
+  }
+}
+
+/// Starts receiving a response from the server.
+/// @return 0 if successful, 1 otherwise.
+static int begin_response(void) {
+  if (session_socket_fd != -1) {
+    return 0;
+  }
+
+  // The server may still hold the pipe open from the previous response, in which case it's opened against that
+  // writer and reaches its end before this response starts. It's opened again until the response comes through.
+  while (1) {
+    response_fd = open(client_resp_pipe_path, O_RDONLY);
+    if (response_fd == -1) {
+      fprintf(stderr, "Failed to open response pipe.\n");
+      return 1;
+    }
+
+    ssize_t len = read(response_fd, &response_first_byte, 1);
+    if (len == 1) {
+      response_first_byte_pending = 1;
+      return 0;
+    }
+    close(response_fd);
+    response_fd = -1;
+    if (len == -1 && errno != EINTR) {
+      fprintf(stderr, "Failed to read response pipe.\n");
+      return 1;
+    }
+  }
+}
+
+/// Reads the next part of the response being received.
+/// @param buf Variable to store what is read.
+/// @param buf_len Length to read.
+/// @return 0 if successful, 1 otherwise.
+static int receive_response(void* buf, size_t buf_len) {
+  if (session_socket_fd != -1) {
+    return packet_parse(&session_reader, buf, buf_len);
+  }
+
+  if (response_first_byte_pending && buf_len > 0) {
+    *(char*)buf = response_first_byte;
+    response_first_byte_pending = 0;
+    buf = (char*)buf + 1;
+    buf_len--;
+  }
+  return pipe_parse(response_fd, buf, buf_len);
+}
+
+/// Reads an array at the end of the response being received into the payload buffer, all at once.
+/// @param num_items Number of items in the array.
+/// @param item_len Length of each item.
+/// @return Buffer holding the array, NULL on failure.
+static void* receive_response_array(size_t num_items, size_t item_len) {
+  if (num_items > SIZE_MAX / item_len) {
+    fprintf(stderr, "Response is too large.\n");
+    return NULL;
+  }
+
+  // Empty arrays still get a buffer, NULL is how failure is told apart
+  size_t len = num_items * item_len;
+  if (len > payload_capacity || payload_buffer == NULL) {
+    void* temp = realloc(payload_buffer, len > 0 ? len : 1);
+    if (temp == NULL) {
+      perror("Memory allocation failed");
+      return NULL;
+    }
+    payload_buffer = temp;
+    payload_capacity = len;
+  }
+
+  if (len > 0 && receive_response(payload_buffer, len)) {
+    return NULL;
+  }
+  return payload_buffer;
+}
+
+/// Finishes receiving the response, dropping anything left of it.
+static void end_response(void) {
+  if (session_socket_fd != -1) {
+    packet_discard(&session_reader);
+    return;
+  }
+
+  close(response_fd);
+  response_fd = -1;
+  response_first_byte_pending = 0;
+}
+
+/// Gets the length of a dimension or count in the wire encoding of the session.
+/// @return Length in bytes.
+static size_t size_len(void) { return wire_version == WIRE_VERSION_COMPACT ? sizeof(uint32_t) : sizeof(size_t); }
+
+/// Adds a dimension or count to a request, in the wire encoding of the session.
+/// @param request Request being created.
+/// @param offset Offset to write from.
+/// @param value Value to add.
+/// @return 0 if successful, 1 if the value doesn't fit in the encoding.
+static int add_size(void* request, size_t* offset, size_t value) {
+  if (wire_version != WIRE_VERSION_COMPACT) {
+    create_message(request, offset, &value, sizeof(size_t));
+    return 0;
+  }
+
+  if (value > UINT32_MAX) {
+    fprintf(stderr, "Value is too large for the wire encoding.\n");
+    return 1;
+  }
+  uint32_t compact = (uint32_t)value;
+  create_message(request, offset, &compact, sizeof(uint32_t));
+  return 0;
+}
+
+/// Gets the cached seats of an event, adding an empty grid if the event wasn't shown before or changed size.
+/// @param event_id Id of the event.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @return Cached event, NULL on failure.
+static struct CachedEvent* cache_event(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (num_cols != 0 && num_rows > SIZE_MAX / sizeof(unsigned int) / num_cols) {
+    fprintf(stderr, "Response is too large.\n");
+    return NULL;
+  }
+
+  struct CachedEvent* event = cached_events;
+  while (event != NULL && event->event_id != event_id) {
+    event = event->next;
+  }
+  if (event != NULL && event->num_rows == num_rows && event->num_cols == num_cols) {
+    return event;
+  }
+
+  unsigned int* seats = calloc(num_rows * num_cols + 1, sizeof(unsigned int));
+  if (seats == NULL) {
+    perror("Memory allocation failed");
+    return NULL;
+  }
+  if (event == NULL) {
+    event = malloc(sizeof(struct CachedEvent));
+    if (event == NULL) {
+      perror("Memory allocation failed");
+      free(seats);
+      return NULL;
+    }
+    event->event_id = event_id;
+    event->seats = NULL;
+    event->next = cached_events;
+    cached_events = event;
+  }
+
+  free(event->seats);
+  event->version = 0;
+  event->num_rows = num_rows;
+  event->num_cols = num_cols;
+  event->seats = seats;
+  return event;
+}
+
+/// Gets the version of the cached seats of an event.
+/// @param event_id Id of the event.
+/// @return Version of the cached seats, 0 if the event isn't cached.
+static unsigned int cached_event_version(unsigned int event_id) {
+  for (struct CachedEvent* event = cached_events; event != NULL; event = event->next) {
+    if (event->event_id == event_id) {
+      return event->version;
+    }
+  }
+  return 0;
+}
+
+/// Drops the cached seats of every event.
+static void free_cached_events(void) {
+  while (cached_events != NULL) {
+    struct CachedEvent* next = cached_events->next;
+    free(cached_events->seats);
+    free(cached_events);
+    cached_events = next;
+  }
+}
+
+/// Opens a connection to an EMS server listening on a Unix socket.
+/// @param socket_path Path of the server socket.
+/// @return Connected socket, -1 on failure.
+static int socket_connect(char const* socket_path) {
+  struct sockaddr_un address;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Server socket path is too long.\n");
+    return -1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+
+  int socket_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (socket_fd < 0) {
+    fprintf(stderr, "Failed to create socket.\n");
+    return -1;
+  }
+  if (connect(socket_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    fprintf(stderr, "Failed to connect to server socket.\n");
+    close(socket_fd);
+    return -1;
+  }
+  return socket_fd;
+}
+
+/// Connects to an EMS server listening on a Unix socket.
+/// @param socket_path Path of the server socket.
+/// @return 0 if the connection was established successfully, 1 otherwise.
+static int socket_setup(char const* socket_path) {
+  session_socket_fd = socket_connect(socket_path);
+  if (session_socket_fd < 0) {
+    return 1;
+  }
+  packet_reader_init(&session_reader, session_socket_fd);
+
+  // [ op_code (char) ] | [ wire_version (char) ]
+  char request[] = {OP_CODE_SETUP_REQUEST, requested_wire_version};
+  int session_id;
+  if (send_request(request, sizeof(request)) || begin_response() || receive_response(&session_id, sizeof(int)) ||
+      receive_response(&wire_version, sizeof(char))) {
+    fprintf(stderr, "Failed to read session id from server.\n");
+    close(session_socket_fd);
+    session_socket_fd = -1;
+    return 1;
+  }
+  end_response();
+
+  printf("Setup completed successfully. Session ID %d has been assigned.\n", session_id);
+  return 0;
+}
+
 int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path) {
+  char const* socket_path = socket_address_path(server_pipe_path);
+  if (socket_path != NULL) {
+    return socket_setup(socket_path);
+  }
+
   // Remove existing pipes and create new ones
   if ((unlink(req_pipe_path) != 0 && errno != ENOENT) || mkfifo(req_pipe_path, 0640) < 0) {
     fprintf(stderr, "Failed to create request pipe.\n");
@@ -31,16 +389,19 @@ int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const*
   strcpy(client_req_pipe_path, req_pipe_path);
   strcpy(client_resp_pipe_path, resp_pipe_path);
 
-  size_t request_len = sizeof(char) + sizeof(char) * CLIENT_PIPE_MAX_LEN + sizeof(char) * CLIENT_PIPE_MAX_LEN;
+  size_t request_len =
+      sizeof(char) + sizeof(char) * CLIENT_PIPE_MAX_LEN + sizeof(char) * CLIENT_PIPE_MAX_LEN + sizeof(char);
   char request[request_len];
   size_t offset = 0;
   memset(request, 0, request_len);
 
   // Create message:
   // [ op_code (char) ] | [ client_request_pipe_path (char[40]) ] | [ client_response_pipe_path (char[40]) ]
+  // | [ wire_version (char) ]
   create_message(request, &offset, &op_code, sizeof(char));
   create_message(request, &offset, &client_req_pipe_path, CLIENT_PIPE_MAX_LEN * sizeof(char));
   create_message(request, &offset, &client_resp_pipe_path, CLIENT_PIPE_MAX_LEN * sizeof(char));
+  create_message(request, &offset, &requested_wire_version, sizeof(char));
 
   // Connect to server and send request
   int server_fd = open(server_pipe_path, O_WRONLY);
@@ -56,18 +417,16 @@ int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const*
   close(server_fd);
 
   // Receive response
-  int response_fd = open(client_resp_pipe_path, O_RDONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
+  if (begin_response()) {
     return 1;
   }
   int session_id;
-  if (pipe_parse(response_fd, &session_id, sizeof(int))) {
+  if (receive_response(&session_id, sizeof(int)) || receive_response(&wire_version, sizeof(char))) {
     fprintf(stderr, "Failed to read session id from server.\n");
-    close(response_fd);
+    end_response();
     return 1;
   }
-  close(response_fd);
+  end_response();
 
   printf("Setup completed successfully. Session ID %d has been assigned.\n", session_id);
   return 0;
@@ -85,20 +444,21 @@ int ems_quit(void) {
   // [ op_code (char) ]
   create_message(request, &offset, &op_code, sizeof(char));
 
-  // Open request pipe and send request.
-  int client_req_fd = open(client_req_pipe_path, O_WRONLY);
-  if (client_req_fd < 0) {
-    fprintf(stderr, "Failed to open client request pipe.\n");
+  if (send_request(&request, request_len)) {
     return 1;
   }
-  if (pipe_print(client_req_fd, &request, request_len)) {
-    fprintf(stderr, "Failed to send setup request to server pipe.\n");
-    close(client_req_fd);
-    return 1;
+
+  free(payload_buffer);
+  payload_buffer = NULL;
+  payload_capacity = 0;
+  free_cached_events();
+
+  if (session_socket_fd != -1) {
+    close(session_socket_fd);
+    session_socket_fd = -1;
+    return 0;
   }
-  close(client_req_fd);
 
-  close(client_req_fd);
   unlink(client_req_pipe_path);
   unlink(client_resp_pipe_path);
 
@@ -109,184 +469,274 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   // Initialize variables
   char op_code = OP_CODE_CREATE_REQUEST;
 
-  size_t request_len = sizeof(char) + sizeof(unsigned int) + sizeof(size_t) + sizeof(size_t);
+  size_t request_len = sizeof(char) + sizeof(unsigned int) + size_len() + size_len();
   int8_t request[request_len];
   size_t offset = 0;
   memset(request, 0, request_len);
 
   // Create message:
-  // [ op_code (char) ] | [ event_id (unsigned int) ] | [ num_rows (size_t) ] | [ num_cols (size_t)]
+  // [ op_code (char) ] | [ event_id (unsigned int) ] | [ num_rows (size) ] | [ num_cols (size) ]
   create_message(request, &offset, &op_code, sizeof(char));
   create_message(request, &offset, &event_id, sizeof(unsigned int));
-  create_message(request, &offset, &num_rows, sizeof(size_t));
-  create_message(request, &offset, &num_cols, sizeof(size_t));
-
-  // Open request pipe and send request.
-  int client_req_fd = open(client_req_pipe_path, O_WRONLY);
-  if (client_req_fd < 0) {
-    fprintf(stderr, "Failed to open client request pipe.\n");
+  if (add_size(request, &offset, num_rows) || add_size(request, &offset, num_cols)) {
     return 1;
   }
-  if (pipe_print(client_req_fd, &request, request_len)) {
-    fprintf(stderr, "Failed to send setup request to server pipe.\n");
-    close(client_req_fd);
+
+  if (send_request(&request, request_len)) {
     return 1;
   }
-  close(client_req_fd);
 
   // Receive response
-  int response_fd = open(client_resp_pipe_path, O_RDONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
+  if (begin_response()) {
     return 1;
   }
   int result;
-  if (pipe_parse(response_fd, &result, sizeof(int))) {
+  if (receive_response(&result, sizeof(int))) {
     fprintf(stderr, "Failed to read result from server.\n");
-    close(response_fd);
+    end_response();
     return 1;
   }
-  close(response_fd);
+  end_response();
 
   printf("Event %s created.\n", result ? "failed to be" : "was");
   return 0;
 }
 
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+/// Sends a chunk of the seats of a reservation, of at most RESERVATION_CHUNK_SIZE seats.
+/// @param event_id Event of the reservation, NULL for every chunk but the last one.
+/// @param num_seats Number of seats in the chunk.
+/// @param xs Rows of the seats.
+/// @param ys Columns of the seats.
+/// @return 0 if successful, 1 otherwise.
+static int send_seat_chunk(const unsigned int* event_id, size_t num_seats, const size_t* xs, const size_t* ys) {
   // Initialize variables
-  char op_code = OP_CODE_RESERVE_REQUEST;
+  char op_code = event_id != NULL ? OP_CODE_RESERVE_REQUEST : OP_CODE_RESERVE_CHUNK_REQUEST;
 
-  size_t request_len =
-      sizeof(char) + sizeof(unsigned int) + sizeof(size_t) + sizeof(size_t) * num_seats + sizeof(size_t) * num_seats;
+  // Compact coordinates take at most VARINT_MAX_LEN bytes each
+  size_t coord_len = wire_version == WIRE_VERSION_COMPACT ? VARINT_MAX_LEN : sizeof(size_t);
+  size_t request_len = sizeof(char) + sizeof(unsigned int) + size_len() + size_len() + 2 * coord_len * num_seats;
 
   int8_t request[request_len];
   size_t offset = 0;
   memset(request, 0, request_len);
 
   // Create message:
-  // [ op_code (char) ] | [ event_id (unsigned int) ] | [ num_seats (size_t) ] | [ xs (size_t[num_seats]) ] | [ ys
-  // (size_t[num_seats]) ]
+  // [ op_code (char) ] | [ event_id (unsigned int), last chunk only ] | [ num_seats (size) ]
+  // | native: [ xs (size_t[num_seats]) ] | [ ys (size_t[num_seats]) ]
+  // | compact: [ coords_len (size) ] | [ xs (varint[num_seats]) ] | [ ys (varint[num_seats]) ]
   create_message(request, &offset, &op_code, sizeof(char));
-  create_message(request, &offset, &event_id, sizeof(unsigned int));
-  create_message(request, &offset, &num_seats, sizeof(size_t));
-  for (size_t i = 0; i < num_seats; i++) {
-    create_message(request, &offset, &xs[i], sizeof(size_t));
+  if (event_id != NULL) {
+    create_message(request, &offset, event_id, sizeof(unsigned int));
   }
-  for (size_t i = 0; i < num_seats; i++) {
-    create_message(request, &offset, &ys[i], sizeof(size_t));
+  if (add_size(request, &offset, num_seats)) {
+    return 1;
+  }
+  if (wire_version == WIRE_VERSION_COMPACT) {
+    size_t coords_len = coords_encode(xs, ys, num_seats, request + offset + size_len());
+    if (add_size(request, &offset, coords_len)) {
+      return 1;
+    }
+    offset += coords_len;
+  } else {
+    create_message(request, &offset, xs, sizeof(size_t) * num_seats);
+    create_message(request, &offset, ys, sizeof(size_t) * num_seats);
   }
 
-  // Open request pipe and send request.
-  int client_req_fd = open(client_req_pipe_path, O_WRONLY);
-  if (client_req_fd < 0) {
-    fprintf(stderr, "Failed to open client request pipe.\n");
+  return send_request(&request, offset);
+}
+
+int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  // Reservations larger than a request are streamed in chunks, the server reserving them all along with the last one
+  size_t sent = 0;
+  if (num_seats > RESERVATION_CHUNK_SIZE && begin_stream()) {
     return 1;
   }
-  if (pipe_print(client_req_fd, &request, request_len)) {
-    fprintf(stderr, "Failed to send setup request to server pipe.\n");
-    close(client_req_fd);
+  for (; num_seats - sent > RESERVATION_CHUNK_SIZE; sent += RESERVATION_CHUNK_SIZE) {
+    if (send_seat_chunk(NULL, RESERVATION_CHUNK_SIZE, xs + sent, ys + sent)) {
+      end_stream();
+      return 1;
+    }
+  }
+  int failed = send_seat_chunk(&event_id, num_seats - sent, xs + sent, ys + sent);
+  end_stream();
+  if (failed) {
     return 1;
   }
-  close(client_req_fd);
 
   // Receive response
-  int response_fd = open(client_resp_pipe_path, O_RDONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
+  if (begin_response()) {
     return 1;
   }
   int result;
-  if (pipe_parse(response_fd, &result, sizeof(int))) {
+  if (receive_response(&result, sizeof(int))) {
     fprintf(stderr, "Failed to read result from server.\n");
-    close(response_fd);
+    end_response();
     return 1;
   }
-  close(response_fd);
+  end_response();
 
   printf("Event %s reserved.\n", result ? "failed to be" : "was");
   return 0;
 }
 
-int ems_show(int out_fd, unsigned int event_id) {
+int ems_reserve_ranges(unsigned int event_id, size_t num_ranges, const seat_range_t* ranges) {
   // Initialize variables
-  char op_code = OP_CODE_SHOW_REQUEST;
+  char op_code = OP_CODE_RESERVE_RANGES_REQUEST;
+
+  // Compact corners take at most VARINT_MAX_LEN bytes each
+  size_t range_len = wire_version == WIRE_VERSION_COMPACT ? 4 * VARINT_MAX_LEN : sizeof(seat_range_t);
+  size_t request_len = sizeof(char) + sizeof(unsigned int) + size_len() + size_len() + range_len * num_ranges;
 
-  size_t request_len = sizeof(char) + sizeof(unsigned int);
   int8_t request[request_len];
   size_t offset = 0;
   memset(request, 0, request_len);
 
   // Create message:
-  // [ op_code (char) ] | [ event_id (unsigned int) ]
+  // [ op_code (char) ] | [ event_id (unsigned int) ] | [ num_ranges (size) ]
+  // | native: [ ranges (seat_range_t[num_ranges]) ]
+  // | compact: [ ranges_len (size) ] | [ ranges (varint[4 * num_ranges]) ]
   create_message(request, &offset, &op_code, sizeof(char));
   create_message(request, &offset, &event_id, sizeof(unsigned int));
-
-  // Open request pipe and send request.
-  int client_req_fd = open(client_req_pipe_path, O_WRONLY);
-  if (client_req_fd < 0) {
-    fprintf(stderr, "Failed to open client request pipe.\n");
+  if (add_size(request, &offset, num_ranges)) {
     return 1;
   }
-  if (pipe_print(client_req_fd, &request, request_len)) {
-    fprintf(stderr, "Failed to send setup request to server pipe.\n");
-    close(client_req_fd);
+  if (wire_version == WIRE_VERSION_COMPACT) {
+    size_t ranges_len = seat_ranges_encode(ranges, num_ranges, request + offset + size_len());
+    if (add_size(request, &offset, ranges_len)) {
+      return 1;
+    }
+    offset += ranges_len;
+  } else {
+    create_message(request, &offset, ranges, sizeof(seat_range_t) * num_ranges);
+  }
+
+  if (send_request(&request, offset)) {
     return 1;
   }
-  close(client_req_fd);
 
   // Receive response
-  int response_fd = open(client_resp_pipe_path, O_RDONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
+  if (begin_response()) {
     return 1;
   }
-
   int result;
-  if (pipe_parse(response_fd, &result, sizeof(int))) {
+  if (receive_response(&result, sizeof(int))) {
     fprintf(stderr, "Failed to read result from server.\n");
-    close(response_fd);
+    end_response();
     return 1;
   }
-  size_t num_rows;
-  if (pipe_parse(response_fd, &num_rows, sizeof(size_t))) {
-    fprintf(stderr, "Failed to read number of rows from server.\n");
-    close(response_fd);
+  end_response();
+
+  printf("Event %s reserved.\n", result ? "failed to be" : "was");
+  return 0;
+}
+
+int ems_show(int out_fd, unsigned int event_id) {
+  // Initialize variables
+  char op_code = OP_CODE_SHOW_SINCE_REQUEST;
+  unsigned int since = cached_event_version(event_id);
+
+  size_t request_len = sizeof(char) + sizeof(unsigned int) + sizeof(unsigned int) + sizeof(char);
+  int8_t request[request_len];
+  size_t offset = 0;
+  memset(request, 0, request_len);
+
+  // Create message:
+  // [ op_code (char) ] | [ event_id (unsigned int) ] | [ since (unsigned int) ] | [ encodings (char) ]
+  create_message(request, &offset, &op_code, sizeof(char));
+  create_message(request, &offset, &event_id, sizeof(unsigned int));
+  create_message(request, &offset, &since, sizeof(unsigned int));
+  create_message(request, &offset, &show_encodings, sizeof(char));
+
+  if (send_request(&request, request_len)) {
     return 1;
   }
-  size_t num_cols;
-  if (pipe_parse(response_fd, &num_cols, sizeof(size_t))) {
-    fprintf(stderr, "Failed to read number of cols from server.\n");
-    close(response_fd);
+
+  // Receive response
+  if (begin_response()) {
     return 1;
   }
 
-  unsigned int* seats;
-  seats = malloc(sizeof(unsigned int) * num_cols * num_rows);
-  if (!seats) {
-    perror("Memory allocation failed");
-    free(seats);
+  int result;
+  unsigned int version;
+  size_t num_rows, num_cols;
+  char format;
+  if (receive_response(&result, sizeof(int)) || receive_response(&version, sizeof(unsigned int)) ||
+      receive_response(&num_rows, sizeof(size_t)) || receive_response(&num_cols, sizeof(size_t)) ||
+      receive_response(&format, sizeof(char))) {
+    fprintf(stderr, "Failed to read event from server.\n");
+    end_response();
     return 1;
   }
-  for (size_t i = 0; i < num_cols * num_rows; i++) {
-    if (pipe_parse(response_fd, &seats[i], sizeof(unsigned int))) {
-      fprintf(stderr, "Failed to read seats from server.\n");
-      free(seats);
-      close(response_fd);
-      return 1;
+
+  if (result) {
+    end_response();
+    return 1;
+  }
+
+  struct CachedEvent* event = cache_event(event_id, num_rows, num_cols);
+  if (event == NULL) {
+    end_response();
+    return 1;
+  }
+
+  size_t num_seats = num_rows * num_cols;
+  int failed = 0;
+  if (format == SHOW_FORMAT_RAW) {
+    failed = num_seats > 0 && receive_response(event->seats, sizeof(unsigned int) * num_seats);
+  } else if (format == SHOW_FORMAT_RLE) {
+    // Decoded straight into the cached seats
+    size_t runs_len;
+    char* runs = NULL;
+    if (receive_response(&runs_len, sizeof(size_t)) == 0) {
+      runs = receive_response_array(runs_len, sizeof(char));
+    }
+    failed = runs == NULL || rle_decode_seats(runs, runs_len, event->seats, num_seats);
+  } else {
+    // Only the seats reserved since the cached version
+    size_t num_changes;
+    char* changes = NULL;
+    if (receive_response(&num_changes, sizeof(size_t)) == 0) {
+      changes = receive_response_array(num_changes, sizeof(size_t) + sizeof(unsigned int));
+    }
+    failed = changes == NULL;
+
+    if (!failed) {
+      size_t* seats = (size_t*)changes;
+      unsigned int* reservation_ids = (unsigned int*)(changes + sizeof(size_t) * num_changes);
+      for (size_t i = 0; i < num_changes && !failed; i++) {
+        failed = seats[i] >= num_seats;
+        if (!failed) {
+          event->seats[seats[i]] = reservation_ids[i];
+        }
+      }
     }
   }
 
-  if (result || print_event(out_fd, num_rows, num_cols, seats)) {
+  end_response();
+
+  if (failed) {
+    // The cached seats may be half updated, start over on the next show
+    fprintf(stderr, "Failed to read seats from server.\n");
+    memset(event->seats, 0, sizeof(unsigned int) * num_seats);
+    event->version = 0;
     return 1;
   }
+  event->version = version;
 
-  printf("Event %s shown.\n", result ? "failed to be" : "was");
+  write_buffer_init(&output, out_fd);
+  if (buffered_print_event(&output, num_rows, num_cols, event->seats) || write_buffer_flush(&output)) {
+    perror("Error writing to file descriptor");
+    return 1;
+  }
 
-  free(seats);
-  close(response_fd);
+  printf("Event %s shown.\n", result ? "failed to be" : "was");
   return 0;
 }
 
+void ems_set_wire_version(char version) { requested_wire_version = version; }
+
+void ems_set_show_encodings(char encodings) { show_encodings = encodings; }
+
 int ems_list_events(int out_fd) {
   char op_code = OP_CODE_LIST_REQUEST;
 
@@ -299,60 +749,336 @@ int ems_list_events(int out_fd) {
   // [ op_code (char) ]
   create_message(request, &offset, &op_code, sizeof(char));
 
-  // Open request pipe and send request.
-  int client_req_fd = open(client_req_pipe_path, O_WRONLY);
-  if (client_req_fd < 0) {
-    fprintf(stderr, "Failed to open client request pipe.\n");
+  if (send_request(&request, request_len)) {
     return 1;
   }
-  if (pipe_print(client_req_fd, &request, request_len)) {
-    fprintf(stderr, "Failed to send setup request to server pipe.\n");
-    close(client_req_fd);
-    return 1;
-  }
-  close(client_req_fd);
 
   // Receive response
-  int response_fd = open(client_resp_pipe_path, O_RDONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
+  if (begin_response()) {
     return 1;
   }
 
   int result;
-  if (pipe_parse(response_fd, &result, sizeof(int))) {
+  if (receive_response(&result, sizeof(int))) {
     fprintf(stderr, "Failed to read result from server.\n");
-    close(response_fd);
+    end_response();
     return 1;
   }
   size_t num_events;
-  if (pipe_parse(response_fd, &num_events, sizeof(size_t))) {
+  if (receive_response(&num_events, sizeof(size_t))) {
     fprintf(stderr, "Failed to read number of rows from server.\n");
-    close(response_fd);
+    end_response();
+    return 1;
+  }
+  if (result) {
+    end_response();
+    return 1;
+  }
+
+  unsigned int* ids = receive_response_array(num_events, sizeof(unsigned int));
+  if (ids == NULL) {
+    fprintf(stderr, "Failed to read ids from server.\n");
+    end_response();
+    return 1;
+  }
+
+  end_response();
+
+  write_buffer_init(&output, out_fd);
+  if (buffered_print_ids(&output, ids, num_events) || write_buffer_flush(&output)) {
+    perror("Error writing to file descriptor");
+    return 1;
+  }
+
+  printf("Event %s list.\n", result ? "failed to be" : "was");
+  return 0;
+}
+
+int ems_run_job(int in_fd, int out_fd) {
+  // The script is streamed in chunks, then run as a whole
+  if (begin_stream()) {
+    return 1;
+  }
+
+  // Create messages:
+  // [ op_code (char) ] | [ len (size) ] | [ script (char[len]) ], as many as needed
+  // [ op_code (char) ]
+  int8_t request[sizeof(char) + sizeof(size_t) + JOB_CHUNK_LEN];
+  size_t header_len = sizeof(char) + size_len();
+  char op_code = OP_CODE_JOB_CHUNK_REQUEST;
+  int failed = 0;
+  while (!failed) {
+    ssize_t len = read(in_fd, request + header_len, JOB_CHUNK_LEN);
+    if (len == -1 && errno == EINTR) {
+      continue;
+    }
+    if (len <= 0) {
+      failed = len < 0;
+      break;
+    }
+
+    size_t offset = 0;
+    create_message(request, &offset, &op_code, sizeof(char));
+    failed = add_size(request, &offset, (size_t)len) || send_request(request, header_len + (size_t)len);
+  }
+  op_code = OP_CODE_RUN_JOB_REQUEST;
+  failed = failed || send_request(&op_code, sizeof(char));
+  end_stream();
+  if (failed) {
+    fprintf(stderr, "Failed to send job.\n");
+    return 1;
+  }
+
+  // Receive response
+  if (begin_response()) {
+    return 1;
+  }
+  int result;
+  size_t num_commands, num_failed, out_len;
+  if (receive_response(&result, sizeof(int)) || receive_response(&num_commands, sizeof(size_t)) ||
+      receive_response(&num_failed, sizeof(size_t)) || receive_response(&out_len, sizeof(size_t))) {
+    fprintf(stderr, "Failed to read result from server.\n");
+    end_response();
+    return 1;
+  }
+
+  char* out = receive_response_array(out_len, sizeof(char));
+  end_response();
+  if (out == NULL) {
+    fprintf(stderr, "Failed to read job output from server.\n");
+    return 1;
+  }
+  if (out_len > 0 && pipe_print(out_fd, out, out_len)) {
+    perror("Error writing to file descriptor");
+    return 1;
+  }
+
+  if (result) {
+    printf("Job failed to be run.\n");
+  } else {
+    printf("Job ran %zu commands, %zu failed.\n", num_commands, num_failed);
+  }
+  return 0;
+}
+
+int ems_stats(int out_fd) {
+  char op_code = OP_CODE_STATS_REQUEST;
+  if (send_request(&op_code, sizeof(char))) {
+    return 1;
+  }
+
+  // Receive response
+  if (begin_response()) {
+    return 1;
+  }
+  int result;
+  size_t report_len;
+  if (receive_response(&result, sizeof(int)) || receive_response(&report_len, sizeof(size_t))) {
+    fprintf(stderr, "Failed to read result from server.\n");
+    end_response();
     return 1;
   }
-  unsigned int* ids;
-  ids = malloc(sizeof(unsigned int) * num_events);
-  if (!ids) {
+
+  char* report = receive_response_array(report_len, sizeof(char));
+  end_response();
+  if (report == NULL || result) {
+    fprintf(stderr, "Failed to read stats from server.\n");
+    return 1;
+  }
+  if (report_len > 0 && pipe_print(out_fd, report, report_len)) {
+    perror("Error writing to file descriptor");
+    return 1;
+  }
+  return 0;
+}
+
+/// Reads the next message of the subscription connection.
+/// @param notification Variable to store the notification in, NULL if the message answers a request.
+/// @param op_code Variable to store the op code of the request answered in.
+/// @param event_id Variable to store the event of the request answered in.
+/// @param result Variable to store the result of the request answered in.
+/// @return 0 if successful, 1 otherwise.
+static int read_subscription_message(struct ReadNotification** notification, char* op_code, unsigned int* event_id,
+                                     int* result) {
+  *notification = NULL;
+
+  char type;
+  if (packet_parse(&subscription_reader, &type, sizeof(char))) {
+    fprintf(stderr, "Failed to read notification from server.\n");
+    return 1;
+  }
+
+  if (type == OP_CODE_SUBSCRIBE_REQUEST || type == OP_CODE_UNSUBSCRIBE_REQUEST) {
+    // [ op_code (char) ] | [ event_id (unsigned int) ] | [ result (int) ]
+    *op_code = type;
+    return packet_parse(&subscription_reader, event_id, sizeof(unsigned int)) ||
+           packet_parse(&subscription_reader, result, sizeof(int));
+  }
+
+  if (type == NOTIFICATION_RESYNC) {
+    // [ type (char) ]
+    *notification = calloc(1, sizeof(struct ReadNotification));
+    if (*notification == NULL) {
+      perror("Memory allocation failed");
+      return 1;
+    }
+    (*notification)->notification.type = type;
+    return 0;
+  }
+
+  if (type != NOTIFICATION_RESERVATION) {
+    fprintf(stderr, "Unknown notification from server.\n");
+    return 1;
+  }
+
+  // [ type (char) ] | [ event_id (unsigned int) ] | [ reservation_id (unsigned int) ] | [ num_seats (size_t) ]
+  // | [ xs (size_t[num_seats]) ] | [ ys (size_t[num_seats]) ]
+  ems_notification_t header = {.type = type};
+  if (packet_parse(&subscription_reader, &header.event_id, sizeof(unsigned int)) ||
+      packet_parse(&subscription_reader, &header.reservation_id, sizeof(unsigned int)) ||
+      packet_parse(&subscription_reader, &header.num_seats, sizeof(size_t))) {
+    fprintf(stderr, "Failed to read notification from server.\n");
+    return 1;
+  }
+  if (header.num_seats > (SIZE_MAX - sizeof(struct ReadNotification)) / (2 * sizeof(size_t))) {
+    fprintf(stderr, "Notification is too large.\n");
+    return 1;
+  }
+
+  struct ReadNotification* read = malloc(sizeof(struct ReadNotification) + 2 * sizeof(size_t) * header.num_seats);
+  if (read == NULL) {
     perror("Memory allocation failed");
-    free(ids);
     return 1;
   }
+  read->notification = header;
+  read->notification.xs = read->seats;
+  read->notification.ys = read->seats + header.num_seats;
+  read->next = NULL;
+  if (packet_parse(&subscription_reader, read->seats, 2 * sizeof(size_t) * header.num_seats)) {
+    fprintf(stderr, "Failed to read notification from server.\n");
+    free(read);
+    return 1;
+  }
+
+  *notification = read;
+  return 0;
+}
+
+/// Sends a subscription request and waits for its answer, keeping the notifications that come before it.
+/// @param op_code Op code of the request.
+/// @param event_id Event of the request.
+/// @return Result of the request, 1 on failure.
+static int subscription_request(char op_code, unsigned int event_id) {
+  // [ op_code (char) ] | [ event_id (unsigned int) ]
+  char request[sizeof(char) + sizeof(unsigned int)];
+  size_t offset = 0;
+  create_message(request, &offset, &op_code, sizeof(char));
+  create_message(request, &offset, &event_id, sizeof(unsigned int));
+  if (packet_print(subscription_fd, request, sizeof(request))) {
+    fprintf(stderr, "Failed to send request to server socket.\n");
+    return 1;
+  }
+
+  while (1) {
+    struct ReadNotification* notification;
+    char answered_op_code;
+    unsigned int answered_event_id;
+    int result;
+    if (read_subscription_message(&notification, &answered_op_code, &answered_event_id, &result)) {
+      return 1;
+    }
+
+    if (notification == NULL) {
+      if (answered_op_code == op_code && answered_event_id == event_id) {
+        return result;
+      }
+      continue;
+    }
+
+    if (last_queued_notification == NULL) {
+      queued_notifications = notification;
+    } else {
+      last_queued_notification->next = notification;
+    }
+    last_queued_notification = notification;
+  }
+}
 
-  for (size_t i = 0; i < num_events; i++) {
-    if (pipe_parse(response_fd, &ids[i], sizeof(unsigned int))) {
-      fprintf(stderr, "Failed to read ids from server.\n");
-      free(ids);
-      close(response_fd);
+int ems_subscribe(char const* server_address, unsigned int event_id) {
+  if (subscription_fd == -1) {
+    char const* socket_path = socket_address_path(server_address);
+    if (socket_path == NULL) {
+      fprintf(stderr, "Subscriptions need a socket address.\n");
       return 1;
     }
+
+    // The first request of the connection makes it a subscription connection instead of a session
+    subscription_fd = socket_connect(socket_path);
+    if (subscription_fd < 0) {
+      return 1;
+    }
+    packet_reader_init(&subscription_reader, subscription_fd);
   }
 
-  if (result || print_ids(ids, num_events, out_fd)) {
+  int result = subscription_request(OP_CODE_SUBSCRIBE_REQUEST, event_id);
+  printf("Event %s subscribed.\n", result ? "failed to be" : "was");
+  return result;
+}
+
+int ems_unsubscribe(unsigned int event_id) {
+  if (subscription_fd == -1) {
     return 1;
   }
 
-  printf("Event %s list.\n", result ? "failed to be" : "was");
+  int result = subscription_request(OP_CODE_UNSUBSCRIBE_REQUEST, event_id);
+  printf("Event %s unsubscribed.\n", result ? "failed to be" : "was");
+  return result;
+}
+
+int ems_next_notification(ems_notification_t* notification) {
+  if (subscription_fd == -1) {
+    return 1;
+  }
+
+  free(current_notification);
+  current_notification = NULL;
 
+  if (queued_notifications != NULL) {
+    current_notification = queued_notifications;
+    queued_notifications = queued_notifications->next;
+    if (queued_notifications == NULL) {
+      last_queued_notification = NULL;
+    }
+  }
+
+  // Answers to requests nobody waits for anymore are skipped
+  while (current_notification == NULL) {
+    char op_code;
+    unsigned int event_id;
+    int result;
+    if (read_subscription_message(&current_notification, &op_code, &event_id, &result)) {
+      return 1;
+    }
+  }
+
+  *notification = current_notification->notification;
   return 0;
 }
+
+void ems_close_subscriptions(void) {
+  if (subscription_fd == -1) {
+    return;
+  }
+
+  close(subscription_fd);
+  subscription_fd = -1;
+
+  free(current_notification);
+  current_notification = NULL;
+  while (queued_notifications != NULL) {
+    struct ReadNotification* next = queued_notifications->next;
+    free(queued_notifications);
+    queued_notifications = next;
+  }
+  last_queued_notification = NULL;
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "common/io.h"
+
 /// Connects to an EMS server.
 /// @param req_pipe_path Path to the name pipe to be created for requests.
 /// @param resp_pipe_path Path to the name pipe to be created for responses.
@@ -21,7 +23,8 @@ int ems_quit(void);
 /// @return 0 if the event was created successfully, 1 otherwise.
 int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 
-/// Creates a new reservation for the given event.
+/// Creates a new reservation for the given event. Reservations of more than RESERVATION_CHUNK_SIZE seats are streamed
+/// in chunks, and still reserved as a whole or not at all. The server refuses ones of more than RESERVATION_MAX_SEATS.
 /// @param event_id Id of the event to create a reservation for.
 /// @param num_seats Number of seats to reserve.
 /// @param xs Array of rows of the seats to reserve.
@@ -29,15 +32,73 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
+/// Creates a new reservation for blocks of seats of the given event, sent as ranges and expanded by the server.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_ranges Number of blocks of seats to reserve.
+/// @param ranges Blocks of seats to reserve.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_ranges(unsigned int event_id, size_t num_ranges, const seat_range_t* ranges);
+
 /// Prints the given event to the given file.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
 int ems_show(int out_fd, unsigned int event_id);
 
+/// Chooses the wire encoding asked for by the next setups, the server may settle for an older one.
+/// @param version One of the WIRE_VERSION_ values, WIRE_VERSION_LATEST by default.
+void ems_set_wire_version(char version);
+
+/// Chooses the encodings SHOW accepts for whole seat grids, sent raw when none is accepted or none is shorter.
+/// @param encodings Combination of SHOW_ENCODING_ flags, none by default.
+void ems_set_show_encodings(char encodings);
+
 /// Prints all the events to the given file.
 /// @param out_fd File descriptor to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int out_fd);
 
+/// Sends a whole job script to be run by the server, which answers with the output of all of its commands at once.
+/// @param in_fd File descriptor to read the script from.
+/// @param out_fd File descriptor to print the output of the commands to.
+/// @return 0 if the job was run successfully, 1 otherwise.
+int ems_run_job(int in_fd, int out_fd);
+
+/// Prints the latencies the server measured since it started, per stage of serving requests, as CSV:
+/// stage,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us
+/// @param out_fd File descriptor to print the latencies to.
+/// @return 0 if the latencies were printed successfully, 1 otherwise.
+int ems_stats(int out_fd);
+
+// Change to a subscribed event
+typedef struct {
+  char type;                    // NOTIFICATION_RESERVATION, or NOTIFICATION_RESYNC when notifications were dropped
+  unsigned int event_id;        // Event the reservation was made for
+  unsigned int reservation_id;  // Id of the reservation, which is also the version of the event it led to
+  size_t num_seats;             // Number of reserved seats
+  size_t* xs;                   // Rows of the seats, valid until the next notification is read
+  size_t* ys;                   // Columns of the seats, valid until the next notification is read
+} ems_notification_t;
+
+/// Subscribes to the reservations of an event, through a connection of its own opened on the first subscription.
+/// @note Subscriptions need a socket address. Reservations made before the subscription may still be notified, and
+/// a resync asks for every subscribed event to be shown again.
+/// @param server_address Address where the server is listening.
+/// @param event_id Id of the event to subscribe to.
+/// @return 0 if the subscription was made successfully, 1 otherwise.
+int ems_subscribe(char const* server_address, unsigned int event_id);
+
+/// Stops receiving the reservations of an event.
+/// @param event_id Id of the event to unsubscribe from.
+/// @return 0 if the subscription was removed successfully, 1 otherwise.
+int ems_unsubscribe(unsigned int event_id);
+
+/// Waits for the next notification of the subscribed events.
+/// @param notification Variable to store the notification in.
+/// @return 0 if a notification was read successfully, 1 otherwise.
+int ems_next_notification(ems_notification_t* notification);
+
+/// Closes the subscription connection, dropping every subscription.
+void ems_close_subscriptions(void);
+
 #endif  // CLIENT_API_H
@@ -0,0 +1,54 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "jobfile.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s <.jobs file path> [.jobc file path]\n", argv[0]);
+    return 1;
+  }
+
+  // The compiled job goes next to the text one unless told otherwise
+  char out_path[MAX_JOB_FILE_NAME_SIZE];
+  const char *dot = strrchr(argv[1], '.');
+  if (argc > 2) {
+    if (strlen(argv[2]) >= MAX_JOB_FILE_NAME_SIZE) {
+      fprintf(stderr, "The provided .jobc file path is not valid. Path: %s\n", argv[2]);
+      return 1;
+    }
+    strcpy(out_path, argv[2]);
+  } else {
+    if (dot == NULL || strcmp(dot, ".jobs") != 0 || strlen(argv[1]) >= MAX_JOB_FILE_NAME_SIZE) {
+      fprintf(stderr, "The provided .jobs file path is not valid. Path: %s\n", argv[1]);
+      return 1;
+    }
+    strcpy(out_path, argv[1]);
+    strcpy(strrchr(out_path, '.'), ".jobc");
+  }
+
+  int in_fd = open(argv[1], O_RDONLY);
+  if (in_fd == -1) {
+    fprintf(stderr, "Failed to open input file. Path: %s\n", argv[1]);
+    return 1;
+  }
+
+  int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (out_fd == -1) {
+    fprintf(stderr, "Failed to open output file. Path: %s\n", out_path);
+    close(in_fd);
+    return 1;
+  }
+
+  int failed = compile_job(in_fd, out_fd);
+  if (failed) {
+    fprintf(stderr, "Failed to compile job. Path: %s\n", argv[1]);
+    unlink(out_path);
+  }
+  close(in_fd);
+  close(out_fd);
+  return failed;
+}
@@ -0,0 +1,300 @@
+#include "jobfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+
+int job_reader_open(job_reader_t *reader, int fd) {
+  memset(reader, 0, sizeof(job_reader_t));
+  reader->fd = fd;
+
+  // Anything without the magic, pipes included, is read as text
+  char magic[JOB_FILE_MAGIC_LEN];
+  if (pread(fd, magic, JOB_FILE_MAGIC_LEN, 0) != JOB_FILE_MAGIC_LEN ||
+      memcmp(magic, JOB_FILE_MAGIC, JOB_FILE_MAGIC_LEN) != 0) {
+    return 0;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror("Failed to read job file");
+    return 1;
+  }
+  reader->map_len = (size_t)st.st_size;
+  reader->map = mmap(NULL, reader->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (reader->map == MAP_FAILED) {
+    perror("Failed to map job file");
+    reader->map = NULL;
+    return 1;
+  }
+  posix_madvise(reader->map, reader->map_len, POSIX_MADV_SEQUENTIAL);
+
+  // The mapping starts at a page, so the words past the magic are aligned
+  reader->words = (const uint32_t *)(void *)((char *)reader->map + JOB_FILE_MAGIC_LEN);
+  reader->num_words = (reader->map_len - JOB_FILE_MAGIC_LEN) / sizeof(uint32_t);
+  return 0;
+}
+
+void job_reader_close(job_reader_t *reader) {
+  if (reader->map != NULL) {
+    munmap(reader->map, reader->map_len);
+    reader->map = NULL;
+    reader->words = NULL;
+  }
+}
+
+/// Takes the next words of the current command of a compiled job.
+/// @param reader Reader of the job.
+/// @param count Number of words to take.
+/// @return The words taken, NULL if the job ends before them, in which case it ends there.
+static const uint32_t *take_words(job_reader_t *reader, size_t count) {
+  if (count > reader->num_words - reader->next) {
+    reader->next = reader->num_words;
+    return NULL;
+  }
+
+  const uint32_t *words = reader->words + reader->next;
+  reader->next += count;
+  return words;
+}
+
+enum Command job_next(job_reader_t *reader) {
+  if (reader->words == NULL) {
+    return get_next(reader->fd);
+  }
+
+  const uint32_t *op = take_words(reader, 1);
+  if (op == NULL) {
+    return EOC;
+  }
+
+  reader->malformed = (*op & JOB_OP_MALFORMED) != 0;
+  switch (*op & ~JOB_OP_MALFORMED) {
+    case JOB_OP_CREATE:
+      return CMD_CREATE;
+    case JOB_OP_RESERVE:
+      return CMD_RESERVE;
+    case JOB_OP_SHOW:
+      return CMD_SHOW;
+    case JOB_OP_LIST:
+      return CMD_LIST_EVENTS;
+    case JOB_OP_WAIT:
+      return CMD_WAIT;
+    case JOB_OP_HELP:
+      return CMD_HELP;
+    default:
+      return CMD_INVALID;
+  }
+}
+
+int job_parse_create(job_reader_t *reader, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
+  if (reader->words == NULL) {
+    return parse_create(reader->fd, event_id, num_rows, num_cols);
+  }
+
+  const uint32_t *args = reader->malformed ? NULL : take_words(reader, 3);
+  if (args == NULL) {
+    return 1;
+  }
+
+  *event_id = args[0];
+  *num_rows = args[1];
+  *num_cols = args[2];
+  return 0;
+}
+
+size_t job_parse_reserve(job_reader_t *reader, unsigned int *event_id, seat_range_t **ranges, size_t *capacity) {
+  if (reader->words == NULL) {
+    return parse_reserve(reader->fd, event_id, ranges, capacity);
+  }
+
+  const uint32_t *args = reader->malformed ? NULL : take_words(reader, 2);
+  if (args == NULL || args[1] == 0) {
+    return 0;
+  }
+
+  *event_id = args[0];
+  size_t num_ranges = args[1];
+  if (num_ranges > *capacity) {
+    seat_range_t *new_ranges = realloc(*ranges, sizeof(seat_range_t) * num_ranges);
+    if (new_ranges == NULL) {
+      return 0;
+    }
+    *ranges = new_ranges;
+    *capacity = num_ranges;
+  }
+
+  for (size_t i = 0; i < num_ranges; i++) {
+    seat_range_t *range = &(*ranges)[i];
+    const uint32_t *seat = take_words(reader, 2);
+    if (seat == NULL) {
+      return 0;
+    }
+    range->first_row = seat[0] & ~JOB_BLOCK_FLAG;
+    range->first_col = seat[1];
+
+    const uint32_t *last = (seat[0] & JOB_BLOCK_FLAG) != 0 ? take_words(reader, 2) : seat;
+    if (last == NULL) {
+      return 0;
+    }
+    range->last_row = last[0] & ~JOB_BLOCK_FLAG;
+    range->last_col = last[1];
+  }
+  return num_ranges;
+}
+
+int job_parse_show(job_reader_t *reader, unsigned int *event_id) {
+  if (reader->words == NULL) {
+    return parse_show(reader->fd, event_id);
+  }
+
+  const uint32_t *args = reader->malformed ? NULL : take_words(reader, 1);
+  if (args == NULL) {
+    return 1;
+  }
+
+  *event_id = args[0];
+  return 0;
+}
+
+int job_parse_wait(job_reader_t *reader, unsigned int *delay, unsigned int *thread_id) {
+  if (reader->words == NULL) {
+    return parse_wait(reader->fd, delay, thread_id);
+  }
+
+  const uint32_t *args = reader->malformed ? NULL : take_words(reader, 2);
+  if (args == NULL) {
+    return -1;
+  }
+
+  *delay = args[0];
+  if (thread_id == NULL || args[1] == 0) {
+    return 0;
+  }
+  *thread_id = args[1];
+  return 1;
+}
+
+/// Writes words of a compiled job.
+/// @param out Buffer to write to.
+/// @param words Words to write.
+/// @param num_words Number of words.
+/// @return 0 if successful, 1 otherwise.
+static int print_words(write_buffer_t *out, const uint32_t *words, size_t num_words) {
+  return buffered_print(out, words, sizeof(uint32_t) * num_words);
+}
+
+/// Compiles the blocks of a RESERVE command.
+/// @param out Buffer to write to.
+/// @param event_id Id of the event.
+/// @param ranges Blocks of seats.
+/// @param num_ranges Number of blocks.
+/// @return 0 if successful, 1 otherwise.
+static int compile_reserve(write_buffer_t *out, unsigned int event_id, const seat_range_t *ranges, size_t num_ranges) {
+  uint32_t header[] = {JOB_OP_RESERVE, event_id, (uint32_t)num_ranges};
+  if (num_ranges > UINT32_MAX || print_words(out, header, 3)) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < num_ranges; i++) {
+    const seat_range_t *range = &ranges[i];
+    if (range->first_row >= JOB_BLOCK_FLAG || range->last_row >= JOB_BLOCK_FLAG) {
+      fprintf(stderr, "Row too large to be compiled: %zu\n", range->first_row);
+      return 1;
+    }
+
+    int block = range->first_row != range->last_row || range->first_col != range->last_col;
+    uint32_t seat[] = {(uint32_t)range->first_row | (block ? JOB_BLOCK_FLAG : 0), (uint32_t)range->first_col,
+                       (uint32_t)range->last_row, (uint32_t)range->last_col};
+    if (print_words(out, seat, block ? 4 : 2)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int compile_job(int in_fd, int out_fd) {
+  write_buffer_t out;
+  write_buffer_init(&out, out_fd);
+
+  // Blocks of the RESERVE commands, grown to fit the largest one
+  seat_range_t *ranges = NULL;
+  size_t ranges_capacity = 0;
+
+  int failed = buffered_print(&out, JOB_FILE_MAGIC, JOB_FILE_MAGIC_LEN);
+  enum Command command;
+  while (!failed && (command = get_next(in_fd)) != EOC) {
+    unsigned int event_id, delay;
+    size_t num_rows, num_columns, num_ranges;
+    uint32_t op = JOB_OP_MALFORMED;
+
+    switch (command) {
+      case CMD_CREATE:
+        if (parse_create(in_fd, &event_id, &num_rows, &num_columns) != 0) {
+          op |= JOB_OP_CREATE;
+          break;
+        }
+
+        uint32_t create[] = {JOB_OP_CREATE, event_id, (uint32_t)num_rows, (uint32_t)num_columns};
+        failed = print_words(&out, create, 4);
+        continue;
+
+      case CMD_RESERVE:
+        num_ranges = parse_reserve(in_fd, &event_id, &ranges, &ranges_capacity);
+        if (num_ranges == 0) {
+          op |= JOB_OP_RESERVE;
+          break;
+        }
+
+        failed = compile_reserve(&out, event_id, ranges, num_ranges);
+        continue;
+
+      case CMD_SHOW:
+        if (parse_show(in_fd, &event_id) != 0) {
+          op |= JOB_OP_SHOW;
+          break;
+        }
+
+        uint32_t show[] = {JOB_OP_SHOW, event_id};
+        failed = print_words(&out, show, 2);
+        continue;
+
+      case CMD_WAIT:
+        // Threads are left out, as they are when this client parses the job
+        if (parse_wait(in_fd, &delay, NULL) == -1) {
+          op |= JOB_OP_WAIT;
+          break;
+        }
+
+        uint32_t wait[] = {JOB_OP_WAIT, delay, 0};
+        failed = print_words(&out, wait, 3);
+        continue;
+
+      case CMD_LIST_EVENTS:
+        op = JOB_OP_LIST;
+        break;
+
+      case CMD_HELP:
+        op = JOB_OP_HELP;
+        break;
+
+      case CMD_INVALID:
+        op = JOB_OP_INVALID;
+        break;
+
+      case CMD_EMPTY:
+      case EOC:
+        continue;
+    }
+
+    failed = print_words(&out, &op, 1);
+  }
+
+  free(ranges);
+  return failed || write_buffer_flush(&out);
+}
@@ -0,0 +1,82 @@
+#ifndef CLIENT_JOBFILE_H
+#define CLIENT_JOBFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/io.h"
+#include "parser.h"
+
+// A compiled job is JOB_FILE_MAGIC followed by its commands as 32-bit words in host byte order, so a mapped file is
+// read in place. Each command is an op word followed by its arguments:
+//   JOB_OP_CREATE   <event id> <rows> <columns>
+//   JOB_OP_RESERVE  <event id> <blocks>, then each block as <row> <column>, with JOB_BLOCK_FLAG set on the row of
+//                   blocks larger than a seat, which go on with <last row> <last column>
+//   JOB_OP_SHOW     <event id>
+//   JOB_OP_WAIT     <delay> <thread id, 0 when none>
+//   JOB_OP_LIST, JOB_OP_BARRIER, JOB_OP_HELP and JOB_OP_INVALID have none
+// Commands whose arguments failed to parse keep their op with JOB_OP_MALFORMED set, and no arguments. Empty lines and
+// comments are left out.
+#define JOB_FILE_MAGIC "EMSJOBC1"
+#define JOB_FILE_MAGIC_LEN 8
+
+#define JOB_OP_CREATE 'C'
+#define JOB_OP_RESERVE 'R'
+#define JOB_OP_SHOW 'S'
+#define JOB_OP_LIST 'L'
+#define JOB_OP_WAIT 'W'
+#define JOB_OP_BARRIER 'B'  // Only run by the first part of the project, an invalid command here
+#define JOB_OP_HELP 'H'
+#define JOB_OP_INVALID 'I'
+#define JOB_OP_MALFORMED 0x100u
+#define JOB_BLOCK_FLAG 0x80000000u
+
+// Reads the commands of a job file, either compiled or text.
+typedef struct {
+  int fd;                 // Job file, read through the parser when it's text
+  const uint32_t *words;  // Commands of a compiled job, past its header. NULL for text jobs
+  size_t num_words;
+  size_t next;    // Word the rest of the current command starts at
+  int malformed;  // Whether the arguments of the current command failed to parse when it was compiled
+  void *map;
+  size_t map_len;
+} job_reader_t;
+
+/// Sets up a reader for a job file, mapping the file if it's compiled.
+/// @param reader Reader to set up.
+/// @param fd File descriptor of the job file, at its start.
+/// @return 0 if successful, 1 otherwise.
+int job_reader_open(job_reader_t *reader, int fd);
+
+/// Releases the mapping of a compiled job file. The file descriptor is left open.
+/// @param reader Reader to release.
+void job_reader_close(job_reader_t *reader);
+
+/// Reads the next command of a job file, as get_next does for text.
+/// @param reader Reader of the job file.
+/// @return The command read.
+enum Command job_next(job_reader_t *reader);
+
+/// Reads the arguments of a CREATE command, as parse_create does for text.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int job_parse_create(job_reader_t *reader, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
+
+/// Reads the arguments of a RESERVE command, as parse_reserve does for text.
+/// @return Number of blocks read. 0 on failure.
+size_t job_parse_reserve(job_reader_t *reader, unsigned int *event_id, seat_range_t **ranges, size_t *capacity);
+
+/// Reads the arguments of a SHOW command, as parse_show does for text.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int job_parse_show(job_reader_t *reader, unsigned int *event_id);
+
+/// Reads the arguments of a WAIT command, as parse_wait does for text.
+/// @return 0 if no thread was specified, 1 if a thread was specified, -1 on error.
+int job_parse_wait(job_reader_t *reader, unsigned int *delay, unsigned int *thread_id);
+
+/// Compiles a text job file.
+/// @param in_fd File descriptor of the text job.
+/// @param out_fd File descriptor to write the compiled job to.
+/// @return 0 if successful, 1 otherwise.
+int compile_job(int in_fd, int out_fd);
+
+#endif  // CLIENT_JOBFILE_H
@@ -0,0 +1,168 @@
+#include "jobs.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "common/constants.h"
+#include "jobfile.h"
+#include "parser.h"
+
+/// Expands blocks of seats into the coordinates of their seats, row by row.
+/// @param ranges Blocks of seats.
+/// @param num_ranges Number of blocks.
+/// @param xs Pointer to the array to store the rows in, grown with realloc as needed.
+/// @param ys Pointer to the array to store the columns in, grown with realloc as needed.
+/// @param capacity Pointer to the number of seats the arrays have room for.
+/// @return Number of seats. 0 if a block is reversed or the seats don't fit in memory.
+static size_t expand_ranges(const seat_range_t* ranges, size_t num_ranges, size_t** xs, size_t** ys,
+                            size_t* capacity) {
+  size_t num_seats = 0;
+  for (size_t i = 0; i < num_ranges; i++) {
+    const seat_range_t* range = &ranges[i];
+    if (range->first_row > range->last_row || range->first_col > range->last_col) {
+      return 0;
+    }
+    size_t rows = range->last_row - range->first_row + 1, cols = range->last_col - range->first_col + 1;
+    if (cols > SIZE_MAX / sizeof(size_t) / rows || rows * cols > SIZE_MAX / sizeof(size_t) - num_seats) {
+      return 0;
+    }
+    num_seats += rows * cols;
+  }
+
+  if (num_seats > *capacity) {
+    size_t* new_xs = realloc(*xs, sizeof(size_t) * num_seats);
+    if (new_xs == NULL) {
+      return 0;
+    }
+    *xs = new_xs;
+    size_t* new_ys = realloc(*ys, sizeof(size_t) * num_seats);
+    if (new_ys == NULL) {
+      return 0;
+    }
+    *ys = new_ys;
+    *capacity = num_seats;
+  }
+
+  size_t seat = 0;
+  for (size_t i = 0; i < num_ranges; i++) {
+    for (size_t row = ranges[i].first_row; row <= ranges[i].last_row; row++) {
+      for (size_t col = ranges[i].first_col; col <= ranges[i].last_col; col++) {
+        (*xs)[seat] = row;
+        (*ys)[seat] = col;
+        seat++;
+      }
+    }
+  }
+  return num_seats;
+}
+
+int run_job(int in_fd, int out_fd) {
+  job_reader_t job;
+  if (job_reader_open(&job, in_fd)) {
+    return 1;
+  }
+
+  // Seats of the RESERVE commands, grown to fit the largest one
+  seat_range_t* ranges = NULL;
+  size_t *xs = NULL, *ys = NULL;
+  size_t ranges_capacity = 0, seats_capacity = 0;
+
+  while (1) {
+    unsigned int event_id;
+    size_t num_rows, num_columns, num_coords;
+    unsigned int delay = 0;
+
+    switch (job_next(&job)) {
+      case CMD_CREATE:
+        if (job_parse_create(&job, &event_id, &num_rows, &num_columns) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_create(event_id, num_rows, num_columns)) fprintf(stderr, "Failed to create event\n");
+        break;
+
+      case CMD_RESERVE:
+        num_coords = job_parse_reserve(&job, &event_id, &ranges, &ranges_capacity);
+
+        if (num_coords == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        // Blocks are sent as ranges while they fit in a single request, each taking the room of two seats. Lists of
+        // single seats, and blocks too many for a request, are sent as coordinates, streamed in chunks when needed.
+        size_t num_blocks = 0;
+        for (size_t i = 0; i < num_coords; i++) {
+          num_blocks += ranges[i].first_row != ranges[i].last_row || ranges[i].first_col != ranges[i].last_col;
+        }
+
+        if (num_blocks > 0 && num_coords <= RESERVATION_CHUNK_SIZE / 2) {
+          if (ems_reserve_ranges(event_id, num_coords, ranges)) {
+            fprintf(stderr, "Failed to reserve seats\n");
+          }
+          break;
+        }
+
+        size_t num_seats = expand_ranges(ranges, num_coords, &xs, &ys, &seats_capacity);
+        if (num_seats == 0 || ems_reserve(event_id, num_seats, xs, ys)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
+      case CMD_SHOW:
+        if (job_parse_show(&job, &event_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_show(out_fd, event_id)) fprintf(stderr, "Failed to show event\n");
+        break;
+
+      case CMD_LIST_EVENTS:
+        if (ems_list_events(out_fd)) fprintf(stderr, "Failed to list events\n");
+        break;
+
+      case CMD_WAIT:
+        if (job_parse_wait(&job, &delay, NULL) == -1) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (delay > 0) {
+          printf("Waiting...\n");
+          sleep(delay);
+        }
+        break;
+
+      case CMD_INVALID:
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        break;
+
+      case CMD_HELP:
+        printf(
+            "Available commands:\n"
+            "  CREATE <event_id> <num_rows> <num_columns>\n"
+            "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>)-(<x3>,<y3>) ...]\n"
+            "  SHOW <event_id>\n"
+            "  LIST\n"
+            "  WAIT <delay_ms>\n"
+            "  HELP\n");
+
+        break;
+
+      case CMD_EMPTY:
+        break;
+
+      case EOC:
+        job_reader_close(&job);
+        free(ranges);
+        free(xs);
+        free(ys);
+        return 0;
+    }
+  }
+}
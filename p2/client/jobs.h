@@ -0,0 +1,10 @@
+#ifndef CLIENT_JOBS_H
+#define CLIENT_JOBS_H
+
+/// Runs the commands of a job file one by one, each a request to the server.
+/// @param in_fd File descriptor of the job file, either compiled or text.
+/// @param out_fd File descriptor to write the output of the commands to.
+/// @return 0 once every command was run, 1 if the job file couldn't be read.
+int run_job(int in_fd, int out_fd);
+
+#endif  // CLIENT_JOBS_H
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "common/io.h"
+
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
@@ -28,14 +30,14 @@ enum Command get_next(int fd);
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
 
-/// Parses a RESERVE command.
+/// Parses a RESERVE command, whose seats are single coordinates, (<x>,<y>), or blocks, (<x1>,<y1>)-(<x2>,<y2>).
 /// @param fd File descriptor to read from.
-/// @param max Maximum number of coordinates to read.
 /// @param event_id Pointer to the variable to store the event ID in.
-/// @param xs Pointer to the array to store the X coordinates in.
-/// @param ys Pointer to the array to store the Y coordinates in.
-/// @return Number of coordinates read. 0 on failure.
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
+/// @param ranges Pointer to the array to store the blocks in, single coordinates as 1x1 blocks. It's grown with
+/// realloc to fit every block of the command, and may be kept for the next commands.
+/// @param capacity Pointer to the number of blocks the array has room for.
+/// @return Number of blocks read. 0 on failure.
+size_t parse_reserve(int fd, unsigned int *event_id, seat_range_t **ranges, size_t *capacity);
 
 /// Parses a SHOW command.
 /// @param fd File descriptor to read from.
@@ -0,0 +1,16 @@
+#include "clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+long long clock_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void clock_sleep_until(long long time_ns) {
+  struct timespec ts = {(time_t)(time_ns / 1000000000LL), (long)(time_ns % 1000000000LL)};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
@@ -0,0 +1,12 @@
+#ifndef COMMON_CLOCK_H
+#define COMMON_CLOCK_H
+
+/// Gets the current time of the monotonic clock every latency is measured with.
+/// @return Time in nanoseconds.
+long long clock_now_ns(void);
+
+/// Sleeps until a time of the monotonic clock.
+/// @param time_ns Time to wake up at, in nanoseconds.
+void clock_sleep_until(long long time_ns);
+
+#endif  // COMMON_CLOCK_H
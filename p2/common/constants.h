@@ -1,4 +1,5 @@
-#define MAX_RESERVATION_SIZE 256
+#define RESERVATION_CHUNK_SIZE 1024  // Most seats sent per request, so one fits a socket record in either encoding
+#define RESERVATION_MAX_SEATS (1 << 20)  // Most seats of a reservation a session buffers, larger ones fail
 #define STATE_ACCESS_DELAY_US 500000  // 500ms
 #define MAX_JOB_FILE_NAME_SIZE 256
 #define MAX_SESSION_COUNT 8
@@ -6,6 +7,13 @@
 // Lenghts
 #define CLIENT_PIPE_MAX_LEN 40
 #define OP_CODE_LEN 1
+#define PACKET_MAX_LEN 32768  // Largest record sent through a socket session
+#define WRITE_BUFFER_LEN 65536  // Output gathered before each write
+#define VARINT_MAX_LEN 10       // Longest LEB128 encoding of a 64-bit value
+#define JOB_CHUNK_LEN 16384     // Most bytes of a job script sent per request
+
+// Server address prefix that selects the Unix socket transport instead of FIFOs
+#define SOCKET_ADDRESS_PREFIX "unix:"
 
 // OP codes
 #define OP_CODE_SETUP_REQUEST '1'
@@ -14,3 +22,29 @@
 #define OP_CODE_RESERVE_REQUEST '4'
 #define OP_CODE_SHOW_REQUEST '5'
 #define OP_CODE_LIST_REQUEST '6'
+#define OP_CODE_SHOW_SINCE_REQUEST '7'
+#define OP_CODE_SUBSCRIBE_REQUEST '8'
+#define OP_CODE_UNSUBSCRIBE_REQUEST '9'
+#define OP_CODE_RESERVE_RANGES_REQUEST 'A'
+#define OP_CODE_RESERVE_CHUNK_REQUEST 'B'
+#define OP_CODE_JOB_CHUNK_REQUEST 'C'
+#define OP_CODE_RUN_JOB_REQUEST 'D'
+#define OP_CODE_STATS_REQUEST 'E'
+
+// Wire encodings of the requests, the client asks for one at setup and the server answers with the one it speaks
+#define WIRE_VERSION_NATIVE 0   // Dimensions, counts and coordinates as native size_t
+#define WIRE_VERSION_COMPACT 1  // Dimensions and counts as 32-bit fields, coordinates as LEB128 varints
+#define WIRE_VERSION_LATEST WIRE_VERSION_COMPACT
+
+// Encodings a SHOW_SINCE request accepts for a whole seat grid, besides raw
+#define SHOW_ENCODING_RLE 1
+
+// Formats of a SHOW_SINCE response
+#define SHOW_FORMAT_DELTA 0  // Seats reserved since the version of the request
+#define SHOW_FORMAT_RAW 1    // Every seat
+#define SHOW_FORMAT_RLE 2    // Every seat, run-length encoded
+
+// Notifications sent through subscription connections
+#define NOTIFICATION_RESERVATION 'R'
+#define NOTIFICATION_RESYNC 'S'
+#define SUBSCRIBER_QUEUE_MAX 256  // Notifications held for a subscriber before it's told to resync instead
@@ -0,0 +1,459 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+#include "fibers.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "clock.h"
+
+#define FIBER_STACK_SIZE (64 * 1024)  // Stack of a fiber, above a guard page that faults when it overflows
+#define PARK_BUCKETS 64               // Lists the fibers waiting for a resource are parked in, by its address
+
+struct Fiber {
+  ucontext_t context;
+  char *stack;  // Mapping of the stack and its guard page, NULL once the fiber is done
+  size_t stack_len;
+  size_t index;
+  struct FiberThread *thread;  // Thread the fiber runs on, the only one it ever runs on
+  long long wake_ns;           // When a sleeping fiber is due to run again
+  void *parked_on;             // Resource a parked fiber waits for
+  int parked_exclusive;        // Whether a parked fiber waits to hold the resource alone
+  struct Fiber *next;          // Next fiber in the ready queue, the woken list or the park list
+  int done;
+};
+
+// Fibers of a pool thread and what each of them waits for
+struct FiberThread {
+  ucontext_t context;  // Where the thread picks the next fiber to run
+  void (*function)(void *arg, size_t index);
+  void *arg;
+  struct Fiber *fibers;
+  size_t num_fibers;
+  size_t num_running;
+  struct Fiber *current;  // Fiber running, NULL while the thread picks one
+  struct Fiber *ready_head, *ready_tail;
+  struct Fiber **timers;  // Min-heap of the sleeping fibers, the first one due first
+  size_t num_timers;
+  pthread_t thread;
+
+  // Parked fibers woken by other threads, moved to the ready queue by this one. The thread waits on the cond
+  // variable when it has nothing to run.
+  pthread_mutex_t wake_lock;
+  pthread_cond_t woken;
+  struct Fiber *woken_head, *woken_tail;
+  int has_woken;  // Whether the woken list has fibers, read without the lock
+  int wake_initialized;
+};
+
+// Fibers waiting for resources whose addresses hash to the bucket
+struct ParkBucket {
+  pthread_mutex_t lock;
+  struct Fiber *parked;
+};
+
+static _Thread_local struct FiberThread *local_thread = NULL;
+
+// The internal locks are plain pthread ones, the wrappers of common/locks.h would park on them in turn
+static struct ParkBucket park_buckets[PARK_BUCKETS];
+static pthread_once_t park_once = PTHREAD_ONCE_INIT;
+static unsigned long num_parked = 0;  // Fibers parked or about to be, so releases skip the buckets when there are none
+
+// Whether fibers ever ran. Until then releases return without a barrier, so programs that only run threads, like the
+// server, pay nothing on their unlocks. Set before the pool creates its threads, so every one of them sees it.
+static int fibers_started = 0;
+
+/// Sets up the locks of the park buckets.
+static void init_park_buckets(void) {
+  for (size_t i = 0; i < PARK_BUCKETS; i++) {
+    if (pthread_mutex_init(&park_buckets[i].lock, NULL) != 0) {
+      perror("Failed to set up the fiber park");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/// Queues a fiber to run after the ones already ready.
+/// @param thread Thread of the fiber.
+/// @param fiber Fiber to queue.
+static void push_ready(struct FiberThread *thread, struct Fiber *fiber) {
+  fiber->next = NULL;
+  if (thread->ready_tail != NULL) {
+    thread->ready_tail->next = fiber;
+  } else {
+    thread->ready_head = fiber;
+  }
+  thread->ready_tail = fiber;
+}
+
+/// Adds a sleeping fiber to the timers of its thread.
+/// @param thread Thread of the fiber, with room for it as every fiber has a slot.
+/// @param fiber Fiber to add, its wake time set.
+static void push_timer(struct FiberThread *thread, struct Fiber *fiber) {
+  size_t i = thread->num_timers++;
+  while (i > 0 && thread->timers[(i - 1) / 2]->wake_ns > fiber->wake_ns) {
+    thread->timers[i] = thread->timers[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  thread->timers[i] = fiber;
+}
+
+/// Removes the sleeping fiber due first from the timers of its thread.
+/// @param thread Thread with at least a sleeping fiber.
+/// @return Fiber removed.
+static struct Fiber *pop_timer(struct FiberThread *thread) {
+  struct Fiber *first = thread->timers[0];
+  struct Fiber *last = thread->timers[--thread->num_timers];
+  size_t i = 0;
+  for (size_t child = 1; child < thread->num_timers; child = 2 * i + 1) {
+    if (child + 1 < thread->num_timers && thread->timers[child + 1]->wake_ns < thread->timers[child]->wake_ns) {
+      child++;
+    }
+    if (thread->timers[child]->wake_ns >= last->wake_ns) {
+      break;
+    }
+    thread->timers[i] = thread->timers[child];
+    i = child;
+  }
+  if (thread->num_timers > 0) {
+    thread->timers[i] = last;
+  }
+  return first;
+}
+
+/// Moves the fibers other threads woke up to the ready queue.
+/// @param thread Thread of the fibers.
+static void take_woken(struct FiberThread *thread) {
+  pthread_mutex_lock(&thread->wake_lock);
+  if (thread->woken_head != NULL) {
+    if (thread->ready_tail != NULL) {
+      thread->ready_tail->next = thread->woken_head;
+    } else {
+      thread->ready_head = thread->woken_head;
+    }
+    thread->ready_tail = thread->woken_tail;
+    thread->woken_head = thread->woken_tail = NULL;
+  }
+  __atomic_store_n(&thread->has_woken, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&thread->wake_lock);
+}
+
+/// Waits until a fiber of the thread can run, either woken by another thread or as its sleep is over.
+/// @param thread Thread with no fiber ready to run.
+static void wait_for_fibers(struct FiberThread *thread) {
+  pthread_mutex_lock(&thread->wake_lock);
+  if (thread->woken_head == NULL) {
+    if (thread->num_timers > 0) {
+      long long wake_ns = thread->timers[0]->wake_ns;
+      struct timespec ts = {(time_t)(wake_ns / 1000000000LL), (long)(wake_ns % 1000000000LL)};
+      pthread_cond_timedwait(&thread->woken, &thread->wake_lock, &ts);
+    } else {
+      pthread_cond_wait(&thread->woken, &thread->wake_lock);
+    }
+  }
+  pthread_mutex_unlock(&thread->wake_lock);
+}
+
+/// Queues a parked fiber to run again, on its own thread.
+/// @param fiber Fiber to wake up, already out of its park list.
+static void wake_fiber(struct Fiber *fiber) {
+  struct FiberThread *thread = fiber->thread;
+  if (thread == local_thread) {
+    push_ready(thread, fiber);
+    return;
+  }
+
+  pthread_mutex_lock(&thread->wake_lock);
+  fiber->next = NULL;
+  if (thread->woken_tail != NULL) {
+    thread->woken_tail->next = fiber;
+  } else {
+    thread->woken_head = fiber;
+  }
+  thread->woken_tail = fiber;
+  __atomic_store_n(&thread->has_woken, 1, __ATOMIC_RELAXED);
+  pthread_cond_signal(&thread->woken);
+  pthread_mutex_unlock(&thread->wake_lock);
+}
+
+/// Gets the park bucket of a resource.
+/// @param resource Address of the resource.
+/// @return Bucket its fibers are parked in.
+static struct ParkBucket *park_bucket(const void *resource) {
+  return &park_buckets[((uintptr_t)resource >> 4) % PARK_BUCKETS];
+}
+
+/// Switches from a fiber back to its thread, until the thread picks the fiber again.
+/// @param thread Thread of the fiber.
+/// @param fiber Fiber running.
+static void switch_to_thread(struct FiberThread *thread, struct Fiber *fiber) {
+  if (swapcontext(&fiber->context, &thread->context) != 0) {
+    perror("Failed to switch back from a fiber");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// Runs the function of the fiber picked by the thread, going back to the thread once it returns.
+static void fiber_main(void) {
+  struct FiberThread *thread = local_thread;
+  struct Fiber *fiber = thread->current;
+  thread->function(thread->arg, fiber->index);
+  fiber->done = 1;
+}
+
+/// Runs the fibers of a pool thread until they're all done.
+static void *run_thread(void *arg) {
+  struct FiberThread *thread = arg;
+  local_thread = thread;
+
+  while (thread->num_running > 0) {
+    // Fibers woken by other threads and the ones whose sleep is over run after the ones that were already ready
+    if (__atomic_load_n(&thread->has_woken, __ATOMIC_RELAXED)) {
+      take_woken(thread);
+    }
+    if (thread->num_timers > 0) {
+      long long current_ns = clock_now_ns();
+      while (thread->num_timers > 0 && thread->timers[0]->wake_ns <= current_ns) {
+        push_ready(thread, pop_timer(thread));
+      }
+    }
+
+    // With every fiber asleep or parked, a single wait stands for all of them
+    if (thread->ready_head == NULL) {
+      wait_for_fibers(thread);
+      continue;
+    }
+
+    struct Fiber *fiber = thread->ready_head;
+    thread->ready_head = fiber->next;
+    if (thread->ready_head == NULL) {
+      thread->ready_tail = NULL;
+    }
+    thread->current = fiber;
+    if (swapcontext(&thread->context, &fiber->context) != 0) {
+      perror("Failed to switch to a fiber");
+      exit(EXIT_FAILURE);
+    }
+    thread->current = NULL;
+
+    if (fiber->done) {
+      munmap(fiber->stack, fiber->stack_len);
+      fiber->stack = NULL;
+      thread->num_running--;
+    }
+  }
+
+  local_thread = NULL;
+  return NULL;
+}
+
+/// Frees what a pool thread was given to run its fibers.
+/// @param thread Thread to free.
+static void free_thread(struct FiberThread *thread) {
+  for (size_t i = 0; i < thread->num_fibers && thread->fibers != NULL; i++) {
+    if (thread->fibers[i].stack != NULL) {
+      munmap(thread->fibers[i].stack, thread->fibers[i].stack_len);
+    }
+  }
+  free(thread->fibers);
+  free(thread->timers);
+  if (thread->wake_initialized) {
+    pthread_mutex_destroy(&thread->wake_lock);
+    pthread_cond_destroy(&thread->woken);
+  }
+}
+
+/// Sets up the fibers of a pool thread, all ready to run.
+/// @param thread Thread to set up, its function, argument and number of fibers set.
+/// @param first_index Index of the first fiber of the thread.
+/// @return 0 if successful, 1 otherwise.
+static int setup_thread(struct FiberThread *thread, size_t first_index) {
+  thread->num_running = 0;
+  thread->current = NULL;
+  thread->ready_head = thread->ready_tail = NULL;
+  thread->num_timers = 0;
+  thread->woken_head = thread->woken_tail = NULL;
+  thread->has_woken = 0;
+
+  // Timed waits are for timers of the monotonic clock
+  pthread_condattr_t attr;
+  if (pthread_condattr_init(&attr) != 0) {
+    return 1;
+  }
+  int failed = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 || pthread_cond_init(&thread->woken, &attr) != 0;
+  pthread_condattr_destroy(&attr);
+  if (failed) {
+    return 1;
+  }
+  if (pthread_mutex_init(&thread->wake_lock, NULL) != 0) {
+    pthread_cond_destroy(&thread->woken);
+    return 1;
+  }
+  thread->wake_initialized = 1;
+
+  thread->fibers = calloc(thread->num_fibers, sizeof(struct Fiber));
+  thread->timers = malloc(sizeof(struct Fiber *) * thread->num_fibers);
+  if (thread->fibers == NULL || thread->timers == NULL) {
+    return 1;
+  }
+
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < thread->num_fibers; i++) {
+    struct Fiber *fiber = &thread->fibers[i];
+    fiber->index = first_index + i;
+    fiber->thread = thread;
+    fiber->stack_len = page + FIBER_STACK_SIZE;
+    fiber->stack = mmap(NULL, fiber->stack_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (fiber->stack == MAP_FAILED) {
+      fiber->stack = NULL;
+      return 1;
+    }
+    if (mprotect(fiber->stack, page, PROT_NONE) != 0 || getcontext(&fiber->context) != 0) {
+      return 1;
+    }
+    fiber->context.uc_stack.ss_sp = fiber->stack + page;
+    fiber->context.uc_stack.ss_size = FIBER_STACK_SIZE;
+    fiber->context.uc_link = &thread->context;
+    makecontext(&fiber->context, fiber_main, 0);
+    push_ready(thread, fiber);
+    thread->num_running++;
+  }
+  return 0;
+}
+
+int fiber_pool_run(size_t num_threads, size_t num_fibers, void (*function)(void *arg, size_t index), void *arg) {
+  num_threads = num_threads < num_fibers ? num_threads : num_fibers;
+  if (num_threads == 0) {
+    return 0;
+  }
+  pthread_once(&park_once, init_park_buckets);
+  __atomic_store_n(&fibers_started, 1, __ATOMIC_RELAXED);
+  struct FiberThread *threads = calloc(num_threads, sizeof(struct FiberThread));
+  if (threads == NULL) {
+    fprintf(stderr, "Failed to allocate memory for the fiber threads\n");
+    return 1;
+  }
+
+  // Each thread gets a run of consecutive fibers, the first ones one more when they don't split evenly
+  int failed = 0;
+  size_t first_index = 0;
+  for (size_t i = 0; i < num_threads && !failed; i++) {
+    threads[i].function = function;
+    threads[i].arg = arg;
+    threads[i].num_fibers = num_fibers / num_threads + (i < num_fibers % num_threads);
+    failed = setup_thread(&threads[i], first_index);
+    first_index += threads[i].num_fibers;
+  }
+  if (failed) {
+    perror("Failed to set up the fibers");
+  }
+
+  size_t started = 0;
+  for (; started < num_threads && !failed; started++) {
+    if (pthread_create(&threads[started].thread, NULL, run_thread, &threads[started]) != 0) {
+      fprintf(stderr, "Failed to create fiber thread\n");
+      failed = 1;
+      break;
+    }
+  }
+  for (size_t i = 0; i < started; i++) {
+    pthread_join(threads[i].thread, NULL);
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    free_thread(&threads[i]);
+  }
+  free(threads);
+  return failed;
+}
+
+int fiber_running(void) { return local_thread != NULL && local_thread->current != NULL; }
+
+void fiber_yield(void) {
+  struct FiberThread *thread = local_thread;
+  if (thread == NULL || thread->current == NULL) {
+    return;
+  }
+  struct Fiber *fiber = thread->current;
+  push_ready(thread, fiber);
+  switch_to_thread(thread, fiber);
+}
+
+void fiber_sleep_ns(long long duration_ns) {
+  struct FiberThread *thread = local_thread;
+  if (thread == NULL || thread->current == NULL) {
+    struct timespec ts = {(time_t)(duration_ns / 1000000000LL), (long)(duration_ns % 1000000000LL)};
+    nanosleep(&ts, NULL);
+    return;
+  }
+  struct Fiber *fiber = thread->current;
+  fiber->wake_ns = clock_now_ns() + duration_ns;
+  push_timer(thread, fiber);
+  switch_to_thread(thread, fiber);
+}
+
+int fiber_acquire(void *resource, int exclusive, int (*try_acquire)(void *resource)) {
+  struct FiberThread *thread = local_thread;
+  struct Fiber *fiber = thread->current;
+  struct ParkBucket *bucket = park_bucket(resource);
+
+  while (1) {
+    // Counted before trying, so a release that comes after the try fails sees the fiber is about to park. It parks
+    // under the bucket lock, which the release takes to wake it up.
+    pthread_mutex_lock(&bucket->lock);
+    __atomic_add_fetch(&num_parked, 1, __ATOMIC_SEQ_CST);
+
+    // Fibers that share a resource wait behind the ones that want it alone, so those aren't starved
+    int writer_parked = 0;
+    for (struct Fiber *parked = bucket->parked; parked != NULL && !exclusive && !writer_parked; parked = parked->next) {
+      writer_parked = parked->parked_on == resource && parked->parked_exclusive;
+    }
+    int result = writer_parked ? EBUSY : try_acquire(resource);
+    if (result != EBUSY) {
+      __atomic_sub_fetch(&num_parked, 1, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&bucket->lock);
+      return result;
+    }
+
+    fiber->parked_on = resource;
+    fiber->parked_exclusive = exclusive;
+    fiber->next = bucket->parked;
+    bucket->parked = fiber;
+    pthread_mutex_unlock(&bucket->lock);
+    switch_to_thread(thread, fiber);
+  }
+}
+
+void fiber_release(void *resource) {
+  if (!__atomic_load_n(&fibers_started, __ATOMIC_RELAXED)) {
+    return;
+  }
+
+  // Pairs with the count in fiber_acquire: either this sees the fiber parking or its try sees the resource released
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&num_parked, __ATOMIC_RELAXED) == 0) {
+    return;
+  }
+
+  // Every fiber waiting for the resource tries again, the ones that still can't have it park once more
+  struct ParkBucket *bucket = park_bucket(resource);
+  pthread_mutex_lock(&bucket->lock);
+  struct Fiber **link = &bucket->parked;
+  while (*link != NULL) {
+    struct Fiber *parked = *link;
+    if (parked->parked_on != resource) {
+      link = &parked->next;
+      continue;
+    }
+    *link = parked->next;
+    __atomic_sub_fetch(&num_parked, 1, __ATOMIC_RELAXED);
+    wake_fiber(parked);
+  }
+  pthread_mutex_unlock(&bucket->lock);
+}
@@ -0,0 +1,48 @@
+#ifndef FIBERS_H
+#define FIBERS_H
+
+#include <stddef.h>
+
+// Fibers run on a few threads, each thread switching between its own fibers whenever the running one waits. A fiber
+// sleeping on a timer lets the others of its thread run, so a thread keeps as many sleeps in flight as it has fibers
+// instead of one. Fibers stay on the thread they started on, as the locks they take are owned by threads. They must
+// not block the thread, so locks are taken with the wrappers of common/locks.h, which park the fiber while the lock is
+// busy and wake it when the lock is released.
+// Only bench/fibers runs fibers, to compare them against threads on the EMS operations. The server's workers are
+// threads, which is what the locks of common/locks.h block as long as they don't run on a fiber.
+
+/// Runs functions as fibers spread over a pool of threads, returning once every one of them is done.
+/// @param num_threads Threads of the pool.
+/// @param num_fibers Fibers to run, each calling the function once.
+/// @param function Function run by every fiber, with the argument and the index of the fiber.
+/// @param arg Argument of the function.
+/// @return 0 if successful, 1 otherwise.
+int fiber_pool_run(size_t num_threads, size_t num_fibers, void (*function)(void *arg, size_t index), void *arg);
+
+/// Tells whether the caller runs on a fiber.
+/// @return 1 if it does, 0 otherwise.
+int fiber_running(void);
+
+/// Lets the other fibers of the thread run before the calling one goes on. Returns at once when not on a fiber.
+void fiber_yield(void);
+
+/// Sleeps for a duration. On a fiber the other fibers of the thread run meanwhile, otherwise the thread sleeps.
+/// @param duration_ns Duration in nanoseconds.
+void fiber_sleep_ns(long long duration_ns);
+
+/// Waits on a fiber until it acquires a resource, letting the other fibers of the thread run meanwhile. The fiber
+/// parks until fiber_release is called for the resource, then tries again. Fibers waiting to share a resource park
+/// without trying while one waiting to hold it alone is parked, so those aren't starved.
+/// @note Must only be called on a fiber.
+/// @param resource Address of the resource.
+/// @param exclusive Whether the fiber waits to hold the resource alone.
+/// @param try_acquire Tries to acquire the resource without blocking, returning EBUSY if it's held.
+/// @return 0 once the resource is acquired, the error of try_acquire if it fails otherwise.
+int fiber_acquire(void *resource, int exclusive, int (*try_acquire)(void *resource));
+
+/// Wakes the fibers parked on a resource, to be called after releasing it. Cheap when no fiber is parked, and a single
+/// load in programs that never ran fibers.
+/// @param resource Address of the resource.
+void fiber_release(void *resource);
+
+#endif  // FIBERS_H
@@ -1,5 +1,7 @@
 #include "io.h"
 
+#include <sys/socket.h>
+
 int parse_uint(int fd, unsigned int* value, char* next) {
   char buf[16];
 
@@ -84,7 +86,10 @@ int pipe_print(int pipe_fd, const void* buf, size_t buf_len) {
   while (total_written < buf_len) {
     ssize_t written = write(pipe_fd, buf + total_written, buf_len - total_written);
 
-    if ((written == -1 && errno == EINTR) || (written == 0)) {
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
       return 1;  // Error other than interruption by signal or reached end of file
     }
 
@@ -117,54 +122,316 @@ int pipe_parse(int pipe_fd, void* buf, size_t buf_len) {
   return 0;
 }
 
-int print_event(int out_fd, size_t num_rows, size_t num_cols, unsigned int* data) {
-  for (size_t i = 1; i <= num_rows; i++) {
-    for (size_t j = 1; j <= num_cols; j++) {
-      char buffer[16];
-      sprintf(buffer, "%u", data[(i - 1) * num_cols + j - 1]);
-      if (print_str(out_fd, buffer)) {
-        perror("Error writing to file descriptor");
+const char* socket_address_path(const char* address) {
+  size_t prefix_len = strlen(SOCKET_ADDRESS_PREFIX);
+  if (strncmp(address, SOCKET_ADDRESS_PREFIX, prefix_len) != 0) {
+    return NULL;
+  }
+
+  return address + prefix_len;
+}
+
+int packet_print(int socket_fd, const void* buf, size_t buf_len) {
+  size_t total_written = 0;
+
+  do {
+    size_t record_len = buf_len - total_written;
+    if (record_len > PACKET_MAX_LEN) {
+      record_len = PACKET_MAX_LEN;
+    }
+
+    ssize_t written = send(socket_fd, (const char*)buf + total_written, record_len, MSG_NOSIGNAL);
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return 1;
+    }
+
+    total_written += (size_t)written;
+  } while (total_written < buf_len);
+
+  return 0;
+}
+
+void packet_reader_init(packet_reader_t* reader, int socket_fd) {
+  reader->fd = socket_fd;
+  reader->len = 0;
+  reader->offset = 0;
+}
+
+int packet_parse(packet_reader_t* reader, void* buf, size_t buf_len) {
+  size_t total_read = 0;
+
+  while (total_read < buf_len) {
+    if (reader->offset == reader->len && buf_len - total_read >= PACKET_MAX_LEN) {
+      // No record is larger than the rest of the read, so it's received in place, skipping the copy
+      ssize_t read_bytes = recv(reader->fd, (char*)buf + total_read, PACKET_MAX_LEN, 0);
+
+      if (read_bytes == -1 && errno == EINTR) {
+        continue;
+      }
+      if (read_bytes <= 0) {
+        return 1;  // Error or peer closed the connection
+      }
+
+      total_read += (size_t)read_bytes;
+      continue;
+    }
+
+    if (reader->offset == reader->len) {
+      ssize_t read_bytes = recv(reader->fd, reader->buffer, PACKET_MAX_LEN, 0);
+
+      if (read_bytes == -1 && errno == EINTR) {
+        continue;
+      }
+      if (read_bytes <= 0) {
+        return 1;  // Error or peer closed the connection
+      }
+
+      reader->len = (size_t)read_bytes;
+      reader->offset = 0;
+    }
+
+    size_t available = reader->len - reader->offset;
+    size_t to_copy = buf_len - total_read < available ? buf_len - total_read : available;
+
+    memcpy((char*)buf + total_read, reader->buffer + reader->offset, to_copy);
+    reader->offset += to_copy;
+    total_read += to_copy;
+  }
+
+  return 0;
+}
+
+void packet_discard(packet_reader_t* reader) { reader->offset = reader->len; }
+
+size_t varint_encode(void* buf, unsigned long long value) {
+  unsigned char* bytes = buf;
+  size_t len = 0;
+
+  while (value >= 0x80) {
+    bytes[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[len++] = (unsigned char)value;
+
+  return len;
+}
+
+int varint_decode(const void* buf, size_t buf_len, size_t* offset, unsigned long long* value) {
+  const unsigned char* bytes = buf;
+  unsigned long long result = 0;
+
+  for (unsigned int shift = 0; shift < 7 * VARINT_MAX_LEN; shift += 7) {
+    if (*offset >= buf_len) {
+      return 1;
+    }
+
+    unsigned char byte = bytes[(*offset)++];
+    result |= (unsigned long long)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+size_t coords_encode(const size_t* xs, const size_t* ys, size_t num_seats, void* buf) {
+  char* out = buf;
+  size_t len = 0;
+
+  for (size_t i = 0; i < num_seats; i++) {
+    len += varint_encode(out + len, xs[i]);
+  }
+  for (size_t i = 0; i < num_seats; i++) {
+    len += varint_encode(out + len, ys[i]);
+  }
+
+  return len;
+}
+
+int coords_decode(const void* buf, size_t buf_len, size_t* xs, size_t* ys, size_t num_seats) {
+  size_t offset = 0;
+
+  for (size_t i = 0; i < 2 * num_seats; i++) {
+    unsigned long long value;
+    if (varint_decode(buf, buf_len, &offset, &value) || (size_t)value != value) {
+      return 1;
+    }
+    if (i < num_seats) {
+      xs[i] = (size_t)value;
+    } else {
+      ys[i - num_seats] = (size_t)value;
+    }
+  }
+
+  return offset != buf_len;
+}
+
+size_t seat_ranges_encode(const seat_range_t* ranges, size_t num_ranges, void* buf) {
+  char* out = buf;
+  size_t len = 0;
+
+  for (size_t i = 0; i < num_ranges; i++) {
+    len += varint_encode(out + len, ranges[i].first_row);
+    len += varint_encode(out + len, ranges[i].first_col);
+    len += varint_encode(out + len, ranges[i].last_row);
+    len += varint_encode(out + len, ranges[i].last_col);
+  }
+
+  return len;
+}
+
+int seat_ranges_decode(const void* buf, size_t buf_len, seat_range_t* ranges, size_t num_ranges) {
+  size_t offset = 0;
+
+  for (size_t i = 0; i < num_ranges; i++) {
+    size_t* corners[] = {&ranges[i].first_row, &ranges[i].first_col, &ranges[i].last_row, &ranges[i].last_col};
+    for (size_t j = 0; j < 4; j++) {
+      unsigned long long value;
+      if (varint_decode(buf, buf_len, &offset, &value) || (size_t)value != value) {
         return 1;
       }
+      *corners[j] = (size_t)value;
+    }
+  }
+
+  return offset != buf_len;
+}
 
-      if (j < num_cols) {
-        if (print_str(out_fd, " ")) {
-          perror("Error writing to file descriptor");
-          return 1;
-        }
+size_t rle_encode_seats(const unsigned int* seats, size_t num_seats, void* buf, size_t buf_len) {
+  char* out = buf;
+  size_t len = 0;
+
+  for (size_t i = 0; i < num_seats;) {
+    unsigned int reservation_id = seats[i];
+    size_t end = i + 1;
+    while (end < num_seats && seats[end] == reservation_id) {
+      end++;
+    }
+
+    // Near the end of the buffer runs go through a scratch space first, so it is never overrun
+    if (len + 2 * VARINT_MAX_LEN <= buf_len) {
+      len += varint_encode(out + len, end - i);
+      len += varint_encode(out + len, reservation_id);
+    } else {
+      char encoded[2 * VARINT_MAX_LEN];
+      size_t encoded_len = varint_encode(encoded, end - i);
+      encoded_len += varint_encode(encoded + encoded_len, reservation_id);
+      if (len + encoded_len > buf_len) {
+        return 0;
       }
+      memcpy(out + len, encoded, encoded_len);
+      len += encoded_len;
     }
+    i = end;
+  }
 
-    if (print_str(out_fd, "\n")) {
-      perror("Error writing to file descriptor");
+  return len;
+}
+
+int rle_decode_seats(const void* buf, size_t buf_len, unsigned int* seats, size_t num_seats) {
+  const unsigned char* bytes = buf;
+  size_t offset = 0, seat = 0;
+
+  while (offset < buf_len) {
+    // Short runs and the first 127 reservations fit in a byte, skip the general decoder for them
+    unsigned long long run, reservation_id;
+    if (bytes[offset] < 0x80) {
+      run = bytes[offset++];
+    } else if (varint_decode(buf, buf_len, &offset, &run)) {
+      return 1;
+    }
+    if (offset < buf_len && bytes[offset] < 0x80) {
+      reservation_id = bytes[offset++];
+    } else if (varint_decode(buf, buf_len, &offset, &reservation_id)) {
+      return 1;
+    }
+    if (run == 0 || run > num_seats - seat || reservation_id > UINT_MAX) {
       return 1;
     }
+
+    unsigned int* end = seats + seat + run;
+    for (unsigned int* out = seats + seat; out < end; out++) {
+      *out = (unsigned int)reservation_id;
+    }
+    seat += run;
+  }
+
+  return seat != num_seats;
+}
+
+void write_buffer_init(write_buffer_t* out, int fd) {
+  out->fd = fd;
+  out->len = 0;
+}
+
+int write_buffer_flush(write_buffer_t* out) {
+  if (out->len == 0) {
+    return 0;
   }
 
+  if (pipe_print(out->fd, out->buffer, out->len)) {
+    return 1;
+  }
+  out->len = 0;
   return 0;
 }
 
-int print_ids(unsigned int* ids, size_t num_ids, int out_fd) {
-  if (num_ids == 0) {
-    char buff[] = "No events\n";
-    if (print_str(out_fd, buff)) {
-      perror("Error writing to file descriptor");
+int buffered_print(write_buffer_t* out, const void* buf, size_t buf_len) {
+  if (out->len + buf_len > WRITE_BUFFER_LEN) {
+    if (write_buffer_flush(out)) {
       return 1;
     }
-    return 0;
+    if (buf_len > WRITE_BUFFER_LEN) {
+      return pipe_print(out->fd, buf, buf_len);
+    }
   }
 
-  for (size_t i = 0; i < num_ids; i++) {
-    char buff[] = "Event: ";
-    if (print_str(out_fd, buff)) {
-      perror("Error writing to file descriptor");
+  memcpy(out->buffer + out->len, buf, buf_len);
+  out->len += buf_len;
+  return 0;
+}
+
+int buffered_print_uint(write_buffer_t* out, unsigned int value) {
+  char buffer[16];
+  size_t i = 16;
+
+  do {
+    buffer[--i] = '0' + (char)(value % 10);
+    value /= 10;
+  } while (value > 0);
+
+  return buffered_print(out, buffer + i, 16 - i);
+}
+
+int buffered_print_event(write_buffer_t* out, size_t num_rows, size_t num_cols, const unsigned int* data) {
+  for (size_t i = 0; i < num_rows; i++) {
+    for (size_t j = 0; j < num_cols; j++) {
+      if (buffered_print_uint(out, data[i * num_cols + j]) ||
+          (j + 1 < num_cols && buffered_print(out, " ", 1))) {
+        return 1;
+      }
+    }
+
+    if (buffered_print(out, "\n", 1)) {
       return 1;
     }
+  }
+
+  return 0;
+}
 
-    char id[16];
-    sprintf(id, "%u\n", ids[i]);
-    if (print_str(out_fd, id)) {
-      perror("Error writing to file descriptor");
+int buffered_print_ids(write_buffer_t* out, const unsigned int* ids, size_t num_ids) {
+  if (num_ids == 0) {
+    return buffered_print(out, "No events\n", 10);
+  }
+
+  for (size_t i = 0; i < num_ids; i++) {
+    if (buffered_print(out, "Event: ", 7) || buffered_print_uint(out, ids[i]) || buffered_print(out, "\n", 1)) {
       return 1;
     }
   }
@@ -11,10 +11,48 @@
 
 #include "constants.h"
 
+// Reads a stream of bytes out of the records of a SOCK_SEQPACKET socket.
+typedef struct {
+  int fd;
+  char buffer[PACKET_MAX_LEN];
+  size_t len;     // Bytes in the current record
+  size_t offset;  // Bytes of the current record already consumed
+} packet_reader_t;
+
+// Gathers output in memory, writing it to the file descriptor when full.
+typedef struct {
+  int fd;
+  size_t len;
+  char buffer[WRITE_BUFFER_LEN];
+} write_buffer_t;
+
+// Block of seats from (first_row, first_col) to (last_row, last_col), both included. A single seat is a 1x1 block.
+typedef struct {
+  size_t first_row, first_col;
+  size_t last_row, last_col;
+} seat_range_t;
+
+// Seats of a reservation streamed in chunks, kept by a session to be reused by its next reservations.
+typedef struct {
+  size_t *xs, *ys;
+  size_t len;       // Seats received so far
+  size_t capacity;  // Seats xs and ys have room for
+  int lost;         // Whether a chunk failed to be received, failing the reservation as a whole
+} seat_buffer_t;
+
 typedef struct {
   char request_pipename[CLIENT_PIPE_MAX_LEN];
   char response_pipename[CLIENT_PIPE_MAX_LEN];
   int session_id;
+  int request_fd;             // Request pipe, -1 for socket sessions
+  int socket_fd;              // Connected socket, -1 for FIFO sessions
+  int uring_slot;             // Slot of the session in the io_uring backend, -1 otherwise
+  char wire_version;          // Encoding of the requests, agreed on at setup
+  packet_reader_t reader;     // Reader over socket_fd
+  seat_buffer_t reservation;  // Seats of the reservation being received
+  int job_fd;                 // Job script being received, kept to be reused by the next ones, -1 when none yet
+  unsigned int connection;    // Connection the requests of the session are recorded under, 0 when not recording
+  long long queued_ns;        // When the session, or its request with io_uring, was last queued up for a worker
 } client_t;
 
 /// Parses an unsigned integer from the given file descriptor.
@@ -57,19 +95,132 @@ int pipe_print(int pipe_fd, const void *buf, size_t buf_len);
 /// @return 0 if successful, 1 otherwise.
 int pipe_parse(int pipe_fd, void *buf, size_t buf_len);
 
-/// Prints event into a file.
-/// @param out_fd File descriptor to print into.
+/// Checks if a server address selects the Unix socket transport.
+/// @param address Server address given by the user.
+/// @return Path of the socket if it does, NULL otherwise.
+const char *socket_address_path(const char *address);
+
+/// Sends a message through a SOCK_SEQPACKET socket, split in records of at most PACKET_MAX_LEN bytes.
+/// @param socket_fd Socket to write in.
+/// @param buf Content to write.
+/// @param buf_len Length of the content to write.
+/// @return 0 if successful, 1 otherwise.
+int packet_print(int socket_fd, const void *buf, size_t buf_len);
+
+/// Initializes a reader over a SOCK_SEQPACKET socket.
+/// @param reader Reader to initialize.
+/// @param socket_fd Socket to read from.
+void packet_reader_init(packet_reader_t *reader, int socket_fd);
+
+/// Reads content of a certain length out of the socket records, receiving new records as needed.
+/// @param reader Reader to read from.
+/// @param buf Variable to store what is read.
+/// @param buf_len Length to read.
+/// @return 0 if successful, 1 otherwise.
+int packet_parse(packet_reader_t *reader, void *buf, size_t buf_len);
+
+/// Discards what is left of the current record, so the next read starts on a message boundary.
+/// @param reader Reader to reset.
+void packet_discard(packet_reader_t *reader);
+
+/// Writes an unsigned integer as a LEB128 varint, 7 bits per byte with the high bit set on all but the last.
+/// @param buf Buffer to write to, with room for VARINT_MAX_LEN bytes.
+/// @param value The value to write.
+/// @return Number of bytes written.
+size_t varint_encode(void *buf, unsigned long long value);
+
+/// Reads a LEB128 varint.
+/// @param buf Buffer to read from.
+/// @param buf_len Length of the buffer.
+/// @param offset Offset to read from, moved past the varint.
+/// @param value Variable to store the value in.
+/// @return 0 if successful, 1 if the varint is cut short or too long.
+int varint_decode(const void *buf, size_t buf_len, size_t *offset, unsigned long long *value);
+
+/// Encodes the coordinates of seats as the LEB128 varints of every row followed by those of every column.
+/// @param xs Rows of the seats.
+/// @param ys Columns of the seats.
+/// @param num_seats Number of seats.
+/// @param buf Buffer to write to, with room for 2 * num_seats * VARINT_MAX_LEN bytes.
+/// @return Length of the encoding.
+size_t coords_encode(const size_t *xs, const size_t *ys, size_t num_seats, void *buf);
+
+/// Decodes coordinates encoded by coords_encode.
+/// @param buf Encoded coordinates.
+/// @param buf_len Length of the encoding.
+/// @param xs Variable to store the rows in.
+/// @param ys Variable to store the columns in.
+/// @param num_seats Number of seats.
+/// @return 0 if successful, 1 if the encoding doesn't hold exactly num_seats coordinates.
+int coords_decode(const void *buf, size_t buf_len, size_t *xs, size_t *ys, size_t num_seats);
+
+/// Encodes blocks of seats as the LEB128 varints of their corners, first_row, first_col, last_row, last_col each.
+/// @param ranges Blocks to encode.
+/// @param num_ranges Number of blocks.
+/// @param buf Buffer to write to, with room for 4 * num_ranges * VARINT_MAX_LEN bytes.
+/// @return Length of the encoding.
+size_t seat_ranges_encode(const seat_range_t *ranges, size_t num_ranges, void *buf);
+
+/// Decodes blocks of seats encoded by seat_ranges_encode.
+/// @param buf Encoded blocks.
+/// @param buf_len Length of the encoding.
+/// @param ranges Variable to store the blocks in.
+/// @param num_ranges Number of blocks.
+/// @return 0 if successful, 1 if the encoding doesn't hold exactly num_ranges blocks.
+int seat_ranges_decode(const void *buf, size_t buf_len, seat_range_t *ranges, size_t num_ranges);
+
+/// Run-length encodes seats as runs of [ length (varint) ] | [ reservation_id (varint) ], in row-major order.
+/// @param seats Seats to encode.
+/// @param num_seats Number of seats.
+/// @param buf Buffer to write the runs to.
+/// @param buf_len Length of the buffer.
+/// @return Length of the encoding, 0 if it doesn't fit in the buffer.
+size_t rle_encode_seats(const unsigned int *seats, size_t num_seats, void *buf, size_t buf_len);
+
+/// Decodes seats run-length encoded by rle_encode_seats.
+/// @param buf Runs to decode.
+/// @param buf_len Length of the runs.
+/// @param seats Variable to store the seats in.
+/// @param num_seats Number of seats.
+/// @return 0 if successful, 1 if the runs don't cover exactly num_seats seats.
+int rle_decode_seats(const void *buf, size_t buf_len, unsigned int *seats, size_t num_seats);
+
+/// Initializes an output buffer over a file descriptor.
+/// @param out Buffer to initialize.
+/// @param fd File descriptor to write to.
+void write_buffer_init(write_buffer_t *out, int fd);
+
+/// Adds content to an output buffer, writing the buffer out when full.
+/// @param out Buffer to write to.
+/// @param buf Content to add.
+/// @param buf_len Length of the content.
+/// @return 0 if successful, 1 otherwise.
+int buffered_print(write_buffer_t *out, const void *buf, size_t buf_len);
+
+/// Adds an unsigned integer in decimal to an output buffer.
+/// @param out Buffer to write to.
+/// @param value The value to write.
+/// @return 0 if successful, 1 otherwise.
+int buffered_print_uint(write_buffer_t *out, unsigned int value);
+
+/// Writes out everything in an output buffer.
+/// @param out Buffer to flush.
+/// @return 0 if successful, 1 otherwise.
+int write_buffer_flush(write_buffer_t *out);
+
+/// Prints event into an output buffer.
+/// @param out Buffer to print into.
 /// @param num_rows Number of rows of event.
 /// @param num_cols Number of collumns of event.
 /// @param data Data of the event.
 /// @return 0 if successfull, 1 otherwise.
-int print_event(int out_fd, size_t num_rows, size_t num_cols, unsigned int *data);
+int buffered_print_event(write_buffer_t *out, size_t num_rows, size_t num_cols, const unsigned int *data);
 
-/// Prints ids into a file.
+/// Prints ids into an output buffer.
+/// @param out Buffer to print into.
 /// @param ids Ids to print.
 /// @param num_ids Number of ids to print.
-/// @param out_fd File descriptor of the file.
 /// @return 0 if successfull, 1 otherwise.
-int print_ids(unsigned int *ids, size_t num_ids, int out_fd);
+int buffered_print_ids(write_buffer_t *out, const unsigned int *ids, size_t num_ids);
 
 #endif  // COMMON_IO_H
@@ -48,6 +48,7 @@ void cond_init(pthread_cond_t *cond);
 void cond_destroy(pthread_cond_t *cond);
 
 /// Waits for the cond variable. Exits if the wait fails.
+/// @note Blocks the thread even on a fiber, so fibers must not wait for cond variables.
 /// @param cond The cond variable to wait for.
 void cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
 
@@ -59,4 +60,46 @@ void cond_broadcast(pthread_cond_t *cond);
 /// @param cond  The cond variable to be signalled.
 void cond_signal(pthread_cond_t *cond);
 
+#ifdef LOCK_PROFILE
+// Where a lock is taken, named after the lock and the line taking it. Every site counts its acquisitions, the ones
+// that had to wait for the lock, and for how long locks were waited for and held. The sites are reported on stderr,
+// the ones waited for the longest first, when the process exits.
+struct LockSite {
+  const char *name;
+  struct LockSite *next;  // Next site in the report
+  int registered;
+  unsigned long long acquisitions, contended;
+  unsigned long long wait_ns, max_wait_ns;
+  unsigned long long hold_ns, max_hold_ns;
+};
+
+#define LOCK_SITE_LINE_STRING(line) #line
+#define LOCK_SITE_LINE(line) LOCK_SITE_LINE_STRING(line)
+#define LOCK_AT(lock_function, lock)                                                                 \
+  do {                                                                                               \
+    static struct LockSite lock_site = {.name = #lock " at " __FILE__ ":" LOCK_SITE_LINE(__LINE__)}; \
+    lock_function(lock, &lock_site);                                                                 \
+  } while (0)
+
+/// Locks the rwlock for reading, counting it for a site. Exits if the lock fails.
+/// @param lock The rwlock to be locked.
+/// @param site Where the rwlock is taken.
+void rwlock_rdlock_at(pthread_rwlock_t *lock, struct LockSite *site);
+
+/// Locks the rwlock for writing, counting it for a site. Exits if the lock fails.
+/// @param lock The rwlock to be locked.
+/// @param site Where the rwlock is taken.
+void rwlock_wrlock_at(pthread_rwlock_t *lock, struct LockSite *site);
+
+/// Locks the mutex, counting it for a site. Exits if the lock fails.
+/// @param mutex The mutex to be locked.
+/// @param site Where the mutex is taken.
+void mutex_lock_at(pthread_mutex_t *mutex, struct LockSite *site);
+
+// Every lock taken is counted for the line taking it, with the unlocks and cond waits telling how long it was held
+#define rwlock_rdlock(lock) LOCK_AT(rwlock_rdlock_at, lock)
+#define rwlock_wrlock(lock) LOCK_AT(rwlock_wrlock_at, lock)
+#define mutex_lock(mutex) LOCK_AT(mutex_lock_at, mutex)
+#endif
+
 #endif  // LOCKS_H
\ No newline at end of file
@@ -4,6 +4,12 @@
 #include <pthread.h>
 #include <stddef.h>
 
+// Seat reserved for an event
+struct SeatChange {
+  size_t seat;                  /// Index of the seat.
+  unsigned int reservation_id;  /// Reservation that took the seat, also the version of the event right after it.
+};
+
 struct Event {
   unsigned int id;            /// Event id
   unsigned int reservations;  /// Number of reservations for the event.
@@ -13,6 +19,12 @@ struct Event {
 
   unsigned int* data;     /// Array of size rows * cols with the reservations for each seat.
   pthread_mutex_t mutex;  // Mutex to protect the event
+
+  struct SeatChange* changes;  /// Ring of the most recently reserved seats, allocated on the first reservation.
+  size_t changes_capacity;     /// Number of seats the ring holds, 0 for events too small to be worth one.
+  size_t changes_start;        /// Position of the oldest seat in the ring.
+  size_t changes_len;          /// Number of seats in the ring.
+  unsigned int changes_since;  /// Every seat reserved after this version is in the ring.
 };
 
 struct ListNode {
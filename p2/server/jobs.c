@@ -0,0 +1,145 @@
+#include "jobs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "client/jobfile.h"
+#include "client/parser.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "operations.h"
+
+int job_file_open() {
+  char path[] = "/tmp/ems-job-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    perror("Failed to create job file");
+    return -1;
+  }
+
+  // Gone as soon as it's closed
+  unlink(path);
+  return fd;
+}
+
+/// Prints the seats of an event the way the client shows them.
+/// @param out Buffer to print to.
+/// @param event_id Id of the event.
+/// @param seats Pointer to the array to copy the seats to, grown with realloc as needed.
+/// @param capacity Pointer to the number of seats the array has room for.
+/// @return 0 if the event was shown, 1 if it doesn't exist, -1 if it failed to be printed.
+static int show_event(write_buffer_t *out, unsigned int event_id, unsigned int **seats, size_t *capacity) {
+  unsigned int version;
+  size_t num_rows, num_cols;
+  if (get_event_version(event_id, &version, &num_rows, &num_cols)) {
+    return 1;
+  }
+
+  size_t num_seats = num_rows * num_cols;
+  if (num_seats > *capacity) {
+    unsigned int *new_seats = realloc(*seats, sizeof(unsigned int) * num_seats);
+    if (new_seats == NULL) {
+      perror("Memory allocation failed");
+      return 1;
+    }
+    *seats = new_seats;
+    *capacity = num_seats;
+  }
+
+  if (get_event_seats(event_id, *seats, &version)) {
+    return 1;
+  }
+  return buffered_print_event(out, num_rows, num_cols, *seats) ? -1 : 0;
+}
+
+/// Prints the ids of every event the way the client lists them.
+/// @param out Buffer to print to.
+/// @return 0 if the events were listed, 1 if they couldn't be read, -1 if they failed to be printed.
+static int list_events(write_buffer_t *out) {
+  unsigned int *ids;
+  size_t num_events;
+  if (get_events(&ids, &num_events)) {
+    return 1;
+  }
+
+  int failed = buffered_print_ids(out, ids, num_events);
+  free(ids);
+  return failed ? -1 : 0;
+}
+
+int run_job_script(int job_fd, int out_fd, size_t *num_commands, size_t *num_failed) {
+  job_reader_t job;
+  if (job_reader_open(&job, job_fd)) {
+    return 1;
+  }
+
+  write_buffer_t out;
+  write_buffer_init(&out, out_fd);
+
+  // Blocks of the RESERVE commands and seats of the SHOW commands, grown to fit the largest ones
+  seat_range_t *ranges = NULL;
+  unsigned int *seats = NULL;
+  size_t ranges_capacity = 0, seats_capacity = 0;
+
+  *num_commands = 0;
+  *num_failed = 0;
+  int result = 0;
+  while (result >= 0) {
+    unsigned int event_id, delay;
+    size_t num_rows, num_columns, num_ranges;
+
+    enum Command command = job_next(&job);
+    if (command == EOC) {
+      break;
+    }
+    if (command == CMD_EMPTY) {
+      continue;
+    }
+
+    (*num_commands)++;
+    switch (command) {
+      case CMD_CREATE:
+        result = job_parse_create(&job, &event_id, &num_rows, &num_columns) ||
+                 ems_create(event_id, num_rows, num_columns);
+        break;
+
+      case CMD_RESERVE:
+        // Single seats are 1x1 blocks, expanded by the reservation itself
+        num_ranges = job_parse_reserve(&job, &event_id, &ranges, &ranges_capacity);
+        result = num_ranges == 0 || ems_reserve_ranges(event_id, num_ranges, ranges);
+        break;
+
+      case CMD_SHOW:
+        result = job_parse_show(&job, &event_id) ? 1 : show_event(&out, event_id, &seats, &seats_capacity);
+        break;
+
+      case CMD_LIST_EVENTS:
+        result = list_events(&out);
+        break;
+
+      case CMD_WAIT:
+        result = job_parse_wait(&job, &delay, NULL) == -1;
+        if (result == 0 && delay > 0) {
+          sleep(delay);
+        }
+        break;
+
+      case CMD_HELP:
+        result = 0;
+        break;
+
+      case CMD_INVALID:
+      case CMD_EMPTY:
+      case EOC:
+        result = 1;
+        break;
+    }
+    *num_failed += result != 0;
+  }
+
+  job_reader_close(&job);
+  free(ranges);
+  free(seats);
+  return result < 0 || write_buffer_flush(&out);
+}
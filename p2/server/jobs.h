@@ -0,0 +1,19 @@
+#ifndef SERVER_JOBS_H
+#define SERVER_JOBS_H
+
+#include <stddef.h>
+
+/// Creates an anonymous file to hold a job script or its output.
+/// @return File descriptor of the file, -1 on failure.
+int job_file_open();
+
+/// Runs the commands of a job script in order against the EMS state, printing what SHOW and LIST print in the
+/// client into out_fd.
+/// @param job_fd File descriptor to read the script from, either compiled or text.
+/// @param out_fd File descriptor to print the output to.
+/// @param num_commands Variable to store the number of commands run in.
+/// @param num_failed Variable to store the number of commands that failed in.
+/// @return 0 if the script was run to the end, 1 if it couldn't be read or its output failed to be written.
+int run_job_script(int job_fd, int out_fd, size_t *num_commands, size_t *num_failed);
+
+#endif  // SERVER_JOBS_H
@@ -1,15 +1,36 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "common/fibers.h"
 #include "common/io.h"
+#include "common/locks.h"
 #include "eventlist.h"
+#include "operations.h"
+#include "subscriptions.h"
+
+// [ magic (char[8]) ] | [ lsn (unsigned long long) ] | [ num_events (size_t) ] | [ events ]
+// Event: [ id (unsigned int) ] | [ reservations (unsigned int) ] | [ rows (size_t) ] | [ cols (size_t) ] | [ seats ]
+#define SNAPSHOT_MAGIC "EMSSNAP1"
+#define SNAPSHOT_MAGIC_LEN 8
+#define SNAPSHOT_HEADER_LEN (SNAPSHOT_MAGIC_LEN + sizeof(unsigned long long) + sizeof(size_t))
+#define SNAPSHOT_EVENT_HEADER_LEN (2 * sizeof(unsigned int) + 2 * sizeof(size_t))
+
+// Most seats kept in the change log of an event
+#define EVENT_CHANGES_MAX 4096
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_us = 0;
 
+// Bumped on every event creation, so readers can tell if a copy of the event list is still current
+static unsigned long long events_generation = 0;
+
 /// Gets the event with the given ID from the state.
 /// @note Will wait to simulate a real system accessing a costly memory resource.
 /// @param event_id The ID of the event to get.
@@ -17,8 +38,11 @@ static unsigned int state_access_delay_us = 0;
 /// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
 static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode* from, struct ListNode* to) {
-  struct timespec delay = {0, state_access_delay_us * 1000};
-  nanosleep(&delay, NULL);  // Should not be removed
+  // A zero-length sleep still pays for the syscall and the timer slack, which dominates replays. On a fiber the delay
+  // is a timer wait, the other fibers of the thread running meanwhile.
+  if (state_access_delay_us > 0) {
+    fiber_sleep_ns((long long)state_access_delay_us * 1000);  // Should not be removed
+  }
 
   return get_event(event_list, event_id, from, to);
 }
@@ -31,6 +55,56 @@ static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode
 /// @return Index of the seat.
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
+/// Sets up an empty change log for an event.
+/// @note A delta is only worth sending while it's much smaller than the grid, so the log is kept to a fraction of it.
+/// @param event Event to set up the log of.
+/// @param version Version of the event, the seats reserved up to it aren't in the log.
+static void init_changes(struct Event* event, unsigned int version) {
+  size_t num_seats = event->rows * event->cols;
+  event->changes = NULL;
+  event->changes_capacity = num_seats / 4 < EVENT_CHANGES_MAX ? num_seats / 4 : EVENT_CHANGES_MAX;
+  event->changes_start = 0;
+  event->changes_len = 0;
+  event->changes_since = version;
+}
+
+/// Adds the seats of a reservation to the change log of an event, dropping the oldest ones if it's full.
+/// @note Must be called with the event locked.
+/// @param event Event the reservation was made for.
+/// @param num_seats Number of reserved seats.
+/// @param xs Rows of the seats.
+/// @param ys Columns of the seats.
+/// @param reservation_id Id of the reservation.
+static void record_changes(struct Event* event, size_t num_seats, size_t* xs, size_t* ys, unsigned int reservation_id) {
+  if (event->changes == NULL && event->changes_capacity > 0) {
+    event->changes = malloc(sizeof(struct SeatChange) * event->changes_capacity);
+    if (event->changes == NULL) {
+      event->changes_capacity = 0;
+    }
+  }
+
+  if (num_seats > event->changes_capacity) {
+    // The whole log would be this reservation, and still not all of it
+    event->changes_len = 0;
+    event->changes_since = reservation_id;
+    return;
+  }
+
+  while (event->changes_len + num_seats > event->changes_capacity) {
+    // Dropping a seat of a reservation leaves that reservation, and all the ones before, out of the log
+    event->changes_since = event->changes[event->changes_start].reservation_id;
+    event->changes_start = (event->changes_start + 1) % event->changes_capacity;
+    event->changes_len--;
+  }
+
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t position = (event->changes_start + event->changes_len) % event->changes_capacity;
+    event->changes[position].seat = seat_index(event, xs[i], ys[i]);
+    event->changes[position].reservation_id = reservation_id;
+    event->changes_len++;
+  }
+}
+
 int ems_init(unsigned int delay_us) {
   if (event_list != NULL) {
     fprintf(stderr, "EMS state has already been initialized\n");
@@ -43,19 +117,249 @@ int ems_init(unsigned int delay_us) {
   return event_list == NULL;
 }
 
-int ems_terminate() {
+/// Loads the events of a snapshot into an empty state.
+/// @param snapshot_path Path of the snapshot. A missing snapshot loads nothing.
+/// @param lsn Variable to store the sequence number of the last log record covered by the snapshot.
+/// @return 0 if the snapshot was loaded successfully, 1 otherwise.
+static int load_snapshot(const char* snapshot_path, unsigned long long* lsn) {
+  *lsn = 0;
+
+  int fd = open(snapshot_path, O_RDONLY);
+  if (fd < 0) {
+    return errno != ENOENT;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < SNAPSHOT_HEADER_LEN) {
+    fprintf(stderr, "Invalid snapshot\n");
+    close(fd);
+    return 1;
+  }
+
+  // The seats are copied straight out of the mapping into each event
+  size_t size = (size_t)st.st_size;
+  char* snapshot = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (snapshot == MAP_FAILED) {
+    perror("Failed to map the snapshot");
+    return 1;
+  }
+  posix_madvise(snapshot, size, POSIX_MADV_SEQUENTIAL);
+
+  size_t num_events;
+  memcpy(lsn, snapshot + SNAPSHOT_MAGIC_LEN, sizeof(unsigned long long));
+  memcpy(&num_events, snapshot + SNAPSHOT_MAGIC_LEN + sizeof(unsigned long long), sizeof(size_t));
+
+  int result = memcmp(snapshot, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0;
+  size_t offset = SNAPSHOT_HEADER_LEN;
+
+  for (size_t i = 0; i < num_events && result == 0; i++) {
+    if (size - offset < SNAPSHOT_EVENT_HEADER_LEN) {
+      result = 1;
+      break;
+    }
+
+    struct Event* event = malloc(sizeof(struct Event));
+    if (event == NULL) {
+      result = 1;
+      break;
+    }
+    memcpy(&event->id, snapshot + offset, sizeof(unsigned int));
+    memcpy(&event->reservations, snapshot + offset + sizeof(unsigned int), sizeof(unsigned int));
+    memcpy(&event->rows, snapshot + offset + 2 * sizeof(unsigned int), sizeof(size_t));
+    memcpy(&event->cols, snapshot + offset + 2 * sizeof(unsigned int) + sizeof(size_t), sizeof(size_t));
+    offset += SNAPSHOT_EVENT_HEADER_LEN;
+
+    size_t num_seats = event->rows * event->cols;
+    if (event->cols != 0 &&
+        (num_seats / event->cols != event->rows || (size - offset) / sizeof(unsigned int) < num_seats)) {
+      free(event);
+      result = 1;
+      break;
+    }
+
+    event->data = malloc(sizeof(unsigned int) * (num_seats > 0 ? num_seats : 1));
+    if (event->data == NULL || pthread_mutex_init(&event->mutex, NULL) != 0) {
+      free(event->data);
+      free(event);
+      result = 1;
+      break;
+    }
+    memcpy(event->data, snapshot + offset, sizeof(unsigned int) * num_seats);
+    offset += sizeof(unsigned int) * num_seats;
+    init_changes(event, event->reservations);
+
+    if (append_to_list(event_list, event) != 0) {
+      pthread_mutex_destroy(&event->mutex);
+      free(event->data);
+      free(event);
+      result = 1;
+    } else {
+      __atomic_add_fetch(&events_generation, 1, __ATOMIC_RELEASE);
+    }
+  }
+
+  munmap(snapshot, size);
+
+  if (result) {
+    fprintf(stderr, "Invalid snapshot\n");
+  } else if (num_events > 0) {
+    fprintf(stdout, "Loaded %zu events from the snapshot.\n", num_events);
+  }
+  return result;
+}
+
+int ems_enable_log(const char* log_path, const char* snapshot_path, enum WalMode mode) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
+  if (event_list->head != NULL) {
+    fprintf(stderr, "EMS state must be empty\n");
+    return 1;
+  }
+
+  unsigned long long snapshot_lsn = 0;
+  if (snapshot_path != NULL && load_snapshot(snapshot_path, &snapshot_lsn)) {
+    fprintf(stderr, "Failed to load the snapshot\n");
+    return 1;
+  }
+
+  // Replaying rebuilds the state, not a slow store, so it skips the access delay
+  unsigned int delay_us = state_access_delay_us;
+  state_access_delay_us = 0;
+  long records = wal_replay(log_path, snapshot_lsn, ems_create, ems_reserve);
+  state_access_delay_us = delay_us;
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
+  if (records < 0) {
+    fprintf(stderr, "Failed to replay the log\n");
+    return 1;
+  }
+  if ((unsigned long long)records < snapshot_lsn) {
+    // The records after the snapshot would get sequence numbers the snapshot already covers
+    fprintf(stderr, "The log is behind the snapshot\n");
     return 1;
   }
+  if ((unsigned long long)records > snapshot_lsn) {
+    fprintf(stdout, "Replayed %llu records from the log.\n", (unsigned long long)records - snapshot_lsn);
+  }
+
+  return wal_open(log_path, mode, (unsigned long long)records);
+}
+
+int ems_save_snapshot(const char* snapshot_path) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Every record up to this one was applied under the lock its event is copied under below, so the snapshot holds
+  // at least those. Records after it may be in the snapshot too, replaying them again fails without changes, as
+  // creations find their event already there and reservations, never empty, find their seats already taken.
+  unsigned long long lsn = wal_last_lsn();
+  wal_commit(lsn);
+
+  // Events are only appended, so the nodes up to the current tail can be walked without the list lock
+  rwlock_rdlock(&event_list->rwl);
+  struct ListNode* from = event_list->head;
+  struct ListNode* to = event_list->tail;
+  rwlock_unlock(&event_list->rwl);
+
+  size_t num_events = 0;
+  for (struct ListNode* current = from; current != NULL; current = current == to ? NULL : current->next) {
+    num_events++;
+  }
+
+  // Written next to the snapshot and renamed over it, so a crash never leaves a partial snapshot behind
+  char temp_path[PATH_MAX];
+  if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", snapshot_path) >= (int)sizeof(temp_path)) {
+    fprintf(stderr, "Snapshot path is too long\n");
+    return 1;
+  }
+  int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+  if (fd < 0) {
+    perror("Failed to open the snapshot");
+    return 1;
+  }
+
+  write_buffer_t* out = malloc(sizeof(write_buffer_t));
+  if (out == NULL) {
+    perror("Error allocating memory for the snapshot");
+    close(fd);
+    unlink(temp_path);
+    return 1;
+  }
+  write_buffer_init(out, fd);
+
+  int result = buffered_print(out, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) ||
+               buffered_print(out, &lsn, sizeof(unsigned long long)) ||
+               buffered_print(out, &num_events, sizeof(size_t));
+
+  unsigned int* seats = NULL;
+  size_t seats_capacity = 0;
+
+  for (struct ListNode* current = from; current != NULL && result == 0;
+       current = current == to ? NULL : current->next) {
+    struct Event* event = current->event;
+
+    mutex_lock(&event->mutex);
+
+    size_t num_seats = event->rows * event->cols;
+    if (num_seats > seats_capacity) {
+      unsigned int* temp = realloc(seats, sizeof(unsigned int) * num_seats);
+      if (temp == NULL) {
+        perror("Error allocating memory for the snapshot");
+        mutex_unlock(&event->mutex);
+        result = 1;
+        break;
+      }
+      seats = temp;
+      seats_capacity = num_seats;
+    }
+    memcpy(seats, event->data, sizeof(unsigned int) * num_seats);
+    unsigned int reservations = event->reservations;
+
+    mutex_unlock(&event->mutex);
+
+    result = buffered_print(out, &event->id, sizeof(unsigned int)) ||
+             buffered_print(out, &reservations, sizeof(unsigned int)) ||
+             buffered_print(out, &event->rows, sizeof(size_t)) || buffered_print(out, &event->cols, sizeof(size_t)) ||
+             buffered_print(out, seats, sizeof(unsigned int) * num_seats);
+  }
+
+  // The log is never cut, so losing the rename in a crash only means replaying more of it
+  if (result == 0) {
+    result = write_buffer_flush(out) || fsync(fd) != 0;
+  }
+  if (close(fd) != 0) {
+    result = 1;
+  }
+  if (result == 0 && rename(temp_path, snapshot_path) != 0) {
+    perror("Failed to replace the snapshot");
+    result = 1;
+  }
+  if (result) {
+    fprintf(stderr, "Failed to write the snapshot\n");
+    unlink(temp_path);
+  }
+
+  free(seats);
+  free(out);
+  return result;
+}
+
+int ems_terminate() {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  wal_close();
+
+  rwlock_wrlock(&event_list->rwl);
 
   free_list(event_list);
-  pthread_rwlock_unlock(&event_list->rwl);
+  rwlock_unlock(&event_list->rwl);
   return 0;
 }
 
@@ -65,14 +369,11 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
+  rwlock_wrlock(&event_list->rwl);
 
   if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
     fprintf(stderr, "Event already exists\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     return 1;
   }
 
@@ -80,7 +381,7 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
 
   if (event == NULL) {
     fprintf(stderr, "Error allocating memory for event\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     return 1;
   }
 
@@ -88,8 +389,9 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   event->rows = num_rows;
   event->cols = num_cols;
   event->reservations = 0;
+  init_changes(event, 0);
   if (pthread_mutex_init(&event->mutex, NULL) != 0) {
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     free(event);
     return 1;
   }
@@ -97,149 +399,308 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
 
   if (event->data == NULL) {
     fprintf(stderr, "Error allocating memory for event data\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     free(event);
     return 1;
   }
 
   if (append_to_list(event_list, event) != 0) {
     fprintf(stderr, "Error appending event to list\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     free(event->data);
     free(event);
     return 1;
   }
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  __atomic_add_fetch(&events_generation, 1, __ATOMIC_RELEASE);
+
+  // Logged under the list lock, so the log has the creations in the order they were applied
+  unsigned long long lsn = wal_append_create(event_id, num_rows, num_cols);
+
+  rwlock_unlock(&event_list->rwl);
+
+  wal_commit(lsn);
   return 0;
 }
 
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+/// Gets an event from the state, without holding any lock afterwards.
+/// @param event_id Id of the event.
+/// @return Pointer to the event if found, NULL otherwise.
+static struct Event* find_event(unsigned int event_id) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
-    return 1;
+    return NULL;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
+  rwlock_rdlock(&event_list->rwl);
 
   struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  rwlock_unlock(&event_list->rwl);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
-    return 1;
   }
+  return event;
+}
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    fprintf(stderr, "Error locking mutex\n");
+/// Reserves seats of an event, either all of them or none.
+/// @note Must be called with the event locked.
+/// @param event Event to reserve the seats of.
+/// @param num_seats Number of seats to reserve.
+/// @param xs Rows of the seats.
+/// @param ys Columns of the seats.
+/// @param lsn Variable to store the log record of the reservation in, to be committed once the event is unlocked.
+/// @return 0 if the seats were reserved, 1 otherwise.
+static int reserve_locked(struct Event* event, size_t num_seats, size_t* xs, size_t* ys, unsigned long long* lsn) {
+  // An empty reservation would still take a reservation id, and replaying it over a snapshot would shift the later ones
+  if (num_seats == 0) {
+    fprintf(stderr, "No seats to reserve\n");
     return 1;
   }
 
   for (size_t i = 0; i < num_seats; i++) {
     if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
       fprintf(stderr, "Seat out of bounds\n");
-      pthread_mutex_unlock(&event->mutex);
       return 1;
     }
   }
 
-  for (size_t i = 0; i < event->rows * event->cols; i++) {
-    for (size_t j = 0; j < num_seats; j++) {
-      if (seat_index(event, xs[j], ys[j]) != i) {
-        continue;
+  // Each seat is looked up directly, instead of scanning the grid for it. Seats are taken as they're checked, so a
+  // seat repeated in the request finds itself taken, and the ones taken so far are given back on failure.
+  unsigned int reservation_id = event->reservations + 1;
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t index = seat_index(event, xs[i], ys[i]);
+    if (event->data[index] != 0) {
+      for (size_t j = 0; j < i; j++) {
+        event->data[seat_index(event, xs[j], ys[j])] = 0;
       }
+      fprintf(stderr, "Seat already reserved\n");
+      return 1;
+    }
+    event->data[index] = reservation_id;
+  }
+  event->reservations = reservation_id;
 
-      if (event->data[i] != 0) {
-        fprintf(stderr, "Seat already reserved\n");
-        pthread_mutex_unlock(&event->mutex);
-        return 1;
-      }
+  record_changes(event, num_seats, xs, ys, reservation_id);
+  subscriptions_publish(event->id, reservation_id, num_seats, xs, ys);
 
-      break;
+  // Logged under the event lock, so replaying gives out the same reservation ids
+  *lsn = wal_append_reserve(event->id, num_seats, xs, ys);
+  return 0;
+}
+
+int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  mutex_lock(&event->mutex);
+
+  unsigned long long lsn;
+  int result = reserve_locked(event, num_seats, xs, ys, &lsn);
+  mutex_unlock(&event->mutex);
+
+  if (result == 0) {
+    wal_commit(lsn);
+  }
+  return result;
+}
+
+int ems_reserve_ranges(unsigned int event_id, size_t num_ranges, const seat_range_t* ranges) {
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  // The size of an event never changes, so the ranges are checked and expanded before taking its lock. No block can be
+  // larger than the venue, and as a seat can't be reserved twice, neither can all of them together.
+  size_t num_seats = 0;
+  for (size_t i = 0; i < num_ranges; i++) {
+    const seat_range_t* range = &ranges[i];
+    if (range->first_row <= 0 || range->first_row > range->last_row || range->last_row > event->rows ||
+        range->first_col <= 0 || range->first_col > range->last_col || range->last_col > event->cols) {
+      fprintf(stderr, "Seat out of bounds\n");
+      return 1;
+    }
+    size_t range_seats = (range->last_row - range->first_row + 1) * (range->last_col - range->first_col + 1);
+    if (range_seats > event->rows * event->cols - num_seats) {
+      fprintf(stderr, "More seats than the event has\n");
+      return 1;
     }
+    num_seats += range_seats;
   }
 
-  unsigned int reservation_id = ++event->reservations;
+  size_t* xs = malloc(sizeof(size_t) * num_seats);
+  size_t* ys = malloc(sizeof(size_t) * num_seats);
+  if (num_seats > 0 && (xs == NULL || ys == NULL)) {
+    perror("Error allocating memory for the seats");
+    free(xs);
+    free(ys);
+    return 1;
+  }
 
-  for (size_t i = 0; i < num_seats; i++) {
-    event->data[seat_index(event, xs[i], ys[i])] = reservation_id;
+  // Blocks are expanded in row-major order
+  size_t seat = 0;
+  for (size_t i = 0; i < num_ranges; i++) {
+    for (size_t row = ranges[i].first_row; row <= ranges[i].last_row; row++) {
+      for (size_t col = ranges[i].first_col; col <= ranges[i].last_col; col++) {
+        xs[seat] = row;
+        ys[seat] = col;
+        seat++;
+      }
+    }
   }
 
-  pthread_mutex_unlock(&event->mutex);
-  return 0;
+  mutex_lock(&event->mutex);
+
+  unsigned long long lsn;
+  int result = reserve_locked(event, num_seats, xs, ys, &lsn);
+  mutex_unlock(&event->mutex);
+  free(xs);
+  free(ys);
+
+  if (result == 0) {
+    wal_commit(lsn);
+  }
+  return result;
 }
 
-int get_event_info(unsigned int event_id, size_t* cols, unsigned int** data, size_t* rows) {
-  if (event_list == NULL) {
-    fprintf(stderr, "EMS state must be initialized\n");
-    *cols = 0;
-    *data = NULL;
-    *rows = 0;
+int get_event_version(unsigned int event_id, unsigned int* version, size_t* rows, size_t* cols) {
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
+  mutex_lock(&event->mutex);
+
+  *version = event->reservations;
+  *rows = event->rows;
+  *cols = event->cols;
+
+  mutex_unlock(&event->mutex);
+  return 0;
+}
+
+int get_event_seats(unsigned int event_id, void* seats, unsigned int* version) {
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
     return 1;
   }
 
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  mutex_lock(&event->mutex);
+
+  memcpy(seats, event->data, sizeof(unsigned int) * event->rows * event->cols);
+  *version = event->reservations;
+
+  mutex_unlock(&event->mutex);
+  return 0;
+}
 
-  pthread_rwlock_unlock(&event_list->rwl);
+int get_event_changes(unsigned int event_id, unsigned int since, int compress, struct EventChanges* changes) {
+  changes->num_changes = 0;
+  changes->seats = NULL;
+  changes->reservation_ids = NULL;
+  changes->full = 0;
+  changes->runs = NULL;
+  changes->runs_len = 0;
 
+  struct Event* event = find_event(event_id);
   if (event == NULL) {
-    fprintf(stderr, "Event not found\n");
-    *cols = 0;
-    *data = NULL;
-    *rows = 0;
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    fprintf(stderr, "Error locking mutex\n");
-    *cols = 0;
-    *data = NULL;
-    *rows = 0;
-    return 1;
+  mutex_lock(&event->mutex);
+
+  changes->version = event->reservations;
+  changes->rows = event->rows;
+  changes->cols = event->cols;
+
+  // A version ahead of the event can't be trusted, it's not from this state
+  // The grid itself is left to the caller, which can share it between sessions
+  if (since < event->changes_since || since > event->reservations) {
+    changes->full = 1;
+    if (!compress) {
+      mutex_unlock(&event->mutex);
+      return 0;
+    }
+
+    size_t grid_len = sizeof(unsigned int) * event->rows * event->cols;
+    char* runs = malloc(grid_len);
+    if (runs == NULL) {
+      mutex_unlock(&event->mutex);
+      perror("Error allocating memory for the seats");
+      return 1;
+    }
+
+    // Encoded straight from the event into a buffer the size of the grid, used only if the runs fit in it
+    changes->runs_len = rle_encode_seats(event->data, event->rows * event->cols, runs, grid_len);
+    if (changes->runs_len > 0) {
+      changes->runs = runs;
+    } else {
+      free(runs);
+    }
+    mutex_unlock(&event->mutex);
+    return 0;
   }
 
-  *cols = event->cols;
-  *data = event->data;
-  *rows = event->rows;
+  // The newest seats are at the end of the ring, so the ones to send are a suffix of it
+  size_t first = event->changes_len;
+  while (first > 0 &&
+         event->changes[(event->changes_start + first - 1) % event->changes_capacity].reservation_id > since) {
+    first--;
+  }
+  size_t num_changes = event->changes_len - first;
 
-  pthread_mutex_unlock(&event->mutex);
+  if (num_changes > 0) {
+    changes->seats = malloc(sizeof(size_t) * num_changes);
+    changes->reservation_ids = malloc(sizeof(unsigned int) * num_changes);
+    if (changes->seats == NULL || changes->reservation_ids == NULL) {
+      mutex_unlock(&event->mutex);
+      perror("Error allocating memory for the changes");
+      free_event_changes(changes);
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < num_changes; i++) {
+    struct SeatChange* change = &event->changes[(event->changes_start + first + i) % event->changes_capacity];
+    changes->seats[i] = change->seat;
+    changes->reservation_ids[i] = change->reservation_id;
+  }
+  changes->num_changes = num_changes;
 
+  mutex_unlock(&event->mutex);
   return 0;
 }
 
+void free_event_changes(struct EventChanges* changes) {
+  free(changes->seats);
+  free(changes->reservation_ids);
+  free(changes->runs);
+  changes->seats = NULL;
+  changes->reservation_ids = NULL;
+  changes->runs = NULL;
+}
+
 int ems_show(unsigned int event_id) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
+  rwlock_rdlock(&event_list->rwl);
 
   struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  rwlock_unlock(&event_list->rwl);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    fprintf(stderr, "Error locking mutex\n");
-    return 1;
-  }
+  mutex_lock(&event->mutex);
 
   for (size_t i = 1; i <= event->rows; i++) {
     for (size_t j = 1; j <= event->cols; j++) {
@@ -254,20 +715,19 @@ int ems_show(unsigned int event_id) {
     printf("\n");
   }
 
-  pthread_mutex_unlock(&event->mutex);
+  mutex_unlock(&event->mutex);
   return 0;
 }
 
+unsigned long long ems_events_generation() { return __atomic_load_n(&events_generation, __ATOMIC_ACQUIRE); }
+
 int get_events(unsigned int** data, size_t* num_events) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
+  rwlock_rdlock(&event_list->rwl);
 
   struct ListNode* to = event_list->tail;
   struct ListNode* current = event_list->head;
@@ -275,7 +735,7 @@ int get_events(unsigned int** data, size_t* num_events) {
   if (current == NULL) {
     *data = NULL;
     *num_events = 0;
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     return 0;
   }
 
@@ -284,7 +744,7 @@ int get_events(unsigned int** data, size_t* num_events) {
   unsigned int* event_ids = (unsigned int*)malloc(sizeof(unsigned int) * array_size);
   if (event_ids == NULL) {
     perror("Error allocating memory for event IDs");
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     return 1;
   }
 
@@ -305,7 +765,7 @@ int get_events(unsigned int** data, size_t* num_events) {
       if (temp == NULL) {
         perror("Error reallocating memory for event IDs");
         free(event_ids);
-        pthread_rwlock_unlock(&event_list->rwl);
+        rwlock_unlock(&event_list->rwl);
         return 1;
       }
       event_ids = temp;
@@ -316,7 +776,7 @@ int get_events(unsigned int** data, size_t* num_events) {
   *data = event_ids;
   *num_events = i;
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  rwlock_unlock(&event_list->rwl);
   return 0;
 }
 
@@ -326,16 +786,13 @@ int ems_list_events() {
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
+  rwlock_rdlock(&event_list->rwl);
 
   struct ListNode* current = event_list->head;
 
   if (current == NULL) {
     printf("No events\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+    rwlock_unlock(&event_list->rwl);
     return 0;
   }
 
@@ -349,6 +806,74 @@ int ems_list_events() {
   }
   printf("---------------------------\n");
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  rwlock_unlock(&event_list->rwl);
   return 0;
-}
\ No newline at end of file
+}
+
+int ems_dump_events(int out_fd) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Events are only appended, so the nodes up to the current tail can be walked without the list lock
+  rwlock_rdlock(&event_list->rwl);
+  struct ListNode* current = event_list->head;
+  struct ListNode* to = event_list->tail;
+  rwlock_unlock(&event_list->rwl);
+
+  write_buffer_t* out = malloc(sizeof(write_buffer_t));
+  if (out == NULL) {
+    perror("Error allocating memory for the dump");
+    return 1;
+  }
+  write_buffer_init(out, out_fd);
+
+  if (current == NULL) {
+    int result = buffered_print(out, "No events\n", 10) || write_buffer_flush(out);
+    free(out);
+    return result;
+  }
+
+  unsigned int* seats = NULL;
+  size_t seats_capacity = 0;
+  int result = 0;
+
+  while (result == 0) {
+    struct Event* event = current->event;
+
+    mutex_lock(&event->mutex);
+
+    size_t num_seats = event->rows * event->cols;
+    if (num_seats > seats_capacity) {
+      unsigned int* temp = realloc(seats, sizeof(unsigned int) * num_seats);
+      if (temp == NULL) {
+        perror("Error allocating memory for the dump");
+        mutex_unlock(&event->mutex);
+        result = 1;
+        break;
+      }
+      seats = temp;
+      seats_capacity = num_seats;
+    }
+    memcpy(seats, event->data, sizeof(unsigned int) * num_seats);
+
+    mutex_unlock(&event->mutex);
+
+    result = buffered_print(out, "---------------------------\nEvent: ", 35) || buffered_print_uint(out, event->id) ||
+             buffered_print(out, "\n", 1) || buffered_print_event(out, event->rows, event->cols, seats);
+
+    if (current == to) {
+      break;
+    }
+    current = current->next;
+  }
+
+  if (result == 0) {
+    result = buffered_print(out, "---------------------------\n", 28) || write_buffer_flush(out);
+  }
+
+  free(seats);
+  free(out);
+  return result;
+}
@@ -3,11 +3,41 @@
 
 #include <stddef.h>
 
+#include "common/io.h"
+#include "wal.h"
+
+// Seats reserved for an event after some version
+struct EventChanges {
+  unsigned int version;           // Current version of the event
+  size_t rows;                    // Number of rows of the event
+  size_t cols;                    // Number of columns of the event
+  size_t num_changes;             // Number of reserved seats listed
+  size_t* seats;                  // Indices of the reserved seats, oldest first
+  unsigned int* reservation_ids;  // Reservation that took each seat
+  int full;                       // Whether every seat must be sent instead, as the changes are no longer known
+  char* runs;                     // Every seat run-length encoded, set when full and shorter than the grid
+  size_t runs_len;                // Length of the runs
+};
+
 /// Initializes the EMS state.
 /// @param delay_us Delay in microseconds.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
 int ems_init(unsigned int delay_us);
 
+/// Rebuilds the EMS state from a snapshot and the tail of a write-ahead log, and logs every following creation and
+/// reservation to it.
+/// @param log_path Path of the log, created if missing.
+/// @param snapshot_path Path of the snapshot, NULL to replay the whole log.
+/// @param mode When the logged operations are made durable.
+/// @return 0 if the state was rebuilt and the log opened successfully, 1 otherwise.
+int ems_enable_log(const char* log_path, const char* snapshot_path, enum WalMode mode);
+
+/// Writes a snapshot of every event, to be loaded by ems_enable_log instead of replaying the whole log.
+/// @note Each event is only locked while its seats are copied, so operations keep running while it's written.
+/// @param snapshot_path Path of the snapshot, replaced atomically.
+/// @return 0 if the snapshot was written successfully, 1 otherwise.
+int ems_save_snapshot(const char* snapshot_path);
+
 /// Destroys the EMS state.
 int ems_terminate();
 
@@ -26,13 +56,46 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
-/// Gets information about a specific event.
-/// @param event_id The id of the event to retrive information.
-/// @param cols The variable to store the number of columns.
-/// @param data The variable to store the data.
-/// @param rows The variable to store the number of rows.
+/// Creates a new reservation for blocks of seats of the given event, expanded into seats once checked against it.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_ranges Number of blocks of seats to reserve.
+/// @param ranges Blocks of seats to reserve.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_ranges(unsigned int event_id, size_t num_ranges, const seat_range_t* ranges);
+
+/// Gets the version of an event and its dimensions.
+/// @note The version is the number of reservations made for the event, so it changes with every reservation and
+/// identifies the same seats across restarts.
+/// @param event_id Id of the event.
+/// @param version Variable to store the version.
+/// @param rows Variable to store the number of rows.
+/// @param cols Variable to store the number of columns.
 /// @return 0 if successful, 1 otherwise.
-int get_event_info(unsigned int event_id, size_t* cols, unsigned int** data, size_t* rows);
+int get_event_version(unsigned int event_id, unsigned int* version, size_t* rows, size_t* cols);
+
+/// Copies the seats of an event.
+/// @param event_id Id of the event.
+/// @param seats Where to copy the rows * cols seats to, no alignment required.
+/// @param version Variable to store the version the copied seats belong to.
+/// @return 0 if successful, 1 otherwise.
+int get_event_seats(unsigned int event_id, void* seats, unsigned int* version);
+
+/// Gets the generation of the event list, which changes every time an event is created.
+/// @note Read before get_events, a copy of the ids is current for as long as the generation stays the same.
+/// @return Current generation.
+unsigned long long ems_events_generation();
+
+/// Gets the seats reserved for an event after a version, or all of its seats if those are no longer known.
+/// @param event_id Id of the event.
+/// @param since Version to get the changes from, 0 for every reserved seat.
+/// @param compress Whether every seat may be given run-length encoded instead of as a grid.
+/// @param changes Variable to store the changes in, to be freed with free_event_changes.
+/// @return 0 if successful, 1 otherwise.
+int get_event_changes(unsigned int event_id, unsigned int since, int compress, struct EventChanges* changes);
+
+/// Frees what get_event_changes allocated.
+/// @param changes Changes to free.
+void free_event_changes(struct EventChanges* changes);
 
 /// Gets all event ids.
 /// @param data Variable to store event ids.
@@ -49,4 +112,10 @@ int ems_show(unsigned int event_id);
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events();
 
+/// Prints all the events from a snapshot, in the same format as ems_list_events.
+/// @note Each event is only locked while its seats are copied, the output is written without holding any lock.
+/// @param out_fd File descriptor to print the events to.
+/// @return 0 if the events were printed successfully, 1 otherwise.
+int ems_dump_events(int out_fd);
+
 #endif  // SERVER_OPERATIONS_H
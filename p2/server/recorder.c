@@ -0,0 +1,196 @@
+#include "recorder.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common/clock.h"
+#include "common/constants.h"
+#include "common/locks.h"
+
+// Trace being recorded to, NULL when not recording. Each record is written under trace_lock, so records of different
+// workers never interleave and the trace is never closed under one.
+static FILE *trace = NULL;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static long long trace_start_ns = 0;
+static unsigned int next_connection = 0;
+
+/// Checks without locking if requests are being recorded, so sessions don't take the lock when they're not.
+/// @return 1 if recording, 0 otherwise.
+static int recording() { return __atomic_load_n(&trace, __ATOMIC_ACQUIRE) != NULL; }
+
+/// Locks the trace to write a record to it.
+/// @return 1 if recording, with the trace locked, 0 otherwise.
+static int lock_trace() {
+  if (!recording()) {
+    return 0;
+  }
+
+  mutex_lock(&trace_lock);
+  if (trace == NULL) {
+    mutex_unlock(&trace_lock);
+    return 0;
+  }
+  return 1;
+}
+
+/// Writes the header of a record. Must be called with the trace locked.
+/// @param op_code Op code of the request.
+/// @param connection Connection of the request.
+/// @param payload_len Length of the payload that follows.
+static void write_header(char op_code, unsigned int connection, size_t payload_len) {
+  uint32_t record_connection = connection, record_len = (uint32_t)payload_len;
+  uint64_t time_ns = (uint64_t)(clock_now_ns() - trace_start_ns);
+
+  fwrite(&op_code, sizeof(char), 1, trace);
+  fwrite(&record_connection, sizeof(uint32_t), 1, trace);
+  fwrite(&time_ns, sizeof(uint64_t), 1, trace);
+  fwrite(&record_len, sizeof(uint32_t), 1, trace);
+}
+
+/// Writes a record whose payload is a single piece.
+/// @param op_code Op code of the request.
+/// @param connection Connection of the request.
+/// @param payload Payload of the record.
+/// @param payload_len Length of the payload.
+static void write_record(char op_code, unsigned int connection, const void *payload, size_t payload_len) {
+  if (!lock_trace()) {
+    return;
+  }
+  write_header(op_code, connection, payload_len);
+  if (payload_len > 0) {
+    fwrite(payload, 1, payload_len, trace);
+  }
+  mutex_unlock(&trace_lock);
+}
+
+int recorder_open(const char *path) {
+  FILE *opened = fopen(path, "w");
+  if (opened == NULL) {
+    perror("Failed to open the trace");
+    return 1;
+  }
+
+  if (fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, opened) != TRACE_MAGIC_LEN) {
+    perror("Failed to write the trace");
+    fclose(opened);
+    return 1;
+  }
+
+  mutex_lock(&trace_lock);
+  trace_start_ns = clock_now_ns();
+  __atomic_store_n(&trace, opened, __ATOMIC_RELEASE);
+  mutex_unlock(&trace_lock);
+  return 0;
+}
+
+unsigned int recorder_setup(char wire_version) {
+  if (!recording()) {
+    return 0;
+  }
+
+  unsigned int connection = __atomic_add_fetch(&next_connection, 1, __ATOMIC_RELAXED);
+  write_record(OP_CODE_SETUP_REQUEST, connection, &wire_version, sizeof(char));
+  return connection;
+}
+
+void recorder_create(unsigned int connection, unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (!recording()) {
+    return;
+  }
+
+  char payload[sizeof(unsigned int) + 2 * sizeof(size_t)];
+  size_t offset = 0;
+  create_message(payload, &offset, &event_id, sizeof(unsigned int));
+  create_message(payload, &offset, &num_rows, sizeof(size_t));
+  create_message(payload, &offset, &num_cols, sizeof(size_t));
+  write_record(OP_CODE_CREATE_REQUEST, connection, payload, offset);
+}
+
+void recorder_reserve(unsigned int connection, unsigned int event_id, const seat_buffer_t *seats) {
+  if (!recording()) {
+    return;
+  }
+
+  if (!lock_trace()) {
+    return;
+  }
+  write_header(OP_CODE_RESERVE_REQUEST, connection, sizeof(unsigned int) + sizeof(size_t) * (1 + 2 * seats->len));
+  fwrite(&event_id, sizeof(unsigned int), 1, trace);
+  fwrite(&seats->len, sizeof(size_t), 1, trace);
+  fwrite(seats->xs, sizeof(size_t), seats->len, trace);
+  fwrite(seats->ys, sizeof(size_t), seats->len, trace);
+  mutex_unlock(&trace_lock);
+}
+
+void recorder_reserve_ranges(unsigned int connection, unsigned int event_id, size_t num_ranges,
+                             const seat_range_t *ranges) {
+  if (!recording()) {
+    return;
+  }
+
+  if (!lock_trace()) {
+    return;
+  }
+  write_header(OP_CODE_RESERVE_RANGES_REQUEST, connection,
+               sizeof(unsigned int) + sizeof(size_t) + sizeof(seat_range_t) * num_ranges);
+  fwrite(&event_id, sizeof(unsigned int), 1, trace);
+  fwrite(&num_ranges, sizeof(size_t), 1, trace);
+  fwrite(ranges, sizeof(seat_range_t), num_ranges, trace);
+  mutex_unlock(&trace_lock);
+}
+
+void recorder_show(unsigned int connection, char op_code, unsigned int event_id, unsigned int since,
+                   char encodings) {
+  if (!recording()) {
+    return;
+  }
+
+  char payload[2 * sizeof(unsigned int) + sizeof(char)];
+  size_t offset = 0;
+  create_message(payload, &offset, &event_id, sizeof(unsigned int));
+  if (op_code == OP_CODE_SHOW_SINCE_REQUEST) {
+    create_message(payload, &offset, &since, sizeof(unsigned int));
+    create_message(payload, &offset, &encodings, sizeof(char));
+  }
+  write_record(op_code, connection, payload, offset);
+}
+
+void recorder_list(unsigned int connection) {
+  if (!recording()) {
+    return;
+  }
+
+  write_record(OP_CODE_LIST_REQUEST, connection, NULL, 0);
+}
+
+void recorder_run_job(unsigned int connection, int job_fd) {
+  if (!recording()) {
+    return;
+  }
+
+  off_t end = job_fd != -1 ? lseek(job_fd, 0, SEEK_END) : 0;
+  size_t script_len = end > 0 ? (size_t)end : 0;
+  char *script = malloc(script_len > 0 ? script_len : 1);
+  if (script == NULL || (script_len > 0 && pread(job_fd, script, script_len, 0) != (ssize_t)script_len)) {
+    fprintf(stderr, "Failed to record a job script\n");
+    free(script);
+    return;
+  }
+
+  write_record(OP_CODE_RUN_JOB_REQUEST, connection, script, script_len);
+  free(script);
+}
+
+void recorder_close() {
+  // Cleared under the lock, so closing waits for the record being written and the ones after see there's no trace
+  mutex_lock(&trace_lock);
+  FILE *closed = trace;
+  __atomic_store_n(&trace, NULL, __ATOMIC_RELEASE);
+  mutex_unlock(&trace_lock);
+
+  if (closed != NULL && fclose(closed) != 0) {
+    perror("Failed to write the trace");
+  }
+}
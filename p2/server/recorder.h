@@ -0,0 +1,61 @@
+#ifndef SERVER_RECORDER_H
+#define SERVER_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/io.h"
+
+// A trace is TRACE_MAGIC followed by a record for every request decoded by the server, in the order they were:
+// [ op code (char) ] | [ connection (uint32_t) ] | [ time_ns (uint64_t) ] | [ payload_len (uint32_t) ] | [ payload ]
+// The connection tells sessions apart, even those served by the same worker one after the other, and the time is
+// taken from when the trace was opened. Payloads are in host byte order and sizes, like the write-ahead log:
+//   OP_CODE_SETUP_REQUEST           <wire version (char)>
+//   OP_CODE_CREATE_REQUEST          <event id (unsigned int)> <rows (size_t)> <columns (size_t)>
+//   OP_CODE_RESERVE_REQUEST         <event id> <seats (size_t)> <rows (size_t each)> <columns (size_t each)>
+//   OP_CODE_RESERVE_RANGES_REQUEST  <event id> <blocks (size_t)> <blocks (seat_range_t each)>
+//   OP_CODE_SHOW_REQUEST            <event id>
+//   OP_CODE_SHOW_SINCE_REQUEST      <event id> <since (unsigned int)> <encodings (char)>
+//   OP_CODE_LIST_REQUEST            nothing
+//   OP_CODE_RUN_JOB_REQUEST         <the whole job script>
+// Reservations streamed in chunks and job scripts sent in chunks are recorded once whole.
+#define TRACE_MAGIC "EMSTRACE"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_HEADER_LEN (sizeof(char) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t))
+
+/// Opens a trace to record every request to from now on, replacing any file at its path.
+/// @param path Path of the trace.
+/// @return 0 if successful, 1 otherwise.
+int recorder_open(const char *path);
+
+/// Records the setup of a session.
+/// @param wire_version Encoding the session agreed on.
+/// @return Connection the requests of the session are to be recorded under, 0 when not recording.
+unsigned int recorder_setup(char wire_version);
+
+/// Records a CREATE request.
+void recorder_create(unsigned int connection, unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Records a RESERVE request, with every chunk of its seats.
+void recorder_reserve(unsigned int connection, unsigned int event_id, const seat_buffer_t *seats);
+
+/// Records a RESERVE_RANGES request.
+void recorder_reserve_ranges(unsigned int connection, unsigned int event_id, size_t num_ranges,
+                             const seat_range_t *ranges);
+
+/// Records a SHOW request, or a SHOW_SINCE one when the session asked for the changes since a version.
+/// @param op_code OP_CODE_SHOW_REQUEST or OP_CODE_SHOW_SINCE_REQUEST.
+void recorder_show(unsigned int connection, char op_code, unsigned int event_id, unsigned int since,
+                   char encodings);
+
+/// Records a LIST request.
+void recorder_list(unsigned int connection);
+
+/// Records a RUN_JOB request along with the script it runs.
+/// @param job_fd Job script of the session, -1 when it sent none. Its offset is left unspecified.
+void recorder_run_job(unsigned int connection, int job_fd);
+
+/// Flushes and closes the trace once the record being written is done. Requests after it are no longer recorded.
+void recorder_close();
+
+#endif  // SERVER_RECORDER_H
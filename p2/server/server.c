@@ -9,14 +9,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include "common/clock.h"
 #include "common/constants.h"
 #include "common/io.h"
+#include "jobs.h"
 #include "operations.h"
 #include "producer-consumer.h"
+#include "recorder.h"
+#include "stats.h"
+#include "subscriptions.h"
+#include "uring.h"
 #include "workers.h"
 
 // Requests queue
@@ -29,17 +37,87 @@ static pthread_t *workers;
 char *server_pipename;
 int server_fd;
 
-// Signals
-volatile sig_atomic_t received_sigusr1 = 0;
+// Path of the listening socket, NULL when the server listens on a FIFO
+const char *server_socket_path = NULL;
 
-void sigusr1_handler(int signum) {
-  printf("Received SIGUSR1 signal\n");
-  received_sigusr1 = signum;
-}
+// I/O backend serving the socket sessions
+enum IoBackend io_backend = IO_BACKEND_BLOCKING;
+
+// Write-ahead log, disabled when there's no path
+const char *log_path = NULL;
+enum WalMode log_mode = WAL_BATCHED;
+
+// Trace every decoded request is recorded to, disabled when there's no path
+const char *trace_path = NULL;
+
+// Snapshot of the state next to the log, written every snapshot_interval seconds, never when 0
+char snapshot_path[PATH_MAX];
+unsigned int snapshot_interval = 0;
+
+#define SERVER_USAGE \
+  "[-b blocking|uring] [-l log_path] [-d none|batched|per-op] [-s snapshot_interval] [-r trace_path] <pipe_path> " \
+  "[delay]"
+
+// Thread that dumps the EMS state on SIGUSR1
+static pthread_t dumper;
+
+// Thread that writes the periodic snapshots
+static pthread_t snapshotter;
 
 int main(int argc, char *argv[]) {
+  int option;
+  while ((option = getopt(argc, argv, "b:l:d:s:r:")) != -1) {
+    switch (option) {
+      case 'b':
+        if (strcmp(optarg, "uring") == 0) {
+          io_backend = IO_BACKEND_URING;
+        } else if (strcmp(optarg, "blocking") != 0) {
+          fprintf(stderr, "Invalid I/O backend: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'l':
+        log_path = optarg;
+        break;
+      case 'd':
+        if (wal_parse_mode(optarg, &log_mode)) {
+          fprintf(stderr, "Invalid durability mode: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 's': {
+        char *end;
+        unsigned long interval = strtoul(optarg, &end, 10);
+        if (*end != '\0' || interval > UINT_MAX) {
+          fprintf(stderr, "Invalid snapshot interval: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        snapshot_interval = (unsigned int)interval;
+        break;
+      }
+      case 'r':
+        trace_path = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s %s\n", argv[0], SERVER_USAGE);
+        return EXIT_FAILURE;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
   if (argc < 2 || argc > 3) {
-    fprintf(stderr, "Usage: %s\n <pipe_path> [delay]\n", argv[0]);
+    fprintf(stderr, "Usage: %s %s\n", argv[0], SERVER_USAGE);
+    return EXIT_FAILURE;
+  }
+
+  if (log_path != NULL &&
+      snprintf(snapshot_path, sizeof(snapshot_path), "%s.snap", log_path) >= (int)sizeof(snapshot_path)) {
+    fprintf(stderr, "Log path is too long\n");
+    return EXIT_FAILURE;
+  }
+  if (snapshot_interval > 0 && log_path == NULL) {
+    fprintf(stderr, "Snapshots need a log\n");
     return EXIT_FAILURE;
   }
 
@@ -57,6 +135,7 @@ int main(int argc, char *argv[]) {
   }
 
   server_pipename = argv[1];
+  server_socket_path = socket_address_path(server_pipename);
 
   signal(SIGPIPE, SIG_IGN);
 
@@ -65,6 +144,12 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
+  if (server_socket_path != NULL) {
+    int result = accept_connections();
+    server_close(0);
+    return result;
+  }
+
   // With write so server can start even without clients
   server_fd = open(server_pipename, O_RDWR);
   if (server_fd < 0) {
@@ -74,12 +159,6 @@ int main(int argc, char *argv[]) {
   }
 
   while (1) {
-    if (received_sigusr1 != 0) {
-      ems_list_events();
-      setup_signal_handlers();  // setup again to make sure the signal is still setup correctly
-      received_sigusr1 = 0;
-    }
-
     char op_code;
     if (pipe_parse(server_fd, &op_code, sizeof(char)) == 1) {
       // if it can't get an op code, continue
@@ -107,11 +186,34 @@ int server_init(unsigned int delay_us) {
     return EXIT_FAILURE;
   }
 
+  // SIGUSR1 is only taken by the dumper, every thread created from here on inherits the mask
+  sigset_t sigmask;
+  sigemptyset(&sigmask);
+  sigaddset(&sigmask, SIGUSR1);
+  if (pthread_sigmask(SIG_BLOCK, &sigmask, NULL) != 0 || pthread_create(&dumper, NULL, dump_on_signal, NULL) != 0) {
+    fprintf(stderr, "Failed to set up SIGUSR1 dumps\n");
+    return EXIT_FAILURE;
+  }
+
   // Initialize EMS state.
   if (ems_init(delay_us)) {
     fprintf(stderr, "Failed to initialize EMS\n");
     return EXIT_FAILURE;
   }
+  if (log_path != NULL && ems_enable_log(log_path, snapshot_path, log_mode)) {
+    fprintf(stderr, "Failed to set up the log\n");
+    ems_terminate();
+    return EXIT_FAILURE;
+  }
+  if (snapshot_interval > 0 && pthread_create(&snapshotter, NULL, snapshot_periodically, NULL) != 0) {
+    fprintf(stderr, "Failed to start the snapshots\n");
+    ems_terminate();
+    return EXIT_FAILURE;
+  }
+  if (trace_path != NULL && recorder_open(trace_path)) {
+    ems_terminate();
+    return EXIT_FAILURE;
+  }
 
   // Create producer-consumer queue
   queue = (pc_queue_t *)malloc(sizeof(pc_queue_t));
@@ -119,7 +221,8 @@ int server_init(unsigned int delay_us) {
     ems_terminate();
     return EXIT_FAILURE;
   }
-  if (pcq_create(queue, MAX_SESSION_COUNT) != 0) {
+  // With io_uring every multiplexed session may have a request waiting for a worker
+  if (pcq_create(queue, io_backend == IO_BACKEND_URING ? URING_MAX_SESSIONS : MAX_SESSION_COUNT) != 0) {
     ems_terminate();
     free(queue);
     return EXIT_FAILURE;
@@ -142,6 +245,34 @@ int server_init(unsigned int delay_us) {
   }
 
   // Initialize the server
+  if (server_socket_path != NULL) {
+    if (listen_socket_init()) {
+      fprintf(stderr, "Failed to initialize server.\n");
+      ems_terminate();
+      pcq_destroy(queue);
+      free(queue);
+      free(workers);
+      return EXIT_FAILURE;
+    }
+    fprintf(stdout, "The server has been initialized with socket: %s.\n", server_socket_path);
+
+    // Subscribers are only reachable through sockets
+    if (subscriptions_init()) {
+      fprintf(stderr, "Failed to start the notifier, subscriptions are unavailable.\n");
+    }
+
+    if (io_backend == IO_BACKEND_URING && uring_backend_init(queue)) {
+      fprintf(stderr, "io_uring is unavailable, falling back to blocking I/O.\n");
+      io_backend = IO_BACKEND_BLOCKING;
+    }
+    return 0;
+  }
+
+  if (io_backend == IO_BACKEND_URING) {
+    fprintf(stderr, "io_uring needs a socket address, falling back to blocking I/O.\n");
+    io_backend = IO_BACKEND_BLOCKING;
+  }
+
   if ((unlink(server_pipename) != 0 && errno != ENOENT) || mkfifo(server_pipename, 0640) < 0) {
     fprintf(stderr, "Failed to initialize server.\n");
     ems_terminate();
@@ -155,8 +286,82 @@ int server_init(unsigned int delay_us) {
   return 0;
 }
 
+int listen_socket_init() {
+  struct sockaddr_un address;
+  if (strlen(server_socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path is too long.\n");
+    return 1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, server_socket_path);
+
+  server_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (server_fd < 0) {
+    perror("Failed to create server socket");
+    return 1;
+  }
+
+  if ((unlink(server_socket_path) != 0 && errno != ENOENT) ||
+      bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(server_fd, MAX_SESSION_COUNT) < 0) {
+    perror("Failed to listen on server socket");
+    close(server_fd);
+    return 1;
+  }
+
+  return 0;
+}
+
+int accept_connections() {
+  while (1) {
+    int socket_fd = accept(server_fd, NULL, NULL);
+    if (socket_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      perror("Failed to accept connection");
+      return EXIT_FAILURE;
+    }
+
+    if (io_backend == IO_BACKEND_URING) {
+      if (uring_backend_add_session(socket_fd)) {
+        fprintf(stderr, "Too many sessions, dropping connection.\n");
+        close(socket_fd);
+      }
+      continue;
+    }
+
+    // The accepted socket is handed to a worker as is, no paths are reopened
+    client_t *client = (client_t *)malloc(sizeof(client_t));
+    if (client == NULL) {
+      close(socket_fd);
+      continue;
+    }
+    client->request_fd = -1;
+    client->socket_fd = socket_fd;
+    client->uring_slot = -1;
+    client->reservation = (seat_buffer_t){0};
+    client->job_fd = -1;
+    packet_reader_init(&client->reader, socket_fd);
+
+    client->queued_ns = clock_now_ns();
+    if (pcq_enqueue(queue, (void *)client)) {
+      fprintf(stderr, "Failed to queue up client.\n");
+      close(socket_fd);
+      free(client);
+      return EXIT_FAILURE;
+    }
+  }
+}
+
 int receive_connection(int server_pipe_fd) {
   client_t *client = (client_t *)malloc(sizeof(client_t));
+  client->request_fd = -1;
+  client->socket_fd = -1;
+  client->uring_slot = -1;
+  client->reservation = (seat_buffer_t){0};
+  client->job_fd = -1;
 
   char client_resquest_pipename[CLIENT_PIPE_MAX_LEN];
   if (pipe_parse(server_pipe_fd, &client_resquest_pipename, CLIENT_PIPE_MAX_LEN * sizeof(char))) {
@@ -174,6 +379,13 @@ int receive_connection(int server_pipe_fd) {
   }
   strcpy(client->response_pipename, client_response_pipename);
 
+  if (pipe_parse(server_pipe_fd, &client->wire_version, sizeof(char))) {
+    fprintf(stderr, "Failed to read data out of server pipe.\n");
+    free(client);
+    return 1;
+  }
+
+  client->queued_ns = clock_now_ns();
   if (pcq_enqueue(queue, (void *)client)) {
     fprintf(stderr, "Failed to queue up client.\n");
     free(client);
@@ -183,6 +395,353 @@ int receive_connection(int server_pipe_fd) {
   return 0;
 }
 
+void *dump_on_signal(void *arg) {
+  (void)arg;
+
+  sigset_t sigmask;
+  sigemptyset(&sigmask);
+  sigaddset(&sigmask, SIGUSR1);
+
+  while (1) {
+    int signum;
+    if (sigwait(&sigmask, &signum) != 0) {
+      continue;
+    }
+
+    printf("Received SIGUSR1 signal\n");
+    fflush(stdout);
+    if (ems_dump_events(STDOUT_FILENO)) {
+      fprintf(stderr, "Failed to dump EMS state.\n");
+    }
+
+    size_t report_len;
+    char *report = stats_report(&report_len);
+    if (report == NULL || write(STDOUT_FILENO, report, report_len) != (ssize_t)report_len) {
+      fprintf(stderr, "Failed to dump latencies.\n");
+    }
+    free(report);
+  }
+}
+
+void *snapshot_periodically(void *arg) {
+  (void)arg;
+
+  while (1) {
+    sleep(snapshot_interval);
+    if (ems_save_snapshot(snapshot_path)) {
+      fprintf(stderr, "Failed to save snapshot.\n");
+    }
+  }
+}
+
+/// Reads a dimension or count out of a request, in the wire encoding of the session.
+/// @param client Client that sent the request.
+/// @param value Variable to store the value in.
+/// @return 0 if successful, 1 otherwise.
+static int receive_size(client_t *client, size_t *value) {
+  if (client->wire_version != WIRE_VERSION_COMPACT) {
+    return receive_request(client, value, sizeof(size_t));
+  }
+
+  uint32_t compact;
+  if (receive_request(client, &compact, sizeof(uint32_t))) {
+    return 1;
+  }
+  *value = compact;
+  return 0;
+}
+
+/// Reads the coordinates of the seats of a RESERVE request, in the wire encoding of the session.
+/// @param client Client that sent the request.
+/// @param num_seats Number of seats.
+/// @param xs Variable to store the rows in.
+/// @param ys Variable to store the columns in.
+/// @return 0 if successful, 1 otherwise.
+static int receive_coords(client_t *client, size_t num_seats, size_t *xs, size_t *ys) {
+  if (client->wire_version != WIRE_VERSION_COMPACT) {
+    return receive_request(client, xs, sizeof(size_t) * num_seats) ||
+           receive_request(client, ys, sizeof(size_t) * num_seats);
+  }
+
+  // The varints are read all at once and decoded in memory
+  size_t coords_len;
+  if (receive_size(client, &coords_len) || coords_len > 2 * num_seats * VARINT_MAX_LEN) {
+    return 1;
+  }
+  char *coords = malloc(coords_len > 0 ? coords_len : 1);
+  if (coords == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    return 1;
+  }
+  int failed = receive_request(client, coords, coords_len) || coords_decode(coords, coords_len, xs, ys, num_seats);
+  free(coords);
+  return failed;
+}
+
+/// Makes room for more seats at the end of a reservation buffer, at least doubling it when it grows.
+/// @param seats Reservation buffer.
+/// @param num_seats Number of seats to make room for.
+/// @return 0 if successful, 1 otherwise.
+static int seat_buffer_reserve(seat_buffer_t *seats, size_t num_seats) {
+  if (num_seats <= seats->capacity - seats->len) {
+    return 0;
+  }
+  if (num_seats > SIZE_MAX / sizeof(size_t) - seats->len) {
+    return 1;
+  }
+
+  size_t capacity = seats->len + num_seats;
+  if (capacity < 2 * seats->capacity && 2 * seats->capacity <= SIZE_MAX / sizeof(size_t)) {
+    capacity = 2 * seats->capacity;
+  }
+  size_t *xs = realloc(seats->xs, sizeof(size_t) * capacity);
+  if (xs == NULL) {
+    return 1;
+  }
+  seats->xs = xs;
+  size_t *ys = realloc(seats->ys, sizeof(size_t) * capacity);
+  if (ys == NULL) {
+    return 1;
+  }
+  seats->ys = ys;
+  seats->capacity = capacity;
+  return 0;
+}
+
+/// Receives a chunk of the seats of a reservation at the end of the buffer of the session. A chunk that fails to be
+/// received marks the reservation as lost.
+/// @param client Client that sent the request.
+/// @return 0 if successful, 1 otherwise.
+static int receive_seat_chunk(client_t *client) {
+  seat_buffer_t *seats = &client->reservation;
+  size_t num_seats;
+  if (receive_size(client, &num_seats)) {
+    seats->lost = 1;
+    return 1;
+  }
+
+  // The count is the client's word, so it's held to what a chunk may carry before the buffer grows for it
+  if (num_seats > RESERVATION_CHUNK_SIZE || num_seats > RESERVATION_MAX_SEATS - seats->len) {
+    fprintf(stderr, "Reservation too large.\n");
+    seats->lost = 1;
+    return 1;
+  }
+  if (seat_buffer_reserve(seats, num_seats)) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    seats->lost = 1;
+    return 1;
+  }
+  if (receive_coords(client, num_seats, seats->xs + seats->len, seats->ys + seats->len)) {
+    seats->lost = 1;
+    return 1;
+  }
+
+  seats->len += num_seats;
+  return 0;
+}
+
+/// Receives a chunk of a job script at the end of the one the session is sending.
+/// @param client Client that sent the request.
+/// @return 0 if successful, 1 otherwise.
+static int receive_job_chunk(client_t *client) {
+  size_t len;
+  if (receive_size(client, &len)) {
+    return 1;
+  }
+  if (client->job_fd == -1 && (client->job_fd = job_file_open()) == -1) {
+    return 1;
+  }
+
+  char buf[4096];
+  while (len > 0) {
+    size_t to_read = len < sizeof(buf) ? len : sizeof(buf);
+    if (receive_request(client, buf, to_read) || pipe_print(client->job_fd, buf, to_read)) {
+      return 1;
+    }
+    len -= to_read;
+  }
+  return 0;
+}
+
+/// Reads the blocks of seats of a RESERVE_RANGES request, in the wire encoding of the session.
+/// @param client Client that sent the request.
+/// @param num_ranges Number of blocks.
+/// @param ranges Variable to store the blocks in.
+/// @return 0 if successful, 1 otherwise.
+static int receive_ranges(client_t *client, size_t num_ranges, seat_range_t *ranges) {
+  if (client->wire_version != WIRE_VERSION_COMPACT) {
+    return receive_request(client, ranges, sizeof(seat_range_t) * num_ranges);
+  }
+
+  size_t ranges_len;
+  if (receive_size(client, &ranges_len) || ranges_len > 4 * num_ranges * VARINT_MAX_LEN) {
+    return 1;
+  }
+  char *encoded = malloc(ranges_len > 0 ? ranges_len : 1);
+  if (encoded == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    return 1;
+  }
+  int failed =
+      receive_request(client, encoded, ranges_len) || seat_ranges_decode(encoded, ranges_len, ranges, num_ranges);
+  free(encoded);
+  return failed;
+}
+
+/// Reads the arguments of a request and handles it.
+/// @param client Client that sent the request.
+/// @param op_code Op code of the request.
+static void handle_request(client_t *client, char op_code) {
+  switch (op_code) {
+    case OP_CODE_CREATE_REQUEST: {
+      // Args
+      unsigned int event_id;
+      size_t num_rows, num_cols;
+
+      if (receive_request(client, &event_id, sizeof(unsigned int)) || receive_size(client, &num_rows) ||
+          receive_size(client, &num_cols)) {
+        break;  // failed to get args
+      }
+
+      recorder_create(client->connection, event_id, num_rows, num_cols);
+      long long start_ns = clock_now_ns();
+      if (ems_create_handler(client, event_id, num_rows, num_cols)) {
+        fprintf(stderr, "Failed to perform ems_create for client.\n");
+      }
+      stats_record(STATS_CREATE, clock_now_ns() - start_ns);
+      break;
+    }
+
+    case OP_CODE_RESERVE_CHUNK_REQUEST:
+      // Seats of a reservation too large for a single request, reserved along with its last chunk
+      receive_seat_chunk(client);
+      break;
+    case OP_CODE_RESERVE_REQUEST: {
+      // Args
+      unsigned int event_id;
+
+      // The last chunk of the seats is reserved along with the ones streamed before it, the buffer being emptied
+      // for the next reservation either way. A reservation that lost seats is still answered, as failed.
+      int failed = receive_request(client, &event_id, sizeof(unsigned int));
+      if (!failed) {
+        receive_seat_chunk(client);
+      }
+      if (!failed && !client->reservation.lost) {
+        recorder_reserve(client->connection, event_id, &client->reservation);
+      }
+      long long start_ns = clock_now_ns();
+      if (!failed && ems_reserve_handler(client, event_id, &client->reservation)) {
+        fprintf(stderr, "Failed to perform ems_reserve for a client.\n");
+      }
+      if (!failed) {
+        stats_record(STATS_RESERVE, clock_now_ns() - start_ns);
+      }
+
+      client->reservation.len = 0;
+      client->reservation.lost = 0;
+      break;
+    }
+    case OP_CODE_JOB_CHUNK_REQUEST:
+      // Chunks of a job script, run as a whole once it's all there
+      if (receive_job_chunk(client)) {
+        fprintf(stderr, "Failed to receive a job script.\n");
+      }
+      break;
+    case OP_CODE_RUN_JOB_REQUEST: {
+      recorder_run_job(client->connection, client->job_fd);
+      long long start_ns = clock_now_ns();
+      if (ems_run_job_handler(client)) {
+        fprintf(stderr, "Failed to run a job for a client.\n");
+      }
+      stats_record(STATS_RUN_JOB, clock_now_ns() - start_ns);
+      break;
+    }
+    case OP_CODE_RESERVE_RANGES_REQUEST: {
+      // Args
+      unsigned int event_id;
+      size_t num_ranges;
+
+      if (receive_request(client, &event_id, sizeof(unsigned int)) || receive_size(client, &num_ranges) ||
+          num_ranges > SIZE_MAX / sizeof(seat_range_t)) {
+        break;  // failed to get args
+      }
+
+      seat_range_t *ranges = malloc(num_ranges > 0 ? sizeof(seat_range_t) * num_ranges : 1);
+      if (ranges == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        break;
+      }
+      if (receive_ranges(client, num_ranges, ranges)) {
+        free(ranges);
+        break;  // failed to get args
+      }
+
+      recorder_reserve_ranges(client->connection, event_id, num_ranges, ranges);
+      long long start_ns = clock_now_ns();
+      if (ems_reserve_ranges_handler(client, event_id, num_ranges, ranges)) {
+        fprintf(stderr, "Failed to perform ems_reserve for a client.\n");
+      }
+      stats_record(STATS_RESERVE_RANGES, clock_now_ns() - start_ns);
+
+      free(ranges);
+      break;
+    }
+    case OP_CODE_SHOW_REQUEST: {
+      unsigned int event_id;
+
+      if (receive_request(client, &event_id, sizeof(unsigned int))) {
+        break;  // failed to get args
+      }
+
+      recorder_show(client->connection, OP_CODE_SHOW_REQUEST, event_id, 0, 0);
+      long long start_ns = clock_now_ns();
+      if (ems_show_handler(client, event_id)) {
+        fprintf(stderr, "Failed to perform ems_show for a client.\n");
+      }
+      stats_record(STATS_SHOW, clock_now_ns() - start_ns);
+
+      break;
+    }
+    case OP_CODE_SHOW_SINCE_REQUEST: {
+      unsigned int event_id, since;
+      char encodings;
+
+      if (receive_request(client, &event_id, sizeof(unsigned int)) ||
+          receive_request(client, &since, sizeof(unsigned int)) || receive_request(client, &encodings, sizeof(char))) {
+        break;  // failed to get args
+      }
+
+      recorder_show(client->connection, OP_CODE_SHOW_SINCE_REQUEST, event_id, since, encodings);
+      long long start_ns = clock_now_ns();
+      if (ems_show_since_handler(client, event_id, since, encodings)) {
+        fprintf(stderr, "Failed to perform ems_show for a client.\n");
+      }
+      stats_record(STATS_SHOW_SINCE, clock_now_ns() - start_ns);
+
+      break;
+    }
+    case OP_CODE_LIST_REQUEST: {
+      recorder_list(client->connection);
+      long long start_ns = clock_now_ns();
+      if (ems_list_handler(client)) {
+        fprintf(stderr, "Failed to perform ems_list for a client.\n");
+      }
+      stats_record(STATS_LIST, clock_now_ns() - start_ns);
+      break;
+    }
+    case OP_CODE_STATS_REQUEST:
+      if (ems_stats_handler(client)) {
+        fprintf(stderr, "Failed to send stats to a client.\n");
+      }
+      break;
+    case OP_CODE_QUIT_REQUEST:
+      // Will leave loop in following if, opening up the session for another client
+      break;
+    default:
+      break;
+  }
+}
+
 void *process_incoming_requests(void *arg) {
   int session_id = (int)(intptr_t)arg;
 
@@ -196,126 +755,120 @@ void *process_incoming_requests(void *arg) {
   }
 
   client_t *client;
+  long long held_since_ns = 0;
   while (1) {
+    // Whatever the worker was done with is let go of right before it waits for the next one
+    if (held_since_ns != 0) {
+      stats_record(STATS_WORKER_HOLD, clock_now_ns() - held_since_ns);
+      held_since_ns = 0;
+    }
+
     // Dequeues a client to process.
     client = (client_t *)pcq_dequeue(queue);
     if (client == NULL) {
       continue;
     }
+    held_since_ns = clock_now_ns();
+    stats_record(STATS_QUEUE_WAIT, held_since_ns - client->queued_ns);
+
+    if (client->uring_slot != -1) {
+      // The ring read a single request of a multiplexed session, setup included
+      char op_code;
+      if (receive_request(client, &op_code, sizeof(char)) || op_code == OP_CODE_QUIT_REQUEST) {
+        uring_backend_done(client, 1);
+        continue;
+      }
 
-    ems_setup_handler(session_id, client);
-
-    // Open client pipe to read the op codes
-    int request_fd = open(client->request_pipename, O_RDONLY);
-    char op_code;
-
-    while (1) {
-      if (pipe_parse(request_fd, &op_code, sizeof(char))) {
-        break;  // failed to get op code
+      if (op_code == OP_CODE_SUBSCRIBE_REQUEST) {
+        // The connection is handed over to the notifier, freeing the slot
+        unsigned int event_id;
+        int failed = receive_request(client, &event_id, sizeof(unsigned int));
+        int socket_fd = uring_backend_detach(client);
+        if (failed || subscriptions_add(socket_fd, event_id)) {
+          close(socket_fd);
+        }
+        continue;
       }
 
-      switch (op_code) {
-        case OP_CODE_CREATE_REQUEST: {
-          // Args
-          unsigned int event_id;
-          size_t num_rows, num_cols;
-
-          if (pipe_parse(request_fd, &event_id, sizeof(unsigned int)) ||
-              pipe_parse(request_fd, &num_rows, sizeof(size_t)) || 
-              pipe_parse(request_fd, &num_cols, sizeof(size_t))) {
-            break;  // failed to get args
-          }
-
-          if (ems_create_handler(client, event_id, num_rows, num_cols)) {
-            fprintf(stderr, "Failed to perform ems_create for client.\n");
-          }
-          break;
+      if (op_code == OP_CODE_SETUP_REQUEST) {
+        if (receive_request(client, &client->wire_version, sizeof(char))) {
+          uring_backend_done(client, 1);
+          continue;
         }
+        client->connection = recorder_setup(client->wire_version);
+        ems_setup_handler(client->session_id, client);
+      } else {
+        handle_request(client, op_code);
+      }
+      uring_backend_done(client, 0);
+      continue;
+    }
+
+    if (client->socket_fd != -1) {
+      // Socket sessions send their setup request through the accepted connection
+      char setup_op_code;
+      if (receive_request(client, &setup_op_code, sizeof(char)) ||
+          (setup_op_code != OP_CODE_SETUP_REQUEST && setup_op_code != OP_CODE_SUBSCRIBE_REQUEST)) {
+        close(client->socket_fd);
+        free(client);
+        continue;
+      }
 
-        case OP_CODE_RESERVE_REQUEST: {
-          // Args
-          unsigned int event_id;
-          size_t num_seats, *xs, *ys;
-
-          if (pipe_parse(request_fd, &event_id, sizeof(unsigned int)) ||
-              pipe_parse(request_fd, &num_seats, sizeof(size_t))) {
-            break;  // failed to get args
-          }
-
-          xs = malloc(sizeof(size_t) * num_seats);
-          ys = malloc(sizeof(size_t) * num_seats);
-
-          if (!xs || !ys) {
-            fprintf(stderr, "Memory allocation failed.\n");
-            free(xs);
-            free(ys);
-            break;
-          }
-          for (size_t i = 0; i < num_seats; i++) {
-            if (pipe_parse(request_fd, &xs[i], sizeof(size_t))) {
-              free(xs);
-              free(ys);
-              break;  // failed to get args
-            }
-          }
-          for (size_t i = 0; i < num_seats; i++) {
-            if (pipe_parse(request_fd, &ys[i], sizeof(size_t))) {
-              free(xs);
-              free(ys);
-              break;  // failed to get args
-            }
-          }
-
-          if (ems_reserve_handler(client, event_id, num_seats, xs, ys)) {
-            fprintf(stderr, "Failed to perform ems_reserve for a client.\n");
-          }
-
-          free(xs);
-          free(ys);
-          break;
+      // Subscription connections are handed over to the notifier, leaving the worker free
+      if (setup_op_code == OP_CODE_SUBSCRIBE_REQUEST) {
+        unsigned int event_id;
+        if (receive_request(client, &event_id, sizeof(unsigned int)) ||
+            subscriptions_add(client->socket_fd, event_id)) {
+          close(client->socket_fd);
         }
-        case OP_CODE_SHOW_REQUEST: {
-          unsigned int event_id;
+        free(client);
+        continue;
+      }
+      if (receive_request(client, &client->wire_version, sizeof(char))) {
+        close(client->socket_fd);
+        free(client);
+        continue;
+      }
+      packet_discard(&client->reader);
+    }
 
-          if (pipe_parse(request_fd, &event_id, sizeof(unsigned int))) {
-            break;  // failed to get args
-          }
+    client->connection = recorder_setup(client->wire_version);
+    ems_setup_handler(session_id, client);
 
-          if (ems_show_handler(client, event_id)) {
-            fprintf(stderr, "Failed to perform ems_show for a client.\n");
-          }
+    // Open client pipe to read the op codes. It's opened for writing as well, so it never reaches its end between
+    // requests, and each read waits for the next request instead.
+    if (client->socket_fd == -1) {
+      client->request_fd = open(client->request_pipename, O_RDWR);
+    }
+    char op_code;
 
-          break;
-        }
-        case OP_CODE_LIST_REQUEST:
-          if (ems_list_handler(client)) {
-            fprintf(stderr, "Failed to perform ems_list for a client.\n");
-          }
-          break;
-        case OP_CODE_QUIT_REQUEST:
-          // Will leave loop in following if, opening up the session for another client
-          break;
-        default:
-          break;
+    while (1) {
+      if (receive_request(client, &op_code, sizeof(char))) {
+        break;  // failed to get op code
       }
 
+      handle_request(client, op_code);
+
       if (op_code == OP_CODE_QUIT_REQUEST) {
         break;
       }
 
-      // To avoid having active wait for another process to open the pipe.
-      int tmp_pipe = open(client->request_pipename, O_RDONLY);
-      if (tmp_pipe < 0) {
-        fprintf(stderr, "Failed to open client request pipe");
-        break;
-      }
-      if (close(tmp_pipe) < 0) {
-        fprintf(stderr, "Failed to close client request pipe");
-        break;
+      if (client->socket_fd != -1) {
+        // Each request is its own message, drop anything left of it
+        packet_discard(&client->reader);
       }
     }
 
-    close(request_fd);
+    if (client->socket_fd != -1) {
+      close(client->socket_fd);
+    } else {
+      close(client->request_fd);
+    }
+    free(client->reservation.xs);
+    free(client->reservation.ys);
+    if (client->job_fd != -1) {
+      close(client->job_fd);
+    }
     free(client);
   }
 }
@@ -323,6 +876,9 @@ void *process_incoming_requests(void *arg) {
 void server_close(int signum) {
   fprintf(stdout, "\nClosing up server...\n");
 
+  subscriptions_terminate();
+  recorder_close();
+
   if (ems_terminate()) {
     fprintf(stderr, "Failed to destroy EMS\n");
     exit(EXIT_FAILURE);
@@ -333,7 +889,7 @@ void server_close(int signum) {
   free(workers);
 
   close(server_fd);
-  unlink(server_pipename);
+  unlink(server_socket_path != NULL ? server_socket_path : server_pipename);
 
   if (signum != 0) {
     exit(EXIT_SUCCESS);
@@ -355,11 +911,6 @@ int setup_signal_handlers() {
     perror("Unable to register signal handler for SIGINT");
     return 1;
   }
-  // Register signal handler for SIGUSR1
-  if (signal(SIGUSR1, sigusr1_handler) == SIG_ERR) {
-    perror("Unable to register signal handler for SIGUSR1");
-    return 1;
-  }
 
   return 0;
 }
\ No newline at end of file
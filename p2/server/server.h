@@ -17,11 +17,27 @@ void server_close(int signum);
 /// @return 0 if the threads were created successfuly, 1 otherwise.
 int workers_init();
 
+/// Creates the listening Unix socket of the server.
+/// @return 0 if the socket is listening, 1 otherwise.
+int listen_socket_init();
+
+/// Accepts socket connections and adds them to the queue, until an error occurs.
+/// @return EXIT_FAILURE when it stops accepting connections.
+int accept_connections();
+
 /// Adds a client to the queue
 /// @param server_pipe_fd File descriptor of the server pipe.
 /// @return 0 if successfull, 1 otherwise.
 int receive_connection(int server_pipe_fd);
 
+/// Waits for SIGUSR1 and dumps the EMS state to stdout each time, away from the listener and the workers.
+/// @param arg Unused.
+void *dump_on_signal(void *arg);
+
+/// Writes a snapshot of the EMS state every snapshot interval, so restarts only replay the end of the log.
+/// @param arg Unused.
+void *snapshot_periodically(void *arg);
+
 /// Sets up signal handlers for server.
 /// @return 0 if successful, 1 otherwise
 int setup_signal_handlers();
@@ -0,0 +1,171 @@
+#include "stats.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *stage_names[NUM_STATS_STAGES] = {
+    "queue_wait", "worker_hold", "create", "reserve", "reserve_ranges", "show", "show_since", "list", "run_job"};
+
+static const char *counter_names[NUM_STATS_COUNTERS] = {"uring_requests", "uring_responses", "uring_enters",
+                                                        "notifications",  "notify_records",  "resyncs"};
+
+static unsigned long long counters[NUM_STATS_COUNTERS];
+
+// Histograms of a thread. Only the thread writes to them, with plain stores, and the report reads them as they are
+// being written to, so a report may miss the latencies counted while it's made but never blocks a worker.
+struct ThreadStats {
+  uint64_t counts[NUM_STATS_STAGES][STATS_NUM_BUCKETS];
+  uint64_t sums_ns[NUM_STATS_STAGES];
+  uint64_t maxs_ns[NUM_STATS_STAGES];
+};
+
+// Histograms of every thread that counted a latency, registered on its first one and kept after it's gone
+static struct ThreadStats *threads[STATS_MAX_THREADS];
+static unsigned int num_threads = 0;
+static _Thread_local struct ThreadStats *local_stats = NULL;
+static _Thread_local int local_unregistered = 0;
+
+/// Gets the bucket a latency is counted in.
+/// @param value Latency in nanoseconds.
+/// @return Index of the bucket.
+static size_t bucket_of(uint64_t value) {
+  if (value < STATS_SUB_BUCKETS) {
+    return (size_t)value;
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  int shift = exponent - STATS_SUB_BUCKET_BITS;
+  return (size_t)(exponent - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS +
+         (size_t)((value >> shift) & (STATS_SUB_BUCKETS - 1));
+}
+
+/// Gets the highest latency counted in a bucket.
+/// @param bucket Index of the bucket.
+/// @return Latency in nanoseconds.
+static uint64_t bucket_max(size_t bucket) {
+  if (bucket < STATS_SUB_BUCKETS) {
+    return bucket;
+  }
+  int shift = (int)(bucket / STATS_SUB_BUCKETS) - 1;
+  uint64_t low = (uint64_t)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << shift;
+  return low + ((uint64_t)1 << shift) - 1;
+}
+
+/// Gets the histograms of the calling thread, registering them on its first latency.
+/// @return Histograms of the thread, or NULL if there's no room left for them.
+static struct ThreadStats *thread_stats(void) {
+  if (local_stats != NULL || local_unregistered) {
+    return local_stats;
+  }
+
+  local_unregistered = 1;
+  unsigned int index = __atomic_fetch_add(&num_threads, 1, __ATOMIC_RELAXED);
+  if (index >= STATS_MAX_THREADS) {
+    return NULL;
+  }
+  struct ThreadStats *stats = calloc(1, sizeof(struct ThreadStats));
+  if (stats == NULL) {
+    return NULL;
+  }
+  __atomic_store_n(&threads[index], stats, __ATOMIC_RELEASE);
+  local_stats = stats;
+  return stats;
+}
+
+void stats_record(enum StatsStage stage, long long elapsed_ns) {
+  struct ThreadStats *stats = thread_stats();
+  if (stats == NULL) {
+    return;
+  }
+
+  uint64_t value = elapsed_ns > 0 ? (uint64_t)elapsed_ns : 0;
+  uint64_t *count = &stats->counts[stage][bucket_of(value)];
+  __atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->sums_ns[stage], stats->sums_ns[stage] + value, __ATOMIC_RELAXED);
+  if (value > stats->maxs_ns[stage]) {
+    __atomic_store_n(&stats->maxs_ns[stage], value, __ATOMIC_RELAXED);
+  }
+}
+
+void stats_count(enum StatsCounter counter, unsigned long long value) {
+  __atomic_fetch_add(&counters[counter], value, __ATOMIC_RELAXED);
+}
+
+/// Gets a percentile out of a merged histogram.
+/// @param counts Latencies counted in each bucket.
+/// @param total Latencies counted in all of them, more than 0.
+/// @param fraction Percentile, between 0 and 1.
+/// @param max_ns Highest latency counted.
+/// @return Highest latency of the bucket the percentile falls in, in microseconds.
+static double percentile_us(const uint64_t *counts, uint64_t total, double fraction, uint64_t max_ns) {
+  uint64_t rank = (uint64_t)(fraction * (double)total);
+  rank = rank < total ? rank + 1 : total;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < STATS_NUM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint64_t value = bucket_max(i);
+      return (double)(value < max_ns ? value : max_ns) / 1e3;
+    }
+  }
+  return 0;
+}
+
+char *stats_report(size_t *len) {
+  char *report = NULL;
+  FILE *out = open_memstream(&report, len);
+  if (out == NULL) {
+    return NULL;
+  }
+
+  uint64_t *counts = malloc(sizeof(uint64_t) * STATS_NUM_BUCKETS);
+  int failed = counts == NULL || fprintf(out, "stage,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n") < 0;
+
+  unsigned int registered = __atomic_load_n(&num_threads, __ATOMIC_RELAXED);
+  registered = registered < STATS_MAX_THREADS ? registered : STATS_MAX_THREADS;
+  for (int stage = 0; stage < NUM_STATS_STAGES && !failed; stage++) {
+    uint64_t total = 0, sum_ns = 0, max_ns = 0;
+    for (size_t i = 0; i < STATS_NUM_BUCKETS; i++) {
+      counts[i] = 0;
+    }
+
+    // Threads still registering are left for the next report
+    for (unsigned int t = 0; t < registered; t++) {
+      struct ThreadStats *stats = __atomic_load_n(&threads[t], __ATOMIC_ACQUIRE);
+      if (stats == NULL) {
+        continue;
+      }
+      for (size_t i = 0; i < STATS_NUM_BUCKETS; i++) {
+        uint64_t count = __atomic_load_n(&stats->counts[stage][i], __ATOMIC_RELAXED);
+        counts[i] += count;
+        total += count;
+      }
+      sum_ns += __atomic_load_n(&stats->sums_ns[stage], __ATOMIC_RELAXED);
+      uint64_t thread_max_ns = __atomic_load_n(&stats->maxs_ns[stage], __ATOMIC_RELAXED);
+      max_ns = thread_max_ns > max_ns ? thread_max_ns : max_ns;
+    }
+
+    if (total == 0) {
+      failed = fprintf(out, "%s,0,0.0,0.0,0.0,0.0,0.0,0.0\n", stage_names[stage]) < 0;
+      continue;
+    }
+    failed = fprintf(out, "%s,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", stage_names[stage], (unsigned long long)total,
+                     (double)sum_ns / 1e3 / (double)total, percentile_us(counts, total, 0.5, max_ns),
+                     percentile_us(counts, total, 0.9, max_ns), percentile_us(counts, total, 0.99, max_ns),
+                     percentile_us(counts, total, 0.999, max_ns), (double)max_ns / 1e3) < 0;
+  }
+
+  failed = failed || fprintf(out, "\ncounter,value\n") < 0;
+  for (int counter = 0; counter < NUM_STATS_COUNTERS && !failed; counter++) {
+    failed = fprintf(out, "%s,%llu\n", counter_names[counter],
+                     __atomic_load_n(&counters[counter], __ATOMIC_RELAXED)) < 0;
+  }
+
+  free(counts);
+  if (fclose(out) != 0 || failed) {
+    free(report);
+    return NULL;
+  }
+  return report;
+}
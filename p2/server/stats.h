@@ -0,0 +1,56 @@
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <stddef.h>
+
+// Stages of serving requests whose latencies are kept
+enum StatsStage {
+  STATS_QUEUE_WAIT,   // From when a session, or a request with io_uring, is queued up to when a worker takes it
+  STATS_WORKER_HOLD,  // From when a worker takes a session, or a request with io_uring, to when it's free again
+  STATS_CREATE,       // The handler of each request type, response included
+  STATS_RESERVE,
+  STATS_RESERVE_RANGES,
+  STATS_SHOW,
+  STATS_SHOW_SINCE,
+  STATS_LIST,
+  STATS_RUN_JOB,
+  NUM_STATS_STAGES
+};
+
+// Events counted by the server, reported after the latencies
+enum StatsCounter {
+  STATS_URING_REQUESTS,   // Requests read by the io_uring backend
+  STATS_URING_RESPONSES,  // Responses written by the io_uring backend
+  STATS_URING_ENTERS,     // io_uring_enter calls made by the io_uring backend
+  STATS_NOTIFICATIONS,    // Notifications queued for subscribers, one per subscriber
+  STATS_NOTIFY_RECORDS,   // Records written to subscription connections
+  STATS_RESYNCS,          // Subscribers that fell too far behind and were told to resync
+  NUM_STATS_COUNTERS
+};
+
+// Latencies are counted in buckets of logarithmic width, each power of two split in STATS_SUB_BUCKETS, so any
+// percentile is off by less than 1 / STATS_SUB_BUCKETS of its value
+#define STATS_SUB_BUCKET_BITS 4
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_NUM_BUCKETS ((64 - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS)
+#define STATS_MAX_THREADS 64  // Threads beyond these aren't counted
+
+/// Counts a latency in the histograms of the calling thread, which only it writes to.
+/// @param stage Stage the latency was measured over.
+/// @param elapsed_ns Latency in nanoseconds, measured with clock_now_ns.
+void stats_record(enum StatsStage stage, long long elapsed_ns);
+
+/// Adds to a counter shared by every thread.
+/// @param counter Counter to add to.
+/// @param value Value to add.
+void stats_count(enum StatsCounter counter, unsigned long long value);
+
+/// Merges the histograms of every thread into a report, a CSV line per stage:
+/// stage,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us
+/// followed by a blank line and a CSV line per counter:
+/// counter,value
+/// @param len Variable to store the length of the report in.
+/// @return Report, to be freed by the caller, or NULL if it couldn't be made.
+char *stats_report(size_t *len);
+
+#endif  // SERVER_STATS_H
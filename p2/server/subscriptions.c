@@ -0,0 +1,556 @@
+#include "subscriptions.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "common/locks.h"
+#include "operations.h"
+#include "stats.h"
+
+#define SUBSCRIPTION_BUCKETS 1024
+#define NOTIFIER_EVENTS 64  // Connections handled per epoll_wait
+
+// Serialized notification, shared by every subscriber it's queued for
+struct Notification {
+  size_t refs;
+  size_t len;
+  char payload[];
+};
+
+struct Subscriber {
+  int socket_fd;
+
+  // Notifications not yet written, guarded by subscriptions_lock
+  struct Notification *queue[SUBSCRIBER_QUEUE_MAX];
+  size_t queue_start;
+  size_t queue_len;
+  int resync;   // Whether notifications were dropped, the client is told before the ones after
+  int pending;  // Whether it's in the pending list
+  struct Subscriber *next_pending;
+
+  // Output being written, only touched by the notifier
+  char *out;
+  size_t out_len;
+  size_t out_offset;
+  size_t out_capacity;
+  int waiting_writable;  // Whether the socket was full, the notifier waits for room instead of retrying
+  struct Subscriber *next_flush;
+};
+
+// Subscribers of an event. Events are never deleted, so neither are their entries.
+struct EventSubscribers {
+  unsigned int event_id;
+  struct Subscriber **subscribers;
+  size_t len;
+  size_t capacity;
+  struct EventSubscribers *next;
+};
+
+static struct EventSubscribers *subscriptions[SUBSCRIPTION_BUCKETS];
+static pthread_mutex_t subscriptions_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t num_subscriptions = 0;  // Also read without the lock, so reservations nobody follows skip it
+
+// Subscribers with notifications to write
+static struct Subscriber *pending_subscribers = NULL;
+
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static pthread_t notifier;
+static int stopping = 0;  // Whether the notifier should return, guarded by subscriptions_lock
+
+/// Drops a reference to a notification, called with subscriptions_lock held.
+static void notification_release(struct Notification *notification) {
+  if (--notification->refs == 0) {
+    free(notification);
+  }
+}
+
+/// Queues a notification for a subscriber, called with subscriptions_lock held. A subscriber too far behind has its
+/// queue dropped and is told to resync, the notification still being queued after that.
+/// @return 1 if the subscriber had nothing pending before, 0 otherwise.
+static int queue_notification(struct Subscriber *subscriber, struct Notification *notification) {
+  if (subscriber->queue_len == SUBSCRIBER_QUEUE_MAX) {
+    for (size_t i = 0; i < subscriber->queue_len; i++) {
+      notification_release(subscriber->queue[(subscriber->queue_start + i) % SUBSCRIBER_QUEUE_MAX]);
+    }
+    subscriber->queue_len = 0;
+    subscriber->resync = 1;
+    stats_count(STATS_RESYNCS, 1);
+  }
+
+  subscriber->queue[(subscriber->queue_start + subscriber->queue_len) % SUBSCRIBER_QUEUE_MAX] = notification;
+  subscriber->queue_len++;
+  notification->refs++;
+  stats_count(STATS_NOTIFICATIONS, 1);
+
+  if (subscriber->pending) {
+    return 0;
+  }
+  subscriber->pending = 1;
+  subscriber->next_pending = pending_subscribers;
+  pending_subscribers = subscriber;
+  return 1;
+}
+
+/// Wakes up the notifier to write the pending notifications.
+static void wake_notifier() {
+  uint64_t one = 1;
+  if (write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+    perror("Failed to wake up the notifier");
+  }
+}
+
+/// Finds the subscribers of an event, called with subscriptions_lock held.
+/// @param create Whether to add an empty entry if the event has none.
+/// @return Subscribers of the event, NULL if it has none or the entry could not be added.
+static struct EventSubscribers *find_subscribers(unsigned int event_id, int create) {
+  struct EventSubscribers **bucket = &subscriptions[event_id % SUBSCRIPTION_BUCKETS];
+  for (struct EventSubscribers *entry = *bucket; entry != NULL; entry = entry->next) {
+    if (entry->event_id == event_id) {
+      return entry;
+    }
+  }
+  if (!create) {
+    return NULL;
+  }
+
+  struct EventSubscribers *entry = calloc(1, sizeof(struct EventSubscribers));
+  if (entry == NULL) {
+    perror("Failed to allocate subscribers");
+    return NULL;
+  }
+  entry->event_id = event_id;
+  entry->next = *bucket;
+  *bucket = entry;
+  return entry;
+}
+
+/// Queues the answer to an (un)subscribe request, called with subscriptions_lock held.
+/// @return 0 if successful, 1 otherwise.
+static int queue_answer(struct Subscriber *subscriber, char op_code, unsigned int event_id, int result) {
+  // [ op_code (char) ] | [ event_id (unsigned int) ] | [ result (int) ]
+  size_t len = sizeof(char) + sizeof(unsigned int) + sizeof(int);
+  struct Notification *answer = malloc(sizeof(struct Notification) + len);
+  if (answer == NULL) {
+    perror("Failed to allocate subscription answer");
+    return 1;
+  }
+  answer->refs = 0;
+  answer->len = 0;
+  create_message(answer->payload, &answer->len, &op_code, sizeof(char));
+  create_message(answer->payload, &answer->len, &event_id, sizeof(unsigned int));
+  create_message(answer->payload, &answer->len, &result, sizeof(int));
+
+  queue_notification(subscriber, answer);
+  return 0;
+}
+
+/// Adds a subscriber to an event, called with subscriptions_lock held.
+/// @return 0 if successful, 1 otherwise.
+static int subscribe_locked(struct Subscriber *subscriber, unsigned int event_id) {
+  struct EventSubscribers *entry = find_subscribers(event_id, 1);
+  if (entry == NULL) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < entry->len; i++) {
+    if (entry->subscribers[i] == subscriber) {
+      return 0;
+    }
+  }
+
+  if (entry->len == entry->capacity) {
+    size_t capacity = entry->capacity == 0 ? 4 : entry->capacity * 2;
+    struct Subscriber **temp = realloc(entry->subscribers, sizeof(struct Subscriber *) * capacity);
+    if (temp == NULL) {
+      perror("Failed to allocate subscribers");
+      return 1;
+    }
+    entry->subscribers = temp;
+    entry->capacity = capacity;
+  }
+  entry->subscribers[entry->len++] = subscriber;
+  __atomic_add_fetch(&num_subscriptions, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/// Removes a subscriber from an event, called with subscriptions_lock held.
+/// @return 0 if successful, 1 if it wasn't subscribed.
+static int unsubscribe_locked(struct Subscriber *subscriber, unsigned int event_id) {
+  struct EventSubscribers *entry = find_subscribers(event_id, 0);
+  if (entry == NULL) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < entry->len; i++) {
+    if (entry->subscribers[i] == subscriber) {
+      entry->subscribers[i] = entry->subscribers[--entry->len];
+      __atomic_sub_fetch(&num_subscriptions, 1, __ATOMIC_RELEASE);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/// Handles an (un)subscribe request and queues its answer.
+static void handle_subscription_request(struct Subscriber *subscriber, char op_code, unsigned int event_id) {
+  // Checked before locking, events are locked before the subscriptions when reserving
+  unsigned int version;
+  size_t num_rows, num_cols;
+  int exists =
+      op_code == OP_CODE_UNSUBSCRIBE_REQUEST || get_event_version(event_id, &version, &num_rows, &num_cols) == 0;
+
+  mutex_lock(&subscriptions_lock);
+  int result = 1;
+  if (exists) {
+    result = op_code == OP_CODE_SUBSCRIBE_REQUEST ? subscribe_locked(subscriber, event_id)
+                                                  : unsubscribe_locked(subscriber, event_id);
+  }
+  queue_answer(subscriber, op_code, event_id, result);
+  mutex_unlock(&subscriptions_lock);
+}
+
+/// Closes a subscription connection, dropping all of its subscriptions.
+static void remove_subscriber(struct Subscriber *subscriber) {
+  mutex_lock(&subscriptions_lock);
+  for (size_t i = 0; i < SUBSCRIPTION_BUCKETS; i++) {
+    for (struct EventSubscribers *entry = subscriptions[i]; entry != NULL; entry = entry->next) {
+      unsubscribe_locked(subscriber, entry->event_id);
+    }
+  }
+
+  for (struct Subscriber **pending = &pending_subscribers; *pending != NULL; pending = &(*pending)->next_pending) {
+    if (*pending == subscriber) {
+      *pending = subscriber->next_pending;
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < subscriber->queue_len; i++) {
+    notification_release(subscriber->queue[(subscriber->queue_start + i) % SUBSCRIBER_QUEUE_MAX]);
+  }
+  mutex_unlock(&subscriptions_lock);
+
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, subscriber->socket_fd, NULL);
+  close(subscriber->socket_fd);
+  free(subscriber->out);
+  free(subscriber);
+}
+
+/// Reads the requests a subscriber sent, one per record.
+/// @return 0 if successful, 1 if the connection is over.
+static int read_requests(struct Subscriber *subscriber) {
+  while (1) {
+    // [ op_code (char) ] | [ event_id (unsigned int) ]
+    char request[sizeof(char) + sizeof(unsigned int)];
+    ssize_t read_bytes = recv(subscriber->socket_fd, request, sizeof(request), MSG_DONTWAIT);
+    if (read_bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return 0;
+    }
+    if (read_bytes <= 0 || request[0] == OP_CODE_QUIT_REQUEST) {
+      return 1;
+    }
+
+    if (read_bytes == sizeof(request) &&
+        (request[0] == OP_CODE_SUBSCRIBE_REQUEST || request[0] == OP_CODE_UNSUBSCRIBE_REQUEST)) {
+      unsigned int event_id;
+      memcpy(&event_id, request + sizeof(char), sizeof(unsigned int));
+      handle_subscription_request(subscriber, request[0], event_id);
+    }
+  }
+}
+
+/// Moves the queued notifications of a subscriber to its output, as many as fit in a record.
+/// @return 0 if successful, 1 otherwise.
+static int fill_output(struct Subscriber *subscriber) {
+  subscriber->out_len = 0;
+  subscriber->out_offset = 0;
+
+  mutex_lock(&subscriptions_lock);
+
+  // Resyncs are sent first, the notifications after them are the ones that weren't dropped
+  size_t len = subscriber->resync ? sizeof(char) : 0;
+  size_t count = 0;
+  for (; count < subscriber->queue_len; count++) {
+    struct Notification *notification = subscriber->queue[(subscriber->queue_start + count) % SUBSCRIBER_QUEUE_MAX];
+    if (len > 0 && len + notification->len > PACKET_MAX_LEN) {
+      break;
+    }
+    len += notification->len;
+  }
+
+  if (len > subscriber->out_capacity) {
+    char *temp = realloc(subscriber->out, len);
+    if (temp == NULL) {
+      mutex_unlock(&subscriptions_lock);
+      perror("Failed to allocate notifications");
+      return 1;
+    }
+    subscriber->out = temp;
+    subscriber->out_capacity = len;
+  }
+
+  if (subscriber->resync) {
+    char type = NOTIFICATION_RESYNC;
+    create_message(subscriber->out, &subscriber->out_len, &type, sizeof(char));
+    subscriber->resync = 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    struct Notification *notification = subscriber->queue[subscriber->queue_start];
+    create_message(subscriber->out, &subscriber->out_len, notification->payload, notification->len);
+    notification_release(notification);
+    subscriber->queue_start = (subscriber->queue_start + 1) % SUBSCRIBER_QUEUE_MAX;
+    subscriber->queue_len--;
+  }
+
+  mutex_unlock(&subscriptions_lock);
+  return 0;
+}
+
+/// Sets the events the notifier waits for on a subscription connection.
+static void watch(struct Subscriber *subscriber, uint32_t events) {
+  struct epoll_event event = {.events = events, .data.ptr = subscriber};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, subscriber->socket_fd, &event) < 0) {
+    perror("Failed to watch subscription connection");
+  }
+}
+
+/// Writes the notifications of a subscriber until there are no more or its socket is full.
+/// @return 0 if successful, 1 if the connection is over.
+static int flush(struct Subscriber *subscriber) {
+  while (1) {
+    if (subscriber->out_offset == subscriber->out_len) {
+      if (fill_output(subscriber)) {
+        return 1;
+      }
+      if (subscriber->out_len == 0) {
+        return 0;
+      }
+    }
+
+    size_t len = subscriber->out_len - subscriber->out_offset;
+    if (len > PACKET_MAX_LEN) {
+      len = PACKET_MAX_LEN;
+    }
+
+    // Never blocks, a slow subscriber only holds back its own notifications
+    ssize_t written = send(subscriber->socket_fd, subscriber->out + subscriber->out_offset, len, MSG_DONTWAIT);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      subscriber->waiting_writable = 1;
+      watch(subscriber, EPOLLIN | EPOLLOUT);
+      return 0;
+    }
+    if (written < 0) {
+      return 1;
+    }
+
+    stats_count(STATS_NOTIFY_RECORDS, 1);
+    subscriber->out_offset += (size_t)written;
+  }
+}
+
+static void *notify_loop(void *arg) {
+  (void)arg;
+
+  sigset_t sigmask;
+  sigemptyset(&sigmask);
+  sigaddset(&sigmask, SIGUSR1);
+  sigaddset(&sigmask, SIGINT);
+  if (pthread_sigmask(SIG_BLOCK, &sigmask, NULL) != 0) {
+    perror("Failed to block signals in the notifier thread");
+  }
+
+  struct epoll_event events[NOTIFIER_EVENTS];
+  while (1) {
+    int num_events = epoll_wait(epoll_fd, events, NOTIFIER_EVENTS, -1);
+    if (num_events < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("Failed to wait for subscription connections");
+      return NULL;
+    }
+
+    for (int i = 0; i < num_events; i++) {
+      struct Subscriber *subscriber = events[i].data.ptr;
+      if (subscriber == NULL) {
+        uint64_t value;
+        if (read(wake_fd, &value, sizeof(value)) != sizeof(value)) {
+          perror("Failed to read notifier wake up");
+        }
+        mutex_lock(&subscriptions_lock);
+        int stop = stopping;
+        mutex_unlock(&subscriptions_lock);
+        if (stop) {
+          return NULL;
+        }
+        continue;
+      }
+
+      if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && read_requests(subscriber)) {
+        remove_subscriber(subscriber);
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) {
+        subscriber->waiting_writable = 0;
+        watch(subscriber, EPOLLIN);
+        if (flush(subscriber)) {
+          remove_subscriber(subscriber);
+        }
+      }
+    }
+
+    // Write what was queued meanwhile. Publishers may queue more as soon as the lock is released, so the pending list
+    // is taken over through a link of the notifier's own.
+    mutex_lock(&subscriptions_lock);
+    struct Subscriber *to_flush = NULL;
+    for (struct Subscriber *pending = pending_subscribers; pending != NULL; pending = pending->next_pending) {
+      pending->pending = 0;
+      pending->next_flush = to_flush;
+      to_flush = pending;
+    }
+    pending_subscribers = NULL;
+    mutex_unlock(&subscriptions_lock);
+
+    while (to_flush != NULL) {
+      struct Subscriber *next = to_flush->next_flush;
+      if (!to_flush->waiting_writable && flush(to_flush)) {
+        remove_subscriber(to_flush);
+      }
+      to_flush = next;
+    }
+  }
+}
+
+int subscriptions_init() {
+  epoll_fd = epoll_create1(0);
+  wake_fd = eventfd(0, 0);
+  if (epoll_fd < 0 || wake_fd < 0) {
+    perror("Failed to set up subscriptions");
+    return 1;
+  }
+
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0 ||
+      pthread_create(&notifier, NULL, notify_loop, NULL) != 0) {
+    perror("Failed to set up subscriptions");
+    close(epoll_fd);
+    close(wake_fd);
+    epoll_fd = wake_fd = -1;
+    return 1;
+  }
+  return 0;
+}
+
+int subscriptions_add(int socket_fd, unsigned int event_id) {
+  if (epoll_fd == -1) {
+    return 1;
+  }
+
+  unsigned int version;
+  size_t num_rows, num_cols;
+  int exists = get_event_version(event_id, &version, &num_rows, &num_cols) == 0;
+
+  struct Subscriber *subscriber = calloc(1, sizeof(struct Subscriber));
+  if (subscriber == NULL) {
+    perror("Failed to allocate subscriber");
+    return 1;
+  }
+  subscriber->socket_fd = socket_fd;
+
+  // Set up whole under the lock, the notifier may see the connection as soon as it's added
+  mutex_lock(&subscriptions_lock);
+  if (stopping) {
+    mutex_unlock(&subscriptions_lock);
+    free(subscriber);
+    return 1;
+  }
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = subscriber};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket_fd, &event) < 0) {
+    mutex_unlock(&subscriptions_lock);
+    perror("Failed to watch subscription connection");
+    free(subscriber);
+    return 1;
+  }
+  int result = exists ? subscribe_locked(subscriber, event_id) : 1;
+  queue_answer(subscriber, OP_CODE_SUBSCRIBE_REQUEST, event_id, result);
+  mutex_unlock(&subscriptions_lock);
+
+  wake_notifier();
+  return 0;
+}
+
+void subscriptions_publish(unsigned int event_id, unsigned int reservation_id, size_t num_seats, size_t *xs,
+                           size_t *ys) {
+  if (__atomic_load_n(&num_subscriptions, __ATOMIC_ACQUIRE) == 0) {
+    return;
+  }
+
+  // Serialized once, whatever the number of subscribers
+  // [ type (char) ] | [ event_id (unsigned int) ] | [ reservation_id (unsigned int) ] | [ num_seats (size_t) ]
+  // | [ xs (size_t[num_seats]) ] | [ ys (size_t[num_seats]) ]
+  size_t len = sizeof(char) + 2 * sizeof(unsigned int) + sizeof(size_t) + 2 * sizeof(size_t) * num_seats;
+  struct Notification *notification = malloc(sizeof(struct Notification) + len);
+  if (notification == NULL) {
+    perror("Failed to allocate notification");
+    return;
+  }
+  char type = NOTIFICATION_RESERVATION;
+  notification->refs = 0;
+  notification->len = 0;
+  create_message(notification->payload, &notification->len, &type, sizeof(char));
+  create_message(notification->payload, &notification->len, &event_id, sizeof(unsigned int));
+  create_message(notification->payload, &notification->len, &reservation_id, sizeof(unsigned int));
+  create_message(notification->payload, &notification->len, &num_seats, sizeof(size_t));
+  create_message(notification->payload, &notification->len, xs, sizeof(size_t) * num_seats);
+  create_message(notification->payload, &notification->len, ys, sizeof(size_t) * num_seats);
+
+  int wake = 0;
+  mutex_lock(&subscriptions_lock);
+  struct EventSubscribers *entry = find_subscribers(event_id, 0);
+  for (size_t i = 0; entry != NULL && i < entry->len; i++) {
+    wake |= queue_notification(entry->subscribers[i], notification);
+  }
+  if (notification->refs == 0) {
+    free(notification);
+  }
+  mutex_unlock(&subscriptions_lock);
+
+  if (wake) {
+    wake_notifier();
+  }
+}
+
+void subscriptions_terminate() {
+  if (epoll_fd == -1) {
+    return;
+  }
+
+  mutex_lock(&subscriptions_lock);
+  int stopped = stopping;
+  stopping = 1;
+  mutex_unlock(&subscriptions_lock);
+  if (stopped) {
+    return;
+  }
+
+  wake_notifier();
+  pthread_join(notifier, NULL);
+}
@@ -0,0 +1,30 @@
+#ifndef SERVER_SUBSCRIPTIONS_H
+#define SERVER_SUBSCRIPTIONS_H
+
+#include <stddef.h>
+
+/// Starts the notifier thread, which writes the notifications of every subscription connection and reads their
+/// further (un)subscribe requests.
+/// @return 0 if successful, 1 otherwise.
+int subscriptions_init();
+
+/// Hands a socket over to the notifier once its first request subscribed to an event.
+/// @param socket_fd Socket of the subscription connection.
+/// @param event_id Event of the first subscription.
+/// @return 0 if successful, 1 if the notifier isn't running or has no room for the connection.
+int subscriptions_add(int socket_fd, unsigned int event_id);
+
+/// Queues a reservation for every subscriber of its event.
+/// @note Called with the event locked, so subscribers get the reservations of an event in order.
+/// @param event_id Id of the event.
+/// @param reservation_id Id of the reservation.
+/// @param num_seats Number of reserved seats.
+/// @param xs Rows of the seats.
+/// @param ys Columns of the seats.
+void subscriptions_publish(unsigned int event_id, unsigned int reservation_id, size_t num_seats, size_t *xs,
+                           size_t *ys);
+
+/// Stops the notifier thread, so it no longer looks up events. Connections added afterwards are refused.
+void subscriptions_terminate();
+
+#endif  // SERVER_SUBSCRIPTIONS_H
@@ -0,0 +1,392 @@
+#define _GNU_SOURCE  // syscall and eventfd
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "common/clock.h"
+#include "common/locks.h"
+#include "stats.h"
+
+#define URING_ENTRIES 256  // Enough for a write, a read and the wake up of every session
+
+// user_data of the completions, besides the ones of the sessions
+#define WAKE_USER_DATA UINT64_MAX
+
+// Minimal io_uring, mapped straight out of the kernel interface
+struct Ring {
+  int fd;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  unsigned sq_entries;
+  unsigned sq_local_tail;  // Tail of the submissions not yet published to the kernel
+
+  void *sq_ptr, *cq_ptr;
+  size_t sq_len, cq_len, sqes_len;
+};
+
+struct Slot {
+  client_t client;                // Session, the request is read into client.reader.buffer
+  char response[PACKET_MAX_LEN];  // Response to be written by the ring
+  size_t response_len;
+  int in_use;
+  int close_session;
+  struct Slot *next_ready;  // Next slot handed back to the ring
+};
+
+static struct Ring ring;
+static struct Slot *slots = NULL;
+static int fixed_buffers = 0;  // Whether the slot buffers were registered
+
+static pc_queue_t *request_queue;
+static pthread_t ring_thread;
+
+// Slots handed back to the ring by the workers and the listener
+static pthread_mutex_t ready_lock;
+static struct Slot *ready_slots = NULL;
+static int wake_fd = -1;
+static uint64_t wake_value;
+
+static int ring_setup(unsigned entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    return 1;
+  }
+  ring.fd = fd;
+
+  ring.sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring.cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring.cq_len > ring.sq_len) {
+      ring.sq_len = ring.cq_len;
+    }
+    ring.cq_len = ring.sq_len;
+  }
+
+  ring.sq_ptr = mmap(NULL, ring.sq_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING);
+  if (ring.sq_ptr == MAP_FAILED) {
+    close(fd);
+    return 1;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring.cq_ptr = ring.sq_ptr;
+  } else {
+    ring.cq_ptr = mmap(NULL, ring.cq_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING);
+    if (ring.cq_ptr == MAP_FAILED) {
+      munmap(ring.sq_ptr, ring.sq_len);
+      close(fd);
+      return 1;
+    }
+  }
+
+  ring.sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring.sqes = mmap(NULL, ring.sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+  if (ring.sqes == MAP_FAILED) {
+    if (ring.cq_ptr != ring.sq_ptr) {
+      munmap(ring.cq_ptr, ring.cq_len);
+    }
+    munmap(ring.sq_ptr, ring.sq_len);
+    close(fd);
+    return 1;
+  }
+
+  char *sq = ring.sq_ptr, *cq = ring.cq_ptr;
+  ring.sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring.sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring.sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring.sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring.cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring.cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring.cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  ring.sq_entries = params.sq_entries;
+  ring.sq_local_tail = *ring.sq_tail;
+
+  return 0;
+}
+
+/// Gets a free submission entry, cleared.
+/// @note The ring is sized so that it never runs out of entries within a round.
+static struct io_uring_sqe *ring_get_sqe() {
+  unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+  if (ring.sq_local_tail - head >= ring.sq_entries) {
+    return NULL;
+  }
+
+  unsigned index = ring.sq_local_tail & *ring.sq_mask;
+  struct io_uring_sqe *sqe = &ring.sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  ring.sq_array[index] = index;
+  ring.sq_local_tail++;
+  return sqe;
+}
+
+/// Submits every pending entry and waits for at least one completion.
+static int ring_submit_and_wait() {
+  unsigned to_submit = ring.sq_local_tail - *ring.sq_tail;
+  __atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+
+  stats_count(STATS_URING_ENTERS, 1);
+  long result = syscall(__NR_io_uring_enter, ring.fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+  if (result < 0 && errno != EINTR) {
+    perror("Failed to enter the ring");
+    return 1;
+  }
+  return 0;
+}
+
+static void prep_rw(struct io_uring_sqe *sqe, int op, int fd, void *buf, size_t len, int buf_index, uint64_t data) {
+  sqe->opcode = (__u8)op;
+  sqe->fd = fd;
+  sqe->addr = (__u64)(uintptr_t)buf;
+  sqe->len = (__u32)len;
+  sqe->user_data = data;
+  if (buf_index >= 0) {
+    sqe->buf_index = (__u16)buf_index;
+  }
+}
+
+/// Queues the read of the next request of a session.
+static void queue_read(size_t slot_index) {
+  struct Slot *slot = &slots[slot_index];
+  struct io_uring_sqe *sqe = ring_get_sqe();
+  if (sqe == NULL) {
+    return;
+  }
+
+  // user_data: [ slot index ] | [ 1 for reads ]
+  prep_rw(sqe, fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ, slot->client.socket_fd,
+          slot->client.reader.buffer, PACKET_MAX_LEN, fixed_buffers ? (int)(slot_index * 2) : -1,
+          (uint64_t)slot_index << 1 | 1);
+}
+
+/// Queues the write of the stored response, linked to the read of the next request.
+static void queue_write(size_t slot_index) {
+  struct Slot *slot = &slots[slot_index];
+  struct io_uring_sqe *sqe = ring_get_sqe();
+  if (sqe == NULL) {
+    return;
+  }
+
+  prep_rw(sqe, fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, slot->client.socket_fd, slot->response,
+          slot->response_len, fixed_buffers ? (int)(slot_index * 2 + 1) : -1, (uint64_t)slot_index << 1);
+  sqe->flags |= IOSQE_IO_LINK;
+  slot->response_len = 0;
+}
+
+static void queue_wake_read() {
+  struct io_uring_sqe *sqe = ring_get_sqe();
+  if (sqe != NULL) {
+    prep_rw(sqe, IORING_OP_READ, wake_fd, &wake_value, sizeof(wake_value), -1, WAKE_USER_DATA);
+  }
+}
+
+static void close_slot(struct Slot *slot) {
+  close(slot->client.socket_fd);
+  mutex_lock(&ready_lock);
+  slot->in_use = 0;
+  mutex_unlock(&ready_lock);
+}
+
+/// Hands a slot back to the ring thread and wakes it up.
+static void push_ready(struct Slot *slot) {
+  mutex_lock(&ready_lock);
+  slot->next_ready = ready_slots;
+  ready_slots = slot;
+  mutex_unlock(&ready_lock);
+
+  uint64_t one = 1;
+  if (write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+    perror("Failed to wake up the ring");
+  }
+}
+
+static void *ring_loop(void *arg) {
+  (void)arg;
+
+  sigset_t sigmask;
+  sigemptyset(&sigmask);
+  sigaddset(&sigmask, SIGUSR1);
+  sigaddset(&sigmask, SIGINT);
+  if (pthread_sigmask(SIG_BLOCK, &sigmask, NULL) != 0) {
+    perror("Failed to block signals in the ring thread");
+  }
+
+  queue_wake_read();
+
+  while (1) {
+    // Queue the I/O of every session handed back since the last round
+    mutex_lock(&ready_lock);
+    struct Slot *ready = ready_slots;
+    ready_slots = NULL;
+    mutex_unlock(&ready_lock);
+
+    while (ready != NULL) {
+      struct Slot *next = ready->next_ready;
+      size_t slot_index = (size_t)(ready - slots);
+
+      if (ready->close_session) {
+        close_slot(ready);
+      } else {
+        if (ready->response_len > 0) {
+          queue_write(slot_index);
+        }
+        queue_read(slot_index);
+      }
+      ready = next;
+    }
+
+    if (ring_submit_and_wait()) {
+      return NULL;
+    }
+
+    unsigned head = *ring.cq_head;
+    unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+
+      if (cqe->user_data == WAKE_USER_DATA) {
+        queue_wake_read();
+        continue;
+      }
+
+      struct Slot *slot = &slots[cqe->user_data >> 1];
+      if ((cqe->user_data & 1) == 0) {
+        // Failed writes cancel the linked read, which closes the session
+        stats_count(STATS_URING_RESPONSES, cqe->res >= 0);
+        continue;
+      }
+
+      if (cqe->res <= 0) {
+        close_slot(slot);  // Client left, or the linked write failed
+        continue;
+      }
+
+      stats_count(STATS_URING_REQUESTS, 1);
+      slot->client.reader.len = (size_t)cqe->res;
+      slot->client.reader.offset = 0;
+      slot->client.queued_ns = clock_now_ns();
+      if (pcq_enqueue(request_queue, &slot->client)) {
+        close_slot(slot);
+      }
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+  }
+}
+
+int uring_backend_init(pc_queue_t *queue) {
+  if (ring_setup(URING_ENTRIES)) {
+    return 1;
+  }
+
+  slots = calloc(URING_MAX_SESSIONS, sizeof(struct Slot));
+  wake_fd = eventfd(0, 0);
+  if (slots == NULL || wake_fd < 0) {
+    free(slots);
+    close(ring.fd);
+    return 1;
+  }
+
+  struct iovec iovecs[URING_MAX_SESSIONS * 2];
+  for (size_t i = 0; i < URING_MAX_SESSIONS; i++) {
+    slots[i].client.uring_slot = (int)i;
+    slots[i].client.session_id = (int)i;
+    slots[i].client.request_fd = -1;
+    slots[i].client.job_fd = -1;
+    iovecs[i * 2] = (struct iovec){slots[i].client.reader.buffer, PACKET_MAX_LEN};
+    iovecs[i * 2 + 1] = (struct iovec){slots[i].response, PACKET_MAX_LEN};
+  }
+
+  // Pinning the buffers may exceed RLIMIT_MEMLOCK, in which case the ring copies them as usual
+  fixed_buffers =
+      syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, iovecs, URING_MAX_SESSIONS * 2) == 0;
+
+  request_queue = queue;
+  mutex_init(&ready_lock);
+
+  if (pthread_create(&ring_thread, NULL, ring_loop, NULL) != 0) {
+    mutex_destroy(&ready_lock);
+    free(slots);
+    close(wake_fd);
+    close(ring.fd);
+    return 1;
+  }
+
+  fprintf(stdout, "Using the io_uring backend%s.\n", fixed_buffers ? " with registered buffers" : "");
+  return 0;
+}
+
+int uring_backend_add_session(int socket_fd) {
+  mutex_lock(&ready_lock);
+  struct Slot *slot = NULL;
+  for (size_t i = 0; i < URING_MAX_SESSIONS; i++) {
+    if (!slots[i].in_use) {
+      slot = &slots[i];
+      slot->in_use = 1;
+      break;
+    }
+  }
+  mutex_unlock(&ready_lock);
+
+  if (slot == NULL) {
+    return 1;
+  }
+
+  slot->client.socket_fd = socket_fd;
+  slot->client.wire_version = WIRE_VERSION_NATIVE;
+  slot->client.reservation.len = 0;  // The buffer of the previous session of the slot is reused
+  slot->client.reservation.lost = 0;
+  if (slot->client.job_fd != -1) {
+    close(slot->client.job_fd);  // Left by a previous session that never ran its job
+    slot->client.job_fd = -1;
+  }
+  packet_reader_init(&slot->client.reader, -1);  // Records are read by the ring
+  slot->response_len = 0;
+  slot->close_session = 0;
+  push_ready(slot);
+  return 0;
+}
+
+int uring_backend_respond(client_t *client, const void *buf, size_t buf_len) {
+  struct Slot *slot = &slots[client->uring_slot];
+
+  if (buf_len > PACKET_MAX_LEN) {
+    return packet_print(client->socket_fd, buf, buf_len);
+  }
+
+  memcpy(slot->response, buf, buf_len);
+  slot->response_len = buf_len;
+  return 0;
+}
+
+void uring_backend_done(client_t *client, int close_session) {
+  struct Slot *slot = &slots[client->uring_slot];
+  slot->close_session = close_session;
+  push_ready(slot);
+}
+
+int uring_backend_detach(client_t *client) {
+  struct Slot *slot = &slots[client->uring_slot];
+
+  // The ring has no I/O in flight for a session whose request is with a worker
+  mutex_lock(&ready_lock);
+  slot->in_use = 0;
+  mutex_unlock(&ready_lock);
+  return slot->client.socket_fd;
+}
@@ -0,0 +1,47 @@
+#ifndef SERVER_URING_H
+#define SERVER_URING_H
+
+#include <stddef.h>
+
+#include "common/io.h"
+#include "producer-consumer.h"
+
+#define URING_MAX_SESSIONS 64  // Sessions multiplexed by the ring
+
+// I/O backend used to serve socket sessions
+enum IoBackend {
+  IO_BACKEND_BLOCKING,  // One worker blocks on each session
+  IO_BACKEND_URING      // One ring batches the I/O of every session
+};
+
+/// Starts the io_uring backend: sets up the ring, registers the session buffers and creates the ring thread.
+/// Requests read by the ring are added to the given queue for the workers to handle.
+/// @param queue Queue where the requests are added, with room for URING_MAX_SESSIONS entries.
+/// @return 0 if the backend was started, 1 if io_uring is unavailable and the blocking path should be used.
+int uring_backend_init(pc_queue_t *queue);
+
+/// Hands an accepted socket over to the ring.
+/// @param socket_fd Socket of the session.
+/// @return 0 if successful, 1 if the ring has no room for another session.
+int uring_backend_add_session(int socket_fd);
+
+/// Stores the response of the request being handled, to be written by the ring.
+/// @note Responses that don't fit in a single record are written directly by the caller.
+/// @param client Client being responded to.
+/// @param buf Content of the response.
+/// @param buf_len Length of the response.
+/// @return 0 if successful, 1 otherwise.
+int uring_backend_respond(client_t *client, const void *buf, size_t buf_len);
+
+/// Gives the session back to the ring once its request was handled, so it writes the response and reads the next
+/// request.
+/// @param client Client whose request was handled.
+/// @param close_session Whether the session is over and should be closed instead.
+void uring_backend_done(client_t *client, int close_session);
+
+/// Takes a session out of the ring while its request is being handled, leaving its socket open.
+/// @param client Client whose request is being handled.
+/// @return Socket of the session, now up to the caller.
+int uring_backend_detach(client_t *client);
+
+#endif  // SERVER_URING_H
@@ -0,0 +1,338 @@
+#include "wal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "common/locks.h"
+
+// [ type (uint8_t) ] | [ payload_len (uint32_t) ] | [ checksum (uint32_t) ] | [ payload ]
+#define WAL_HEADER_LEN (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t))
+#define WAL_INITIAL_BUFFER_LEN 65536
+
+static int log_fd = -1;
+static enum WalMode log_mode = WAL_NONE;
+
+static pthread_mutex_t log_lock;
+static pthread_cond_t log_flushed;
+
+// Records appended but not yet written. The flushing thread writes one buffer while the others append to the other.
+static char *active_buffer = NULL, *flush_buffer = NULL;
+static size_t active_len = 0, active_capacity = 0, flush_capacity = 0;
+
+static unsigned long long appended_lsn = 0;  // Last record appended
+static unsigned long long durable_lsn = 0;   // Last record made durable
+static int flushing = 0;                     // Whether a thread is writing the log
+
+/// Stops the server when a record can't be logged. The operation it records was already applied and seen by other
+/// sessions, so it can't be reported as failed, and the state must not go on without it.
+/// @param message Description of what failed.
+static void fail_stop(const char *message) {
+  perror(message);
+  exit(EXIT_FAILURE);
+}
+
+/// FNV-1a hash of a record, to detect torn writes at the end of the log.
+static uint32_t checksum(uint8_t type, const char *payload, size_t payload_len) {
+  uint32_t hash = 2166136261u;
+  hash = (hash ^ type) * 16777619u;
+  for (size_t i = 0; i < payload_len; i++) {
+    hash = (hash ^ (uint8_t)payload[i]) * 16777619u;
+  }
+  return hash;
+}
+
+int wal_parse_mode(const char *name, enum WalMode *mode) {
+  if (strcmp(name, "none") == 0) {
+    *mode = WAL_NONE;
+  } else if (strcmp(name, "batched") == 0) {
+    *mode = WAL_BATCHED;
+  } else if (strcmp(name, "per-op") == 0) {
+    *mode = WAL_PER_OP;
+  } else {
+    return 1;
+  }
+  return 0;
+}
+
+long wal_replay(const char *path, unsigned long long skip, int (*on_create)(unsigned int, size_t, size_t),
+                int (*on_reserve)(unsigned int, size_t, size_t *, size_t *)) {
+  int fd = open(path, O_RDWR);
+  if (fd < 0) {
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  size_t size = (size_t)st.st_size;
+  if (size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  // Mapped rather than read, so the records covered by a snapshot are skipped without being copied
+  char *log = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (log == MAP_FAILED) {
+    perror("Failed to map the log");
+    close(fd);
+    return -1;
+  }
+  posix_madvise(log, size, POSIX_MADV_SEQUENTIAL);
+
+  size_t *seats = NULL;
+  size_t seats_capacity = 0;
+
+  long records = 0;
+  size_t offset = 0;
+  while (offset + WAL_HEADER_LEN <= size) {
+    uint8_t type;
+    uint32_t payload_len, record_checksum;
+    memcpy(&type, log + offset, sizeof(uint8_t));
+    memcpy(&payload_len, log + offset + sizeof(uint8_t), sizeof(uint32_t));
+    memcpy(&record_checksum, log + offset + sizeof(uint8_t) + sizeof(uint32_t), sizeof(uint32_t));
+
+    char *payload = log + offset + WAL_HEADER_LEN;
+    if (payload_len > size - offset - WAL_HEADER_LEN) {
+      break;  // Torn write
+    }
+    if ((unsigned long long)records < skip) {
+      offset += WAL_HEADER_LEN + payload_len;
+      records++;
+      continue;
+    }
+    if (checksum(type, payload, payload_len) != record_checksum) {
+      break;  // Torn write
+    }
+
+    // Records of the wrong length are corrupted, nothing after them can be trusted
+    unsigned int event_id;
+    if (payload_len < sizeof(unsigned int)) {
+      break;
+    }
+    memcpy(&event_id, payload, sizeof(unsigned int));
+
+    if (type == WAL_RECORD_CREATE) {
+      if (payload_len != sizeof(unsigned int) + 2 * sizeof(size_t)) {
+        break;
+      }
+      size_t num_rows, num_cols;
+      memcpy(&num_rows, payload + sizeof(unsigned int), sizeof(size_t));
+      memcpy(&num_cols, payload + sizeof(unsigned int) + sizeof(size_t), sizeof(size_t));
+      on_create(event_id, num_rows, num_cols);
+    } else if (type == WAL_RECORD_RESERVE) {
+      size_t num_seats;
+      if (payload_len < sizeof(unsigned int) + sizeof(size_t)) {
+        break;
+      }
+      memcpy(&num_seats, payload + sizeof(unsigned int), sizeof(size_t));
+      if (num_seats > (payload_len - sizeof(unsigned int) - sizeof(size_t)) / (2 * sizeof(size_t)) ||
+          payload_len != sizeof(unsigned int) + sizeof(size_t) * (1 + 2 * num_seats)) {
+        break;
+      }
+
+      // The mapped payload isn't aligned, so the seats are copied into a buffer reused across records
+      if (2 * num_seats > seats_capacity) {
+        size_t *temp = realloc(seats, sizeof(size_t) * 2 * num_seats);
+        if (temp == NULL) {
+          break;
+        }
+        seats = temp;
+        seats_capacity = 2 * num_seats;
+      }
+      memcpy(seats, payload + sizeof(unsigned int) + sizeof(size_t), sizeof(size_t) * 2 * num_seats);
+      on_reserve(event_id, num_seats, seats, seats + num_seats);
+    }
+
+    offset += WAL_HEADER_LEN + payload_len;
+    records++;
+  }
+
+  // Appends continue right after the last complete record
+  if (offset < size && ftruncate(fd, (off_t)offset) < 0) {
+    perror("Failed to cut the torn end of the log");
+  }
+
+  free(seats);
+  munmap(log, size);
+  close(fd);
+  return records;
+}
+
+int wal_open(const char *path, enum WalMode mode, unsigned long long num_records) {
+  log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0640);
+  if (log_fd < 0) {
+    perror("Failed to open the log");
+    return 1;
+  }
+
+  active_buffer = malloc(WAL_INITIAL_BUFFER_LEN);
+  flush_buffer = malloc(WAL_INITIAL_BUFFER_LEN);
+  if (active_buffer == NULL || flush_buffer == NULL) {
+    free(active_buffer);
+    free(flush_buffer);
+    close(log_fd);
+    log_fd = -1;
+    return 1;
+  }
+  active_capacity = flush_capacity = WAL_INITIAL_BUFFER_LEN;
+
+  appended_lsn = durable_lsn = num_records;
+  log_mode = mode;
+  mutex_init(&log_lock);
+  cond_init(&log_flushed);
+  return 0;
+}
+
+int wal_is_open() { return log_fd != -1; }
+
+unsigned long long wal_last_lsn() {
+  if (log_fd == -1) {
+    return 0;
+  }
+
+  mutex_lock(&log_lock);
+  unsigned long long lsn = appended_lsn;
+  mutex_unlock(&log_lock);
+  return lsn;
+}
+
+/// Writes and syncs the buffered records, called with log_lock held and released while writing.
+static void flush_locked() {
+  // Swap buffers so other threads keep appending while this one writes
+  char *buffer = active_buffer;
+  size_t len = active_len, capacity = active_capacity;
+  active_buffer = flush_buffer;
+  active_capacity = flush_capacity;
+  active_len = 0;
+  unsigned long long target_lsn = appended_lsn;
+  flushing = 1;
+  mutex_unlock(&log_lock);
+
+  if (pipe_print(log_fd, buffer, len) != 0 || (log_mode != WAL_NONE && fdatasync(log_fd) != 0)) {
+    fail_stop("Failed to write the log");
+  }
+
+  mutex_lock(&log_lock);
+  flush_buffer = buffer;
+  flush_capacity = capacity;
+  flushing = 0;
+  durable_lsn = target_lsn;
+  cond_broadcast(&log_flushed);
+}
+
+/// Appends a record to the active buffer.
+/// @return Sequence number of the record, 0 if there's no log.
+static unsigned long long append(uint8_t type, const void *parts[], const size_t parts_len[], size_t num_parts) {
+  if (log_fd == -1) {
+    return 0;
+  }
+
+  size_t payload_len = 0;
+  for (size_t i = 0; i < num_parts; i++) {
+    payload_len += parts_len[i];
+  }
+
+  mutex_lock(&log_lock);
+
+  if (active_len + WAL_HEADER_LEN + payload_len > active_capacity) {
+    size_t capacity = active_capacity;
+    while (active_len + WAL_HEADER_LEN + payload_len > capacity) {
+      capacity *= 2;
+    }
+    char *temp = realloc(active_buffer, capacity);
+    if (temp == NULL) {
+      fail_stop("Failed to grow the log buffer");
+    }
+    active_buffer = temp;
+    active_capacity = capacity;
+  }
+
+  // [ type (uint8_t) ] | [ payload_len (uint32_t) ] | [ checksum (uint32_t) ] | [ payload ]
+  size_t offset = active_len + WAL_HEADER_LEN;
+  for (size_t i = 0; i < num_parts; i++) {
+    create_message(active_buffer, &offset, parts[i], parts_len[i]);
+  }
+  uint32_t len = (uint32_t)payload_len;
+  uint32_t record_checksum = checksum(type, active_buffer + active_len + WAL_HEADER_LEN, payload_len);
+  size_t header_offset = active_len;
+  create_message(active_buffer, &header_offset, &type, sizeof(uint8_t));
+  create_message(active_buffer, &header_offset, &len, sizeof(uint32_t));
+  create_message(active_buffer, &header_offset, &record_checksum, sizeof(uint32_t));
+  active_len = offset;
+
+  unsigned long long lsn = ++appended_lsn;
+
+  // Without batching, every record pays for its own write and sync, holding everyone else back
+  if (log_mode == WAL_PER_OP) {
+    if (pipe_print(log_fd, active_buffer, active_len) != 0 || fdatasync(log_fd) != 0) {
+      fail_stop("Failed to write the log");
+    }
+    durable_lsn = lsn;
+    active_len = 0;
+  }
+
+  mutex_unlock(&log_lock);
+  return lsn;
+}
+
+unsigned long long wal_append_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  // [ event_id (unsigned int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ]
+  const void *parts[] = {&event_id, &num_rows, &num_cols};
+  const size_t parts_len[] = {sizeof(unsigned int), sizeof(size_t), sizeof(size_t)};
+  return append(WAL_RECORD_CREATE, parts, parts_len, 3);
+}
+
+unsigned long long wal_append_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
+  // [ event_id (unsigned int) ] | [ num_seats (size_t) ] | [ xs (size_t[num_seats]) ] | [ ys (size_t[num_seats]) ]
+  const void *parts[] = {&event_id, &num_seats, xs, ys};
+  const size_t parts_len[] = {sizeof(unsigned int), sizeof(size_t), sizeof(size_t) * num_seats,
+                              sizeof(size_t) * num_seats};
+  return append(WAL_RECORD_RESERVE, parts, parts_len, 4);
+}
+
+void wal_commit(unsigned long long lsn) {
+  if (log_fd == -1) {
+    return;
+  }
+
+  mutex_lock(&log_lock);
+
+  // The first thread to wait becomes the leader and syncs every record appended so far, the rest wait for it
+  while (durable_lsn < lsn) {
+    if (flushing) {
+      cond_wait(&log_flushed, &log_lock);
+    } else {
+      flush_locked();
+    }
+  }
+
+  mutex_unlock(&log_lock);
+}
+
+void wal_close() {
+  if (log_fd == -1) {
+    return;
+  }
+
+  wal_commit(appended_lsn);
+  close(log_fd);
+  log_fd = -1;
+
+  free(active_buffer);
+  free(flush_buffer);
+  active_buffer = flush_buffer = NULL;
+  mutex_destroy(&log_lock);
+  cond_destroy(&log_flushed);
+}
@@ -0,0 +1,70 @@
+#ifndef SERVER_WAL_H
+#define SERVER_WAL_H
+
+#include <stddef.h>
+
+// When appended records are made durable
+enum WalMode {
+  WAL_NONE,     // Written to the log file, never synced
+  WAL_BATCHED,  // Synced in groups, one fsync covers every record appended meanwhile
+  WAL_PER_OP    // Synced on every record
+};
+
+// Types of log records
+enum WalRecordType { WAL_RECORD_CREATE = 1, WAL_RECORD_RESERVE = 2 };
+
+/// Parses the name of a durability mode.
+/// @param name Name of the mode: none, batched or per-op.
+/// @param mode Variable to store the mode in.
+/// @return 0 if the name is valid, 1 otherwise.
+int wal_parse_mode(const char *name, enum WalMode *mode);
+
+/// Replays the records of a log, stopping at the first incomplete or corrupted one, which is cut off the file.
+/// @note The sequence number of a record is its position in the log, starting at 1.
+/// @param path Path of the log. A missing log has nothing to replay.
+/// @param skip Number of records at the start of the log that are not replayed, already covered by a snapshot.
+/// @param on_create Called for every create record.
+/// @param on_reserve Called for every reserve record.
+/// @return Number of complete records in the log, skipped ones included, -1 on failure.
+long wal_replay(const char *path, unsigned long long skip, int (*on_create)(unsigned int, size_t, size_t),
+                int (*on_reserve)(unsigned int, size_t, size_t *, size_t *));
+
+/// Opens the log for appending.
+/// @param path Path of the log.
+/// @param mode Durability mode of the log.
+/// @param num_records Number of records already in the log, as returned by wal_replay.
+/// @return 0 if successful, 1 otherwise.
+int wal_open(const char *path, enum WalMode mode, unsigned long long num_records);
+
+/// Checks if the log is open.
+/// @return 1 if records are being logged, 0 otherwise.
+int wal_is_open();
+
+/// Gets the sequence number of the last appended record. Every record up to it has already been applied to the state.
+/// @return Sequence number of the last record, 0 if there's no log or it's empty.
+unsigned long long wal_last_lsn();
+
+/// Appends a create record. Cheap enough to be called under the locks that order the operations.
+/// @param event_id Id of the created event.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @return Sequence number of the record, to be passed to wal_commit, 0 if there's no log.
+unsigned long long wal_append_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Appends a reserve record. Cheap enough to be called under the locks that order the operations.
+/// @param event_id Id of the event.
+/// @param num_seats Number of reserved seats.
+/// @param xs Rows of the seats.
+/// @param ys Columns of the seats.
+/// @return Sequence number of the record, to be passed to wal_commit, 0 if there's no log.
+unsigned long long wal_append_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+
+/// Waits until a record is as durable as the mode of the log requires. Must be called without holding EMS locks.
+/// @note A record that can't be written stops the server, as the operation it records was already applied.
+/// @param lsn Sequence number of the record, 0 for none.
+void wal_commit(unsigned long long lsn);
+
+/// Flushes and closes the log.
+void wal_close();
+
+#endif  // SERVER_WAL_H
@@ -2,24 +2,81 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "common/locks.h"
+#include "jobs.h"
 #include "operations.h"
+#include "stats.h"
+#include "uring.h"
 
-// Handlers
+// Serialized LIST response, shared by every session until an event is created
+struct ListResponse {
+  unsigned long long generation;
+  size_t refs;  // The cache holds one reference while it's the current response
+  size_t len;
+  char payload[];
+};
 
-int ems_setup_handler(int session_id, client_t *client) {
-  // Initialize variables
-  size_t response_len = sizeof(int);
-  char response[response_len];
-  size_t offset = 0;
-  memset(response, 0, response_len);
+static struct ListResponse *list_cache = NULL;
+static pthread_mutex_t list_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-  // [session id (int)]
-  create_message(response, &offset, &session_id, sizeof(int));
+// Responses holding every seat of an event, cached apart as their headers differ
+enum ShowLayout {
+  SHOW_LAYOUT_SHOW,       // SHOW response
+  SHOW_LAYOUT_SINCE_RAW,  // SHOW_SINCE response in the raw format
+  NUM_SHOW_LAYOUTS
+};
+
+// Serialized response of an event at one version
+struct ShowResponse {
+  unsigned int version;
+  size_t refs;  // The cache holds one reference while it's the current response
+  size_t len;
+  char payload[];
+};
+
+// Latest response of an event in one layout. Events are never deleted, so neither are their entries.
+struct ShowCacheEntry {
+  unsigned int event_id;
+  enum ShowLayout layout;
+  int building;  // Whether a session is serializing the event, the others wait for it instead of doing the same
+  struct ShowResponse *response;
+  struct ShowCacheEntry *next;
+};
+
+#define SHOW_CACHE_BUCKETS 1024
+
+static struct ShowCacheEntry *show_cache[SHOW_CACHE_BUCKETS];
+static pthread_mutex_t show_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t show_cache_built = PTHREAD_COND_INITIALIZER;
+
+// Transport
+
+int receive_request(client_t *client, void *buf, size_t buf_len) {
+  if (client->socket_fd != -1 || client->uring_slot != -1) {
+    return packet_parse(&client->reader, buf, buf_len);
+  }
+
+  return pipe_parse(client->request_fd, buf, buf_len);
+}
+
+int send_response(client_t *client, const void *buf, size_t buf_len) {
+  if (client->uring_slot != -1) {
+    return uring_backend_respond(client, buf, buf_len);
+  }
+
+  if (client->socket_fd != -1) {
+    if (packet_print(client->socket_fd, buf, buf_len)) {
+      fprintf(stderr, "Failed to send response.\n");
+      return 1;
+    }
+    return 0;
+  }
 
   // Connect to client pipe and send response
   int response_fd = open(client->response_pipename, O_WRONLY);
@@ -27,7 +84,7 @@ int ems_setup_handler(int session_id, client_t *client) {
     fprintf(stderr, "Failed to open response pipe.\n");
     return 1;
   }
-  if (pipe_print(response_fd, &response, response_len)) {
+  if (pipe_print(response_fd, buf, buf_len)) {
     fprintf(stderr, "Failed to send response.\n");
     close(response_fd);
     return 1;
@@ -37,6 +94,31 @@ int ems_setup_handler(int session_id, client_t *client) {
   return 0;
 }
 
+// Handlers
+
+int ems_setup_handler(int session_id, client_t *client) {
+  // The client asked for the version it holds, those newer than the server get the latest one it speaks
+  if (client->wire_version < WIRE_VERSION_NATIVE || client->wire_version > WIRE_VERSION_LATEST) {
+    client->wire_version = client->wire_version < WIRE_VERSION_NATIVE ? WIRE_VERSION_NATIVE : WIRE_VERSION_LATEST;
+  }
+
+  // Initialize variables
+  size_t response_len = sizeof(int) + sizeof(char);
+  char response[response_len];
+  size_t offset = 0;
+  memset(response, 0, response_len);
+
+  // [session id (int)] | [wire_version (char)]
+  create_message(response, &offset, &session_id, sizeof(int));
+  create_message(response, &offset, &client->wire_version, sizeof(char));
+
+  // Send response to the client
+  if (send_response(client, &response, response_len)) {
+    return 1;
+  }
+  return 0;
+}
+
 int ems_create_handler(client_t *client, unsigned int event_id, size_t num_rows, size_t num_cols) {
   size_t response_len = sizeof(int);
   char response[response_len];
@@ -49,119 +131,453 @@ int ems_create_handler(client_t *client, unsigned int event_id, size_t num_rows,
   // [result (int)]
   create_message(response, &offset, &result, sizeof(int));
 
-  // Connect to client pipe and send response
-  int response_fd = open(client->response_pipename, O_WRONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
-    return 1;
-  }
-  if (pipe_print(response_fd, &response, response_len)) {
-    fprintf(stderr, "Failed to send response.\n");
-    close(response_fd);
+  // Send response to the client
+  if (send_response(client, &response, response_len)) {
     return 1;
   }
-  close(response_fd);
 
   return 0;
 }
 
-int ems_reserve_handler(client_t *client, unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
+int ems_reserve_handler(client_t *client, unsigned int event_id, const seat_buffer_t *seats) {
   size_t response_len = sizeof(int);
   char response[response_len];
   size_t offset = 0;
   memset(response, 0, response_len);
 
-  int result = ems_reserve(event_id, num_seats, xs, ys);
+  // Reserving only the chunks that made it would break the atomicity of the reservation
+  int result = 1;
+  if (seats->lost) {
+    fprintf(stderr, "Reservation lost some of its seats\n");
+  } else {
+    result = ems_reserve(event_id, seats->len, seats->xs, seats->ys);
+  }
 
   // [result (int)]
   create_message(response, &offset, &result, sizeof(int));
 
-  // Connect to client pipe and send response
-  int response_fd = open(client->response_pipename, O_WRONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
+  // Send response to the client
+  if (send_response(client, &response, response_len)) {
     return 1;
   }
-  if (pipe_print(response_fd, &response, response_len)) {
-    fprintf(stderr, "Failed to send response.\n");
-    close(response_fd);
+
+  return 0;
+}
+
+int ems_reserve_ranges_handler(client_t *client, unsigned int event_id, size_t num_ranges, const seat_range_t *ranges) {
+  size_t response_len = sizeof(int);
+  char response[response_len];
+  size_t offset = 0;
+  memset(response, 0, response_len);
+
+  int result = ems_reserve_ranges(event_id, num_ranges, ranges);
+
+  // [result (int)]
+  create_message(response, &offset, &result, sizeof(int));
+
+  // Send response to the client
+  if (send_response(client, &response, response_len)) {
     return 1;
   }
-  close(response_fd);
 
   return 0;
 }
 
-int ems_show_handler(client_t *client, unsigned int event_id) {
-  size_t num_rows;
-  size_t num_cols;
-  unsigned int *seats;
+/// Drops a reference to a SHOW response, freeing it once it's neither cached nor being sent.
+/// @param response Response to release.
+static void show_response_release(struct ShowResponse *response) {
+  mutex_lock(&show_cache_lock);
+  int last = --response->refs == 0;
+  mutex_unlock(&show_cache_lock);
 
-  int result = get_event_info(event_id, &num_cols, &seats, &num_rows);
+  if (last) {
+    free(response);
+  }
+}
 
-  size_t response_len = sizeof(int) + sizeof(size_t) + sizeof(size_t) + sizeof(unsigned int) * num_cols * num_rows;
-  char response[response_len];
-  size_t offset = 0;
-  memset(response, 0, response_len);
+/// Serializes the current seats of an event into a new response.
+/// @param event_id Id of the event.
+/// @param layout Layout of the response.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @return Response with a single reference, NULL on failure.
+static struct ShowResponse *show_response_build(unsigned int event_id, enum ShowLayout layout, size_t num_rows,
+                                                size_t num_cols) {
+  size_t header_len = sizeof(int) + sizeof(size_t) + sizeof(size_t);
+  if (layout == SHOW_LAYOUT_SINCE_RAW) {
+    header_len += sizeof(unsigned int) + sizeof(char);
+  }
+  size_t payload_len = header_len + sizeof(unsigned int) * num_rows * num_cols;
+  struct ShowResponse *response = malloc(sizeof(struct ShowResponse) + payload_len);
+  if (response == NULL) {
+    perror("Failed to allocate show response");
+    return NULL;
+  }
+  response->refs = 1;
 
-  // [ result (int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ]
+  // The seats are copied straight into the response, the header follows as it holds their version
+  if (get_event_seats(event_id, response->payload + header_len, &response->version)) {
+    free(response);
+    return NULL;
+  }
+
+  // show: [ result (int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ]
+  // since raw: [ result (int) ] | [ version (unsigned int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ]
+  //            | [ format (char) ]
   // | [ seats[num_rows * num_cols] (unsigned int) ]
-  create_message(response, &offset, &result, sizeof(int));
-  if (result == 0) {
-    create_message(response, &offset, &num_rows, sizeof(size_t));
-    create_message(response, &offset, &num_cols, sizeof(size_t));
-    for (size_t i = 0; i < num_cols * num_rows; i++) {
-      create_message(response, &offset, &seats[i], sizeof(unsigned int));
+  int result = 0;
+  char format = SHOW_FORMAT_RAW;
+  response->len = 0;
+  create_message(response->payload, &response->len, &result, sizeof(int));
+  if (layout == SHOW_LAYOUT_SINCE_RAW) {
+    create_message(response->payload, &response->len, &response->version, sizeof(unsigned int));
+  }
+  create_message(response->payload, &response->len, &num_rows, sizeof(size_t));
+  create_message(response->payload, &response->len, &num_cols, sizeof(size_t));
+  if (layout == SHOW_LAYOUT_SINCE_RAW) {
+    create_message(response->payload, &response->len, &format, sizeof(char));
+  }
+  response->len = payload_len;
+
+  return response;
+}
+
+/// Gets a response of an event at least as recent as the given version, serializing it only if no session has done
+/// it yet. Sessions asking for the same event in the same layout while it's being serialized wait for it and share
+/// the result.
+/// @param event_id Id of the event.
+/// @param layout Layout of the response.
+/// @param version Version of the event read before.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @return Response to be released after sending, NULL on failure.
+static struct ShowResponse *show_response_acquire(unsigned int event_id, enum ShowLayout layout, unsigned int version,
+                                                  size_t num_rows, size_t num_cols) {
+  mutex_lock(&show_cache_lock);
+
+  struct ShowCacheEntry **bucket = &show_cache[(event_id * NUM_SHOW_LAYOUTS + layout) % SHOW_CACHE_BUCKETS];
+  struct ShowCacheEntry *entry = *bucket;
+  while (entry != NULL && (entry->event_id != event_id || entry->layout != layout)) {
+    entry = entry->next;
+  }
+  if (entry == NULL) {
+    entry = malloc(sizeof(struct ShowCacheEntry));
+    if (entry == NULL) {
+      mutex_unlock(&show_cache_lock);
+      return show_response_build(event_id, layout, num_rows, num_cols);
     }
+    entry->event_id = event_id;
+    entry->layout = layout;
+    entry->building = 0;
+    entry->response = NULL;
+    entry->next = *bucket;
+    *bucket = entry;
   }
 
-  // Connect to client pipe and send response
-  int response_fd = open(client->response_pipename, O_WRONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
-    return 1;
+  while (entry->response == NULL || entry->response->version < version) {
+    if (entry->building) {
+      cond_wait(&show_cache_built, &show_cache_lock);
+      continue;
+    }
+
+    entry->building = 1;
+    mutex_unlock(&show_cache_lock);
+
+    struct ShowResponse *response = show_response_build(event_id, layout, num_rows, num_cols);
+
+    mutex_lock(&show_cache_lock);
+    entry->building = 0;
+    cond_broadcast(&show_cache_built);
+
+    if (response == NULL) {
+      mutex_unlock(&show_cache_lock);
+      return NULL;
+    }
+
+    // Versions only grow, so the new response is never older than the cached one
+    struct ShowResponse *replaced = entry->response;
+    entry->response = response;
+    if (replaced != NULL && --replaced->refs == 0) {
+      free(replaced);
+    }
+    response->refs++;
+    mutex_unlock(&show_cache_lock);
+    return response;
   }
-  if (pipe_print(response_fd, &response, response_len)) {
-    fprintf(stderr, "Failed to send response.\n");
-    close(response_fd);
-    return 1;
+
+  struct ShowResponse *response = entry->response;
+  response->refs++;
+  mutex_unlock(&show_cache_lock);
+  return response;
+}
+
+int ems_show_handler(client_t *client, unsigned int event_id) {
+  unsigned int version;
+  size_t num_rows, num_cols;
+
+  struct ShowResponse *response = NULL;
+  if (get_event_version(event_id, &version, &num_rows, &num_cols) == 0) {
+    response = show_response_acquire(event_id, SHOW_LAYOUT_SHOW, version, num_rows, num_cols);
   }
-  close(response_fd);
 
-  return 0;
+  if (response == NULL) {
+    // [ result (int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ]
+    char error[sizeof(int) + sizeof(size_t) + sizeof(size_t)] = {0};
+    int result = 1;
+    size_t offset = 0;
+    create_message(error, &offset, &result, sizeof(int));
+    return send_response(client, error, sizeof(error));
+  }
+
+  // Send response to the client
+  int result = send_response(client, response->payload, response->len);
+  show_response_release(response);
+  return result;
 }
 
-int ems_list_handler(client_t *client) {
-  size_t num_events;
-  unsigned int *events;
+/// Sends the response of a SHOW_SINCE request that failed.
+/// @param client Client to respond to.
+/// @return 0 if successful, 1 otherwise.
+static int show_since_error(client_t *client) {
+  // [ result (int) ] | [ version (unsigned int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ] | [ format (char) ]
+  char error[sizeof(int) + sizeof(unsigned int) + 2 * sizeof(size_t) + sizeof(char)] = {0};
+  int result = 1;
+  size_t offset = 0;
+  create_message(error, &offset, &result, sizeof(int));
+  return send_response(client, error, sizeof(error));
+}
 
-  int result = get_events(&events, &num_events);
+int ems_show_since_handler(client_t *client, unsigned int event_id, unsigned int since, char encodings) {
+  struct EventChanges changes;
 
-  size_t response_len = sizeof(int) + sizeof(size_t) + sizeof(unsigned int) * num_events;
-  char response[response_len];
+  if (get_event_changes(event_id, since, (encodings & SHOW_ENCODING_RLE) != 0, &changes)) {
+    return show_since_error(client);
+  }
+
+  // Every seat in the raw format is the same for every session, so it's shared like SHOW responses
+  if (changes.full && changes.runs == NULL) {
+    struct ShowResponse *cached =
+        show_response_acquire(event_id, SHOW_LAYOUT_SINCE_RAW, changes.version, changes.rows, changes.cols);
+    if (cached == NULL) {
+      return show_since_error(client);
+    }
+    int result = send_response(client, cached->payload, cached->len);
+    show_response_release(cached);
+    return result;
+  }
+
+  char format = SHOW_FORMAT_DELTA;
+  size_t response_len = sizeof(int) + sizeof(unsigned int) + 2 * sizeof(size_t) + sizeof(char);
+  if (changes.runs != NULL) {
+    format = SHOW_FORMAT_RLE;
+    response_len += sizeof(size_t) + changes.runs_len;
+  } else {
+    response_len += sizeof(size_t) + (sizeof(size_t) + sizeof(unsigned int)) * changes.num_changes;
+  }
+
+  char *response = malloc(response_len);
+  if (response == NULL) {
+    perror("Failed to allocate show response");
+    free_event_changes(&changes);
+    return 1;
+  }
   size_t offset = 0;
-  memset(response, 0, response_len);
 
-  // [ result (int) ] | [ num_events (size_t) ] | [ events[num_events] (unsigned int) ]
+  // [ result (int) ] | [ version (unsigned int) ] | [ num_rows (size_t) ] | [ num_cols (size_t) ] | [ format (char) ]
+  // | rle: [ runs_len (size_t) ] | [ runs (char[runs_len]) ]
+  // | delta: [ num_changes (size_t) ] | [ seats[num_changes] (size_t) ]
+  //          | [ reservation_ids[num_changes] (unsigned int) ]
+  int result = 0;
   create_message(response, &offset, &result, sizeof(int));
-  create_message(response, &offset, &num_events, sizeof(size_t));
-  for (size_t i = 0; i < num_events; i++) {
-    create_message(response, &offset, &events[i], sizeof(unsigned int));
+  create_message(response, &offset, &changes.version, sizeof(unsigned int));
+  create_message(response, &offset, &changes.rows, sizeof(size_t));
+  create_message(response, &offset, &changes.cols, sizeof(size_t));
+  create_message(response, &offset, &format, sizeof(char));
+  if (format == SHOW_FORMAT_RLE) {
+    create_message(response, &offset, &changes.runs_len, sizeof(size_t));
+    create_message(response, &offset, changes.runs, changes.runs_len);
+  } else {
+    create_message(response, &offset, &changes.num_changes, sizeof(size_t));
+    create_message(response, &offset, changes.seats, sizeof(size_t) * changes.num_changes);
+    create_message(response, &offset, changes.reservation_ids, sizeof(unsigned int) * changes.num_changes);
   }
+  free_event_changes(&changes);
 
-  // Connect to client pipe and send response
-  int response_fd = open(client->response_pipename, O_WRONLY);
-  if (response_fd == -1) {
-    fprintf(stderr, "Failed to open response pipe.\n");
-    return 1;
+  // Send response to the client
+  result = send_response(client, response, response_len);
+  free(response);
+  return result;
+}
+
+/// Drops a reference to a LIST response, freeing it once it's neither cached nor being sent.
+/// @param response Response to release.
+static void list_response_release(struct ListResponse *response) {
+  mutex_lock(&list_cache_lock);
+  int last = --response->refs == 0;
+  mutex_unlock(&list_cache_lock);
+
+  if (last) {
+    free(response);
   }
-  if (pipe_print(response_fd, &response, response_len)) {
-    fprintf(stderr, "Failed to send response.\n");
-    close(response_fd);
-    return 1;
+}
+
+/// Serializes the current event ids into a new LIST response.
+/// @param generation Generation of the event list read before the ids.
+/// @return Response with a single reference, NULL on failure.
+static struct ListResponse *list_response_build(unsigned long long generation) {
+  size_t num_events = 0;
+  unsigned int *events = NULL;
+
+  if (get_events(&events, &num_events)) {
+    return NULL;
   }
-  close(response_fd);
+
+  size_t payload_len = sizeof(int) + sizeof(size_t) + sizeof(unsigned int) * num_events;
+  struct ListResponse *response = malloc(sizeof(struct ListResponse) + payload_len);
+  if (response == NULL) {
+    perror("Failed to allocate list response");
+    free(events);
+    return NULL;
+  }
+  response->generation = generation;
+  response->refs = 1;
+  response->len = 0;
+
+  // [ result (int) ] | [ num_events (size_t) ] | [ events[num_events] (unsigned int) ]
+  int result = 0;
+  create_message(response->payload, &response->len, &result, sizeof(int));
+  create_message(response->payload, &response->len, &num_events, sizeof(size_t));
+  create_message(response->payload, &response->len, events, sizeof(unsigned int) * num_events);
 
   free(events);
-  return 0;
-}
\ No newline at end of file
+  return response;
+}
+
+/// Gets the LIST response for the current event list, serializing it again only if an event was created since.
+/// @return Response to be released after sending, NULL on failure.
+static struct ListResponse *list_response_acquire() {
+  unsigned long long generation = ems_events_generation();
+
+  mutex_lock(&list_cache_lock);
+  if (list_cache != NULL && list_cache->generation == generation) {
+    struct ListResponse *response = list_cache;
+    response->refs++;
+    mutex_unlock(&list_cache_lock);
+    return response;
+  }
+  mutex_unlock(&list_cache_lock);
+
+  struct ListResponse *response = list_response_build(generation);
+  if (response == NULL) {
+    return NULL;
+  }
+
+  // Sessions that rebuilt it concurrently keep the newest one
+  struct ListResponse *replaced = NULL;
+  mutex_lock(&list_cache_lock);
+  if (list_cache == NULL || list_cache->generation < generation) {
+    replaced = list_cache;
+    list_cache = response;
+    response->refs++;
+  }
+  mutex_unlock(&list_cache_lock);
+
+  if (replaced != NULL) {
+    list_response_release(replaced);
+  }
+  return response;
+}
+
+int ems_list_handler(client_t *client) {
+  struct ListResponse *response = list_response_acquire();
+
+  if (response == NULL) {
+    // [ result (int) ] | [ num_events (size_t) ]
+    char error[sizeof(int) + sizeof(size_t)] = {0};
+    int result = 1;
+    size_t offset = 0;
+    create_message(error, &offset, &result, sizeof(int));
+    return send_response(client, error, sizeof(error));
+  }
+
+  // Send response to the client
+  int result = send_response(client, response->payload, response->len);
+  list_response_release(response);
+  return result;
+}
+
+int ems_run_job_handler(client_t *client) {
+  size_t header_len = sizeof(int) + 3 * sizeof(size_t);
+  size_t num_commands = 0, num_failed = 0, out_len = 0;
+  int result = 1;
+
+  // The output is gathered in a file of its own, to be sent in a single response however large it gets
+  int out_fd = job_file_open();
+  if (out_fd != -1 && client->job_fd != -1 && lseek(client->job_fd, 0, SEEK_SET) == 0) {
+    result = run_job_script(client->job_fd, out_fd, &num_commands, &num_failed);
+  }
+
+  char *response = NULL;
+  if (result == 0) {
+    off_t end = lseek(out_fd, 0, SEEK_END);
+    out_len = end > 0 ? (size_t)end : 0;
+    response = malloc(header_len + out_len);
+    result = end < 0 || response == NULL ||
+             (out_len > 0 && pread(out_fd, response + header_len, out_len, 0) != (ssize_t)out_len);
+  }
+  if (out_fd != -1) {
+    close(out_fd);
+  }
+
+  // The script is emptied for the next job of the session
+  if (client->job_fd != -1 && (ftruncate(client->job_fd, 0) || lseek(client->job_fd, 0, SEEK_SET) != 0)) {
+    perror("Failed to empty job script");
+  }
+
+  char header[sizeof(int) + 3 * sizeof(size_t)];
+  if (result != 0) {
+    free(response);
+    response = NULL;
+    out_len = 0;
+  }
+  char *message = response != NULL ? response : header;
+
+  // [ result (int) ] | [ num_commands (size_t) ] | [ num_failed (size_t) ] | [ out_len (size_t) ] | [ out ]
+  size_t offset = 0;
+  create_message(message, &offset, &result, sizeof(int));
+  create_message(message, &offset, &num_commands, sizeof(size_t));
+  create_message(message, &offset, &num_failed, sizeof(size_t));
+  create_message(message, &offset, &out_len, sizeof(size_t));
+
+  // Send response to the client
+  int failed = send_response(client, message, header_len + out_len);
+  free(response);
+  return failed;
+}
+
+int ems_stats_handler(client_t *client) {
+  size_t header_len = sizeof(int) + sizeof(size_t), report_len = 0;
+  char *report = stats_report(&report_len);
+  int result = report == NULL;
+
+  char header[sizeof(int) + sizeof(size_t)];
+  char *response = report != NULL ? malloc(header_len + report_len) : NULL;
+  if (response != NULL) {
+    memcpy(response + header_len, report, report_len);
+  } else {
+    result = 1;
+    report_len = 0;
+  }
+  free(report);
+  char *message = response != NULL ? response : header;
+
+  // [ result (int) ] | [ report_len (size_t) ] | [ report ]
+  size_t offset = 0;
+  create_message(message, &offset, &result, sizeof(int));
+  create_message(message, &offset, &report_len, sizeof(size_t));
+
+  // Send response to the client
+  int failed = send_response(client, message, header_len + report_len);
+  free(response);
+  return failed;
+}
@@ -3,16 +3,38 @@
 
 #include "common/io.h"
 
+/// Reads the next part of a request sent by the client, through its FIFO or socket.
+/// @param client Client that sent the request.
+/// @param buf Variable to store what is read.
+/// @param buf_len Length to read.
+/// @return 0 if successful, 1 otherwise.
+int receive_request(client_t *client, void *buf, size_t buf_len);
+
+/// Sends a whole response to the client, through its FIFO or socket.
+/// @param client Client to respond to.
+/// @param buf Content of the response.
+/// @param buf_len Length of the response.
+/// @return 0 if successful, 1 otherwise.
+int send_response(client_t *client, const void *buf, size_t buf_len);
+
 // Handler functions for client requests on the server side.
 
 int ems_setup_handler(int session_id, client_t *client);
 
 int ems_create_handler(client_t *client, unsigned int event_id, size_t num_rows, size_t num_cols);
 
-int ems_reserve_handler(client_t *client, unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+int ems_reserve_handler(client_t *client, unsigned int event_id, const seat_buffer_t *seats);
+
+int ems_reserve_ranges_handler(client_t *client, unsigned int event_id, size_t num_ranges, const seat_range_t *ranges);
 
 int ems_show_handler(client_t *client, unsigned int event_id);
 
+int ems_show_since_handler(client_t *client, unsigned int event_id, unsigned int since, char encodings);
+
 int ems_list_handler(client_t *client);
 
+int ems_run_job_handler(client_t *client);
+
+int ems_stats_handler(client_t *client);
+
 #endif  // __WORKERS_H__
\ No newline at end of file